@@ -9,7 +9,30 @@
  *
  */
 
+#ifndef __BST_MARK__
+#define __BST_MARK__
+
 #include <iostream>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <algorithm>
+#include <compare>
+#include <concepts>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <optional>
+#include <random>
+#include <string>
+#include <tuple>
+#include <vector>
+#include "SlabAllocator.h"
+#include "FrozenSearchIndex.h"
+#include "ForkJoinPool.h"
+#include "TreeExport.h"
 
 /// 临时性的异常类，用于表示树为空的异常
 class UnderflowException
@@ -30,531 +53,3582 @@ class IteratorMismatchException
 class IteratorUninitializedException
 {
 };
+class IOException
+{
+};
 
 /**
- * @brief 二叉搜索树模板类
+ * @brief 节点策略：不维护子树大小
  *
- * @tparam Comparable 模板参数，表示树中存储的元素类型
+ * 默认策略，节点中没有多余的字段，插入删除也不做多余的更新。
  */
-template <typename Comparable>
-class BinarySearchTree
+struct NoSubtreeSize
 {
-public:
+    static constexpr bool enabled = false;
+};
+
+/**
+ * @brief 节点策略：每个节点维护子树大小
+ *
+ * 和高度一样在旋转和调整平衡时顺便更新，换来 O(log n) 的 select / rank / countInRange。
+ */
+struct TrackSubtreeSize
+{
+    static constexpr bool enabled = true;
+};
+
+/**
+ * @brief 子树大小字段，只有启用时才真正占用空间
+ */
+template <bool Enabled>
+struct SubtreeSizeField
+{
+    std::size_t size = 1; ///< 以该节点为根的子树中的节点数
+};
+
+template <>
+struct SubtreeSizeField<false>
+{
+};
+
+/**
+ * @brief 运行统计的快照
+ *
+ * 只包含整数计数，可以直接拷贝出去，用 forEach 逐项导出到监控系统。
+ */
+struct TreeStatistics
+{
+    std::uint64_t comparisons = 0;      ///< 单键查找、插入、删除下降时的元素比较次数
+    std::uint64_t rotationsLL = 0;      ///< 左左情况：一次右旋（非 AVL 策略的每次右旋也计在这里）
+    std::uint64_t rotationsRR = 0;      ///< 右右情况：一次左旋（非 AVL 策略的每次左旋也计在这里）
+    std::uint64_t rotationsLR = 0;      ///< 左右情况：先左旋再右旋
+    std::uint64_t rotationsRL = 0;      ///< 右左情况：先右旋再左旋
+    std::uint64_t allocations = 0;      ///< 创建的节点数
+    std::uint64_t deallocations = 0;    ///< 逐个释放的节点数（整池归还的不计）
+    std::uint64_t searches = 0;         ///< 单键下降的次数
+    std::uint64_t totalSearchDepth = 0; ///< 这些下降访问过的节点总数
+    std::uint64_t maxSearchDepth = 0;   ///< 一次下降访问过的最多节点数
+
     /**
-     * @brief 默认构造函数
-     *
-     * 初始化一个空的二叉搜索树。
+     * @brief 平均每次下降访问的节点数
      */
-    BinarySearchTree() : root{nullptr} {}
+    double averageSearchDepth() const
+    {
+        return searches == 0 ? 0.0 : static_cast<double>(totalSearchDepth) / static_cast<double>(searches);
+    }
 
     /**
-     * @brief 拷贝构造函数
-     *
-     * 创建一个新树，它是给定树的深拷贝。这里相比课本代码，引用更直接，有利于编译器优化。
-     *
-     * @param rhs 要拷贝的二叉搜索树
+     * @brief 对每一项调用 f(名字, 值)，平均深度以 double 给出，其余为 std::uint64_t
      */
-    BinarySearchTree(const BinarySearchTree &rhs) : root{clone(rhs.root)} {}
+    template <typename F>
+    void forEach(F &&f) const
+    {
+        f("comparisons", comparisons);
+        f("rotations_ll", rotationsLL);
+        f("rotations_rr", rotationsRR);
+        f("rotations_lr", rotationsLR);
+        f("rotations_rl", rotationsRL);
+        f("allocations", allocations);
+        f("deallocations", deallocations);
+        f("searches", searches);
+        f("max_search_depth", maxSearchDepth);
+        f("average_search_depth", averageSearchDepth());
+    }
+};
+
+/**
+ * @brief 统计策略：不统计（默认）
+ *
+ * 计数字段是空类，所有计数点都在 if constexpr 里，关闭时不产生任何代码。
+ */
+struct NoTreeStatistics
+{
+    static constexpr bool enabled = false;
+};
+
+/**
+ * @brief 统计策略：记录比较、旋转、分配和查找深度
+ *
+ * 计数是普通整数，不是原子的：开启统计的树，集合运算不再并行执行。
+ */
+struct CollectTreeStatistics
+{
+    static constexpr bool enabled = true;
+};
+
+/**
+ * @brief 统计字段，只有启用时才真正占用空间
+ */
+template <bool Enabled>
+struct StatisticsField : TreeStatistics
+{
+};
+
+template <>
+struct StatisticsField<false>
+{
+};
+
+/**
+ * @brief 平衡策略：AVL 树（默认）
+ *
+ * 每个节点记录子树高度，左右高度差不超过 1，查找路径最短。
+ * join / split、批量操作和集合运算都建立在高度之上，只有这个策略提供。
+ */
+struct AvlBalance
+{
+    struct NodeData
+    {
+        int height = 1; ///< 节点的高度，叶子为 1
+    };
+};
+
+/**
+ * @brief 平衡策略：红黑树
+ *
+ * 每个节点只多一个颜色位。插入最多旋转两次，删除最多旋转三次，
+ * 写多的负载下比 AVL 旋转得少，代价是树最高可达 2 log n。
+ */
+struct RedBlackBalance
+{
+    struct NodeData
+    {
+        bool red = true; ///< 新节点总是红色
+    };
+};
+
+/**
+ * @brief 平衡策略：treap
+ *
+ * 每个节点带一个随机优先级，树按元素是二叉搜索树、按优先级是大根堆。
+ * 期望高度 O(log n)，插入期望旋转不到两次，删除不需要旋转。
+ */
+struct TreapBalance
+{
+    struct NodeData
+    {
+        unsigned priority = randomPriority(); ///< 随机优先级，父节点不小于孩子
+    };
 
     /**
-     * @brief 移动构造函数
-     *
-     * 将给定树的资源转移到新树中。这里 noexcept 用于指示该函数不会抛出异常。
-     * 因为移动构造不涉及内存分配，所以不会抛出异常。这里显式声明 noexcept 是为了提高性能。
-     * 让编译器知道这个函数不会抛出异常，从而优化代码。
-     *
-     * @param rhs 要移动的二叉搜索树
+     * @brief 每个线程一个 xorshift 生成器，足够随机也足够快
      */
-    BinarySearchTree(BinarySearchTree &&rhs) noexcept : root{rhs.root}
+    static unsigned randomPriority()
     {
-        rhs.root = nullptr;
+        thread_local std::uint64_t state = std::random_device{}() | 1;
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return static_cast<unsigned>(state >> 32);
     }
+};
+
+/**
+ * @brief 平衡策略：伸展树
+ *
+ * 节点没有额外字段。每次查找、插入、删除后把访问到的节点旋转到根，
+ * 经常访问的元素总在根附近，适合访问分布很不均匀的负载，均摊 O(log n)。
+ * 查找也会改变树的形状，所以 const 的查找函数同样不能和其他操作并发。
+ */
+struct SplayBalance
+{
+    struct NodeData
+    {
+    };
+};
+
+/**
+ * @brief 二进制快照的文件头
+ *
+ * 文件布局：32 字节文件头，之后是 count 个按升序紧挨着存放的元素，字节序与本机相同。
+ * 元素从第 32 字节开始，对常见类型都是对齐的，映射进内存后可以直接当数组用。
+ */
+struct SnapshotHeader
+{
+    static constexpr char Magic[8] = {'B', 'S', 'T', 'S', 'N', 'A', 'P', '\0'};
+    static constexpr std::uint32_t CurrentVersion = 1;
+
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t elementSize;
+    std::uint64_t count;
+    std::uint64_t reserved;
 
     /**
-     * @brief 析构函数
-     *
-     * 释放树中所有节点占用的内存。
+     * @brief 描述 count 个 T 类型元素的文件头
      */
-    ~BinarySearchTree()
+    template <typename T>
+    static SnapshotHeader describe(std::uint64_t count)
     {
-        makeEmpty();
+        SnapshotHeader header{};
+        std::memcpy(header.magic, Magic, sizeof(Magic));
+        header.version = CurrentVersion;
+        header.elementSize = sizeof(T);
+        header.count = count;
+        return header;
     }
 
     /**
-     * @brief 查找并返回树中的最小元素
-     *
-     * 这是一个公有接口，它调用了私有的递归函数。
-     *
-     * @return 最小元素的引用
+     * @brief 检查文件头是否是本程序写出的、元素类型为 T 的快照
      */
-    const Comparable &findMin() const
+    template <typename T>
+    bool matches() const
     {
-        if (isEmpty())
-            throw UnderflowException{};
-        return findMin(root)->element;
+        return std::memcmp(magic, Magic, sizeof(Magic)) == 0 && version == CurrentVersion && elementSize == sizeof(T);
     }
+};
+
+static_assert(sizeof(SnapshotHeader) == 32, "快照文件头应当正好 32 字节");
+
+/**
+ * @brief 比较器是否支持异构查找（带有 is_transparent 标记，如 std::less<>）
+ */
+template <typename Compare>
+concept TransparentCompare = requires { typename Compare::is_transparent; };
+
+/**
+ * @brief 构造与另一棵树共用节点内存池的空树时使用的标记
+ */
+struct SharePool
+{
+    explicit SharePool() = default;
+};
+
+inline constexpr SharePool sharePool{};
+
+/**
+ * @brief 二叉搜索树模板类
+ *
+ * 节点的申请和释放都通过分配器完成。默认的 SlabAllocator 按块申请节点、
+ * 用空闲链表回收节点，并且可以在整棵树丢弃时按块一次性归还内存。
+ * 如果需要逐个 new/delete 的行为，可以传入 std::allocator<Comparable>。
+ *
+ * 元素的顺序由比较器 Compare 决定，每下降一层只比较一次：比较器是标准库的
+ * less 且元素支持 <=> 时，一次三路比较就能分出小于、等于、大于；否则只问
+ * “x 是否在当前元素之前”，把相等的判断推迟到走到底以后再做一次。
+ * 比较器带 is_transparent 时（如 std::less<>），查找类接口可以直接用能和元素
+ * 比较的其他类型，例如用 std::string_view 在 std::string 的树里查找。
+ *
+ * @tparam Comparable 模板参数，表示树中存储的元素类型
+ * @tparam Compare 比较器类型，默认 std::less<Comparable>
+ * @tparam Allocator 分配器类型，会被 rebind 成节点类型使用
+ * @tparam SizePolicy 是否维护子树大小，取 NoSubtreeSize 或 TrackSubtreeSize
+ * @tparam BalancePolicy 平衡策略，取 AvlBalance、RedBlackBalance、TreapBalance 或 SplayBalance
+ * @tparam StatsPolicy 是否记录运行统计，取 NoTreeStatistics 或 CollectTreeStatistics
+ */
+template <typename Comparable, typename Compare = std::less<Comparable>,
+          typename Allocator = SlabAllocator<Comparable>, typename SizePolicy = NoSubtreeSize,
+          typename BalancePolicy = AvlBalance, typename StatsPolicy = NoTreeStatistics>
+class BinarySearchTree
+{
+protected:
+    struct BinaryNode;
+
+    using NodeAllocator = typename std::allocator_traits<Allocator>::template rebind_alloc<BinaryNode>;
+    using NodeTraits = std::allocator_traits<NodeAllocator>;
 
+public:
     /**
-     * @brief 查找并返回树中的最大元素
+     * @brief 只读的双向迭代器，按中序（从小到大）访问元素
      *
-     * @return 最大元素的引用
+     * 借助节点中的父指针移动，不需要额外的栈。++ 和 -- 单次最坏 O(log n)，
+     * 遍历整棵树时每条边只走两次，所以均摊 O(1)。
+     * 元素决定了节点在树中的位置，因此只提供只读访问。
      */
-    const Comparable &findMax() const
+    class const_iterator
     {
-        if (isEmpty())
-            throw UnderflowException{};
-        return findMax(root)->element;
-    }
+    public:
+        using iterator_category = std::bidirectional_iterator_tag;
+        using value_type = Comparable;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const Comparable *;
+        using reference = const Comparable &;
+
+        /**
+         * @brief 默认构造函数，得到一个未初始化的迭代器
+         */
+        const_iterator() : current{nullptr}, tree{nullptr} {}
+
+        /**
+         * @brief 返回当前元素，对 end() 解引用会抛出异常
+         */
+        const Comparable &operator*() const
+        {
+            if (current == nullptr)
+                throw IteratorOutOfBoundsException{};
+            return current->element;
+        }
+
+        const Comparable *operator->() const
+        {
+            return &**this;
+        }
+
+        /**
+         * @brief 前置自增：有右子树就去右子树的最左节点，
+         * 否则向上找到第一个“从左边上来”的祖先
+         */
+        const_iterator &operator++()
+        {
+            if (current == nullptr)
+                throw IteratorOutOfBoundsException{};
+            if (current->right != nullptr)
+            {
+                current = current->right;
+                while (current->left != nullptr)
+                    current = current->left;
+            }
+            else
+            {
+                const BinaryNode *from = current;
+                current = current->parent;
+                while (current != nullptr && current->right == from)
+                {
+                    from = current;
+                    current = current->parent;
+                }
+            }
+            return *this;
+        }
+
+        const_iterator operator++(int)
+        {
+            const_iterator old = *this;
+            ++(*this);
+            return old;
+        }
+
+        /**
+         * @brief 前置自减：与自增对称。end() 自减得到最大元素
+         */
+        const_iterator &operator--()
+        {
+            if (tree == nullptr)
+                throw IteratorUninitializedException{};
+            if (current == nullptr)
+            {
+                current = tree->findMax(tree->root);
+                if (current == nullptr)
+                    throw IteratorOutOfBoundsException{};
+            }
+            else if (current->left != nullptr)
+            {
+                current = current->left;
+                while (current->right != nullptr)
+                    current = current->right;
+            }
+            else
+            {
+                const BinaryNode *from = current;
+                current = current->parent;
+                while (current != nullptr && current->left == from)
+                {
+                    from = current;
+                    current = current->parent;
+                }
+                if (current == nullptr)
+                    throw IteratorOutOfBoundsException{};
+            }
+            return *this;
+        }
+
+        const_iterator operator--(int)
+        {
+            const_iterator old = *this;
+            --(*this);
+            return old;
+        }
+
+        bool operator==(const const_iterator &rhs) const
+        {
+            return current == rhs.current;
+        }
+
+    protected:
+        const BinaryNode *current;     ///< 当前节点，nullptr 表示 end()
+        const BinarySearchTree *tree;  ///< 所属的树，end() 自减时需要找到最大元素
+
+        const_iterator(const BinaryNode *p, const BinarySearchTree *t) : current{p}, tree{t} {}
+
+        friend class BinarySearchTree;
+    };
+
+    /// 集合中的元素不能原地修改，普通迭代器和只读迭代器相同
+    using iterator = const_iterator;
 
     /**
-     * @brief 检查树中是否包含指定的元素
+     * @brief 由一对迭代器组成的区间视图，不拷贝任何元素
+     */
+    class Range
+    {
+    public:
+        Range(const_iterator first, const_iterator last) : first{first}, last{last} {}
+
+        const_iterator begin() const
+        {
+            return first;
+        }
+
+        const_iterator end() const
+        {
+            return last;
+        }
+
+        bool empty() const
+        {
+            return first == last;
+        }
+
+    private:
+        const_iterator first;
+        const_iterator last;
+    };
+
+    /**
+     * @brief 节点句柄：持有一个从树中摘下的节点
      *
-     * @param x 要查找的元素
-     * @return 如果树中包含该元素，则返回 true；否则返回 false
+     * 用 extract 取得，再用 insert 放回同一棵或另一棵树，元素不拷贝也不移动。
+     * 分配器支持 share() 时（如 SlabAllocator，它的副本是一个新的空池），句柄保存的不是副本，
+     * 而是 extract 时用 share() 取得的共享引用，与来源树共用内存池，
+     * 所以来源树之后被清空、析构或移动，句柄中的节点仍然有效；其他分配器保存普通的副本。
+     * 插入到分配器相等的树（同一棵树，或者用 BinarySearchTree(sharePool, tree) 共用内存池的树）时
+     * 节点直接挂进去，不分配内存；否则元素被移动到新节点中。
+     * 句柄只能移动，不能拷贝；非空的句柄析构时释放它持有的节点。
      */
-    bool contains(const Comparable &x) const
+    class node_type
+    {
+    public:
+        node_type() noexcept : node{nullptr}, alloc{} {}
+
+        node_type(node_type &&rhs) noexcept : node{std::exchange(rhs.node, nullptr)}, alloc{std::move(rhs.alloc)} {}
+
+        node_type &operator=(node_type &&rhs) noexcept
+        {
+            if (this != &rhs)
+            {
+                reset();
+                node = std::exchange(rhs.node, nullptr);
+                alloc = std::move(rhs.alloc);
+            }
+            return *this;
+        }
+
+        node_type(const node_type &) = delete;
+        node_type &operator=(const node_type &) = delete;
+
+        ~node_type()
+        {
+            reset();
+        }
+
+        bool empty() const noexcept
+        {
+            return node == nullptr;
+        }
+
+        explicit operator bool() const noexcept
+        {
+            return node != nullptr;
+        }
+
+        /**
+         * @brief 句柄中的元素
+         *
+         * 节点不在树中，可以修改元素（包括它的排序依据）后再插回去。
+         */
+        Comparable &value() const
+        {
+            if (node == nullptr)
+                throw IteratorUninitializedException{};
+            return node->element;
+        }
+
+    private:
+        BinaryNode *node;    ///< 持有的节点，为空表示空句柄
+        NodeAllocator alloc; ///< 能释放这个节点的分配器
+
+        node_type(BinaryNode *t, NodeAllocator &&a) noexcept : node{t}, alloc{std::move(a)} {}
+
+        void reset() noexcept
+        {
+            if (node != nullptr)
+            {
+                NodeTraits::destroy(alloc, node);
+                NodeTraits::deallocate(alloc, std::exchange(node, nullptr), 1);
+            }
+        }
+
+        friend class BinarySearchTree;
+    };
+
+    /**
+     * @brief insert(node_type&&) 的结果：插入失败时节点留在 node 中还给调用者
+     */
+    struct insert_return_type
+    {
+        const_iterator position; ///< 新插入的元素，或者阻止插入的已有元素
+        bool inserted;           ///< 是否插入成功
+        node_type node;          ///< 插入失败时原样返回的句柄
+    };
+
+    /**
+     * @brief 默认构造函数
+     *
+     * 初始化一个空的二叉搜索树。
+     */
+    BinarySearchTree() : comp{}, alloc{Allocator{}}, root{nullptr} {}
+
+    /**
+     * @brief 使用给定比较器（和分配器）的构造函数
+     *
+     * @param c 比较器
+     * @param a 分配器，会被转换成节点分配器
+     */
+    explicit BinarySearchTree(const Compare &c, const Allocator &a = Allocator{})
+        : comp{c}, alloc{a}, root{nullptr} {}
+
+    /**
+     * @brief 使用给定分配器的构造函数
+     *
+     * @param a 分配器，会被转换成节点分配器
+     */
+    explicit BinarySearchTree(const Allocator &a) : comp{}, alloc{a}, root{nullptr} {}
+
+    /**
+     * @brief 构造一棵与 other 共用节点分配器的空树，例如 BinarySearchTree b{sharePool, a};
+     *
+     * 两棵树的分配器相等：节点句柄在两者之间 insert 不分配内存，merge 也直接接管节点。
+     * 默认的 SlabAllocator 拷贝出来的是新的空池，只有这样构造的树才共用同一个池。
+     * 共用内存池的树不能在不同线程中同时修改。
+     *
+     * @param other 要共用分配器的树
+     */
+    BinarySearchTree(SharePool, BinarySearchTree &other)
+        : comp{other.comp}, alloc{shareAllocator(other.alloc)}, root{nullptr} {}
+
+    /**
+     * @brief 用一个区间中的元素构造树
+     *
+     * 区间严格递增时 O(n) 直接建出完全平衡的树，否则先排序去重。详见 assign。
+     *
+     * @param first 区间起点
+     * @param last 区间终点
+     * @param c 比较器
+     * @param a 分配器
+     */
+    template <std::input_iterator InputIt>
+    BinarySearchTree(InputIt first, InputIt last, const Compare &c = Compare{}, const Allocator &a = Allocator{})
+        : comp{c}, alloc{a}, root{nullptr}
+    {
+        assign(first, last);
+    }
+
+    template <std::input_iterator InputIt>
+    BinarySearchTree(InputIt first, InputIt last, const Allocator &a)
+        : BinarySearchTree(first, last, Compare{}, a) {}
+
+    /**
+     * @brief 拷贝构造函数
+     *
+     * 创建一个新树，它是给定树的深拷贝。这里相比课本代码，引用更直接，有利于编译器优化。
+     *
+     * @param rhs 要拷贝的二叉搜索树
+     */
+    BinarySearchTree(const BinarySearchTree &rhs)
+        : comp{rhs.comp}, alloc{NodeTraits::select_on_container_copy_construction(rhs.alloc)}, root{clone(rhs.root)} {}
+
+    /**
+     * @brief 移动构造函数
+     *
+     * 将给定树的资源转移到新树中。这里 noexcept 用于指示该函数不会抛出异常。
+     * 因为移动构造不涉及内存分配，所以不会抛出异常。这里显式声明 noexcept 是为了提高性能。
+     * 让编译器知道这个函数不会抛出异常，从而优化代码。
+     *
+     * @param rhs 要移动的二叉搜索树
+     */
+    BinarySearchTree(BinarySearchTree &&rhs) noexcept
+        : comp{rhs.comp}, alloc{std::move(rhs.alloc)}, root{rhs.root}
+    {
+        rhs.root = nullptr;
+    }
+
+    /**
+     * @brief 析构函数
+     *
+     * 释放树中所有节点占用的内存。分配器支持整体归还时，不再逐个释放节点。
+     */
+    ~BinarySearchTree()
+    {
+        // 池被共用时 release 只放弃本树的引用，块由最后一个引用者归还
+        if constexpr (BulkRelease)
+            releaseAll();
+        else
+            makeEmpty(root);
+    }
+
+    /**
+     * @brief 查找并返回树中的最小元素
+     *
+     * 这是一个公有接口，它调用了私有的同名函数。
+     *
+     * @return 最小元素的引用
+     */
+    const Comparable &findMin() const
+    {
+        if (isEmpty())
+            throw UnderflowException{};
+        return findMin(root)->element;
+    }
+
+    /**
+     * @brief 查找并返回树中的最大元素
+     *
+     * @return 最大元素的引用
+     */
+    const Comparable &findMax() const
+    {
+        if (isEmpty())
+            throw UnderflowException{};
+        return findMax(root)->element;
+    }
+
+    /**
+     * @brief 检查树中是否包含指定的元素
+     *
+     * @param x 要查找的元素
+     * @return 如果树中包含该元素，则返回 true；否则返回 false
+     */
+    bool contains(const Comparable &x) const
+    {
+        return findNode(x) != nullptr;
+    }
+
+    /**
+     * @brief 异构查找版本，需要透明比较器
+     *
+     * @param x 能与元素比较的任意类型的值
+     */
+    template <typename K>
+        requires TransparentCompare<Compare>
+    bool contains(const K &x) const
+    {
+        return findNode(x) != nullptr;
+    }
+
+    /**
+     * @brief 查找与 x 等价的元素
+     *
+     * @return 指向该元素的迭代器，不存在时返回 end()
+     */
+    const_iterator find(const Comparable &x) const
+    {
+        return {findNode(x), this};
+    }
+
+    template <typename K>
+        requires TransparentCompare<Compare>
+    const_iterator find(const K &x) const
+    {
+        return {findNode(x), this};
+    }
+
+    /**
+     * @brief 指向最小元素的迭代器
+     */
+    const_iterator begin() const
+    {
+        return {findMin(root), this};
+    }
+
+    /**
+     * @brief 尾后迭代器
+     */
+    const_iterator end() const
+    {
+        return {nullptr, this};
+    }
+
+    /**
+     * @brief 第一个不小于 x 的元素
+     *
+     * @param x 要比较的元素
+     * @return 指向该元素的迭代器，不存在时返回 end()
+     */
+    const_iterator lower_bound(const Comparable &x) const
+    {
+        return {lowerBoundNode(x), this};
+    }
+
+    template <typename K>
+        requires TransparentCompare<Compare>
+    const_iterator lower_bound(const K &x) const
+    {
+        return {lowerBoundNode(x), this};
+    }
+
+    /**
+     * @brief 第一个大于 x 的元素
+     *
+     * @param x 要比较的元素
+     * @return 指向该元素的迭代器，不存在时返回 end()
+     */
+    const_iterator upper_bound(const Comparable &x) const
+    {
+        return {upperBoundNode(x), this};
+    }
+
+    template <typename K>
+        requires TransparentCompare<Compare>
+    const_iterator upper_bound(const K &x) const
+    {
+        return {upperBoundNode(x), this};
+    }
+
+    /**
+     * @brief 闭区间 [lo, hi] 内的所有元素
+     *
+     * 两次 O(log n) 的定位，之后逐个访问 k 个元素，总代价 O(log n + k)。
+     *
+     * @param lo 区间下界（包含）
+     * @param hi 区间上界（包含）
+     * @return 区间视图，可以直接用于范围 for
+     */
+    Range range(const Comparable &lo, const Comparable &hi) const
+    {
+        if (comp(hi, lo))
+            return {end(), end()};
+        return {lower_bound(lo), upper_bound(hi)};
+    }
+
+    /**
+     * @brief 树中元素的个数，需要 TrackSubtreeSize
+     */
+    std::size_t size() const
+        requires TrackSize
+    {
+        return size(root);
+    }
+
+    /**
+     * @brief 查找第 k 小的元素（从 0 开始计数），需要 TrackSubtreeSize
+     *
+     * 比较 k 和左子树大小，决定停在当前节点还是往哪边走，O(log n)。
+     *
+     * @param k 名次
+     * @return 第 k 小的元素
+     */
+    const Comparable &select(std::size_t k) const
+        requires TrackSize
+    {
+        if (k >= size(root))
+            throw ArrayIndexOutOfBoundsException{};
+        BinaryNode *t = root;
+        while (true)
+        {
+            std::size_t leftSize = size(t->left);
+            if (k < leftSize)
+            {
+                t = t->left;
+            }
+            else if (k == leftSize)
+            {
+                return t->element;
+            }
+            else
+            {
+                k -= leftSize + 1;
+                t = t->right;
+            }
+        }
+    }
+
+    /**
+     * @brief 树中严格小于 x 的元素个数，需要 TrackSubtreeSize
+     *
+     * x 在树中时，这正是 x 的名次，满足 select(rank(x)) == x。
+     *
+     * @param x 要查询的元素
+     * @return 小于 x 的元素个数
+     */
+    std::size_t rank(const Comparable &x) const
+        requires TrackSize
+    {
+        return countBelow(x, false);
+    }
+
+    /**
+     * @brief 闭区间 [lo, hi] 内的元素个数，需要 TrackSubtreeSize
+     *
+     * 不逐个访问元素，只做两次 O(log n) 的下降。
+     *
+     * @param lo 区间下界（包含）
+     * @param hi 区间上界（包含）
+     * @return 区间内的元素个数
+     */
+    std::size_t countInRange(const Comparable &lo, const Comparable &hi) const
+        requires TrackSize
+    {
+        if (comp(hi, lo))
+            return 0;
+        return countBelow(hi, true) - countBelow(lo, false);
+    }
+
+    /**
+     * @brief 把当前内容冻结成一个只读的 Eytzinger 布局索引
+     *
+     * 索引是树的一份快照，之后对树的修改不会反映到索引中。
+     * 适合读多写少的阶段：查找不再跟指针，也没有节点开销。
+     *
+     * @return 包含当前全部元素的索引
+     */
+    FrozenSearchIndex<Comparable, Compare> freeze() const
+    {
+        return FrozenSearchIndex<Comparable, Compare>(begin(), end(), comp);
+    }
+
+    /**
+     * @brief 把全部元素按升序写入二进制快照文件
+     *
+     * 只支持可平凡复制的元素类型，元素按原样的字节写出，经过一块缓冲区成批写入。
+     * 文件格式见 SnapshotHeader，可以用 load 读回，或用 MappedSearchIndex 直接映射查询。
+     *
+     * @param path 文件路径，已存在时被覆盖
+     * @throws IOException 文件无法打开或写入失败
+     */
+    void save(const std::string &path) const
+        requires std::is_trivially_copyable_v<Comparable>
+    {
+        std::ofstream out{path, std::ios::binary | std::ios::trunc};
+        if (!out)
+            throw IOException{};
+        // 元素个数要等写完才知道，先占住文件头的位置，最后再回填
+        SnapshotHeader header = SnapshotHeader::describe<Comparable>(0);
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+        std::vector<char> buffer(SnapshotBufferBytes);
+        std::size_t used = 0;
+        for (const Comparable &x : *this)
+        {
+            if (used + sizeof(Comparable) > buffer.size())
+            {
+                out.write(buffer.data(), static_cast<std::streamsize>(used));
+                used = 0;
+            }
+            std::memcpy(buffer.data() + used, &x, sizeof(Comparable));
+            used += sizeof(Comparable);
+            ++header.count;
+        }
+        out.write(buffer.data(), static_cast<std::streamsize>(used));
+        out.seekp(0);
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        out.flush();
+        if (!out)
+            throw IOException{};
+    }
+
+    /**
+     * @brief 用二进制快照文件的内容替换树的内容
+     *
+     * 元素已经有序，边读边按中序直接建成完全平衡的树，O(n)，不需要任何比较式插入，
+     * 也不需要把整个文件先读进内存。读取时顺便检查元素严格递增。
+     * 任何一步失败，树保持原来的内容不变。
+     *
+     * @param path 文件路径
+     * @throws IOException 文件无法打开或长度不足
+     * @throws IllegalArgumentException 不是本类型的快照，或元素不是严格递增的
+     */
+    void load(const std::string &path)
+        requires std::is_trivially_copyable_v<Comparable>
+    {
+        std::ifstream in{path, std::ios::binary};
+        if (!in)
+            throw IOException{};
+        SnapshotHeader header;
+        if (!in.read(reinterpret_cast<char *>(&header), sizeof(header)))
+            throw IOException{};
+        if (!header.matches<Comparable>())
+            throw IllegalArgumentException{};
+
+        SnapshotReader reader{in, header.count, comp};
+        BinaryNode *built = buildBalanced(reader, static_cast<std::size_t>(header.count), nullptr);
+        // 新旧节点来自同一个分配器，旧节点只能逐个归还，不能整池释放
+        makeEmpty(root);
+        root = built;
+        initBalanceData(root);
+    }
+
+    /**
+     * @brief 检查树是否为空
+     *
+     * @return 如果树为空，则返回 true；否则返回 false
+     */
+    bool isEmpty() const
+    {
+        return root == nullptr;
+    }
+
+    /**
+     * @brief 打印树的结构
+     *
+     * 将树的结构输出到指定的输出流，默认输出到标准输出流。
+     * 元素经过缓冲区成块写出，整棵树打印完才刷新一次流。
+     *
+     * @param out 输出流，默认为 std::cout
+     */
+    void printTree(std::ostream &out = std::cout) const
+    {
+        if (isEmpty())
+        {
+            out << "Empty tree\n";
+            out.flush();
+        }
+        else
+        {
+            exportTree(out, ExportFormat::InOrder);
+        }
+    }
+
+    /**
+     * @brief 按指定格式把整棵树导出到输出端
+     *
+     * 用显式栈遍历，深度只受内存限制。文本先写进缓冲区，满了才整块交给 sink。
+     * DOT 格式的节点标签里带有平衡信息：AVL 的高度、红黑树的颜色、treap 的优先级，
+     * 方便检查树的形状；缺失的孩子画成一个点，以区分左右。
+     *
+     * @param sink 接受 std::string_view 的输出端
+     * @param format 导出格式
+     * @param buffer 调用者提供的缓冲区，为空时使用内部的 64 KiB 缓冲区
+     */
+    template <ExportSink Sink>
+    void exportTree(Sink &&sink, ExportFormat format = ExportFormat::InOrder, std::span<char> buffer = {}) const
+    {
+        ExportBuffer<std::remove_reference_t<Sink>> out{sink, buffer};
+        switch (format)
+        {
+        case ExportFormat::InOrder:
+            exportInOrder(out);
+            break;
+        case ExportFormat::Dot:
+            exportDot(out);
+            break;
+        case ExportFormat::Json:
+            exportJson(out);
+            break;
+        }
+        out.flush();
+    }
+
+    /**
+     * @brief 按指定格式把整棵树导出到输出流，结束时刷新一次
+     */
+    void exportTree(std::ostream &out, ExportFormat format = ExportFormat::InOrder) const
+    {
+        StreamSink sink{out};
+        exportTree(sink, format);
+        out.flush();
+    }
+
+    /**
+     * @brief 取运行统计的快照
+     */
+    TreeStatistics statistics() const
+        requires CollectStats
+    {
+        return stats;
+    }
+
+    /**
+     * @brief 把运行统计清零
+     */
+    void resetStatistics()
+        requires CollectStats
+    {
+        static_cast<TreeStatistics &>(stats) = TreeStatistics{};
+    }
+
+    /**
+     * @brief 检查树的全部不变式
+     *
+     * 元素严格递增、父指针与孩子指针一致、子树大小（启用时）正确，
+     * 以及平衡策略自己的性质：AVL 的 height 字段等于实际高度且左右高度差不超过 1；
+     * 红黑树没有相连的红节点、各路径黑节点数相同；treap 的优先级满足堆序。
+     * 用显式栈后序遍历，退化成链的树也不会爆栈。比较不计入统计。
+     *
+     * @return 全部满足时返回 true
+     */
+    bool validate() const
+    {
+        if (root == nullptr)
+            return true;
+        if (root->parent != nullptr)
+            return false;
+
+        /// 一棵已检查完的子树：最小、最大节点，高度，黑高，节点数
+        struct Summary
+        {
+            const BinaryNode *min;
+            const BinaryNode *max;
+            int height;
+            int blackHeight;
+            std::size_t size;
+        };
+        const Summary empty{nullptr, nullptr, 0, 0, 0};
+        std::vector<Summary> done;
+        std::vector<std::pair<const BinaryNode *, bool>> pending{{root, false}};
+        while (!pending.empty())
+        {
+            auto [t, expanded] = pending.back();
+            if (!expanded)
+            {
+                // 先压右孩子，左子树先检查完，它的结果在 done 中也排在前面
+                pending.back().second = true;
+                for (const BinaryNode *c : {t->right, t->left})
+                {
+                    if (c == nullptr)
+                        continue;
+                    if (c->parent != t)
+                        return false;
+                    pending.push_back({c, false});
+                }
+                continue;
+            }
+            pending.pop_back();
+            Summary r = empty, l = empty;
+            if (t->right != nullptr)
+            {
+                r = done.back();
+                done.pop_back();
+            }
+            if (t->left != nullptr)
+            {
+                l = done.back();
+                done.pop_back();
+            }
+            if ((l.max != nullptr && !comp(l.max->element, t->element)) ||
+                (r.min != nullptr && !comp(t->element, r.min->element)))
+                return false;
+
+            Summary self{l.min != nullptr ? l.min : t, r.max != nullptr ? r.max : t,
+                         std::max(l.height, r.height) + 1, l.blackHeight, l.size + r.size + 1};
+            if constexpr (TrackSize)
+                if (t->size != self.size)
+                    return false;
+            if constexpr (IsAvl)
+                if (t->height != self.height || l.height - r.height > 1 || r.height - l.height > 1)
+                    return false;
+            if constexpr (IsRedBlack)
+            {
+                if (l.blackHeight != r.blackHeight || (t->red && (isRed(t->left) || isRed(t->right))))
+                    return false;
+                self.blackHeight += !t->red;
+            }
+            if constexpr (IsTreap)
+                if ((t->left != nullptr && t->left->priority > t->priority) ||
+                    (t->right != nullptr && t->right->priority > t->priority))
+                    return false;
+            done.push_back(self);
+        }
+        return true;
+    }
+
+    /**
+     * @brief 清空树中的所有元素
+     *
+     * 释放树中所有节点占用的内存，使树变为空。
+     * 如果分配器支持 release()，节点只做析构，内存按块一次性归还；
+     * 元素类型还是平凡析构的话，连遍历都省掉了，代价只和块数有关。
+     * 内存池还被节点句柄或其他树共用时不能整体归还，节点逐个还给池，树继续共用这个池。
+     */
+    void makeEmpty()
+    {
+        if constexpr (BulkRelease)
+        {
+            if (!alloc.isShared())
+            {
+                releaseAll();
+                return;
+            }
+        }
+        makeEmpty(root);
+    }
+
+    /**
+     * @brief 用一个区间中的元素替换树的内容
+     *
+     * 如果区间已经严格递增（前向迭代器才能检查），就按中序一边读一边建树：
+     * 先建左半边，再建当前节点，再建右半边，得到完全平衡的 AVL 树，
+     * 高度在回溯时顺带算好，总代价 O(n)，比 n 次 insert 的 O(n log n) 快得多。
+     * 否则先拷贝到 vector 中排序去重，再按同样的方法建树。
+     *
+     * @param first 区间起点
+     * @param last 区间终点
+     */
+    template <std::input_iterator InputIt>
+    void assign(InputIt first, InputIt last)
+    {
+        if constexpr (std::forward_iterator<InputIt>)
+        {
+            auto notIncreasing = [this](const Comparable &a, const Comparable &b) { return !comp(a, b); };
+            if (std::adjacent_find(first, last, notIncreasing) == last)
+            {
+                makeEmpty();
+                root = buildBalanced(first, static_cast<std::size_t>(std::distance(first, last)), nullptr);
+                initBalanceData(root);
+                return;
+            }
+        }
+        assign(std::vector<Comparable>(first, last));
+    }
+
+    /**
+     * @brief 用一个 vector 中的元素替换树的内容
+     *
+     * vector 按值传入，排序、去重都在它上面原地完成，元素最后被移动进节点。
+     *
+     * @param values 元素，可以无序、可以有重复
+     */
+    void assign(std::vector<Comparable> values)
+    {
+        auto equivalent = [this](const Comparable &a, const Comparable &b) { return !comp(a, b) && !comp(b, a); };
+        if (!std::is_sorted(values.begin(), values.end(), comp))
+            std::sort(values.begin(), values.end(), comp);
+        values.erase(std::unique(values.begin(), values.end(), equivalent), values.end());
+        makeEmpty();
+        root = buildBalanced(std::make_move_iterator(values.begin()), values.size(), nullptr);
+        initBalanceData(root);
+    }
+
+    /**
+     * @brief 把另一棵树的元素全部并入当前树
+     *
+     * 两棵树都先用旋转展平成有序的右链，像归并有序链表那样合并，
+     * 再把合并后的链重建成完全平衡的树。总代价 O(n + m)，节点直接复用，
+     * 只有两边的分配器不兼容时才逐个搬移元素。与当前树重复的元素被丢弃。
+     *
+     * @param rhs 要并入的树，调用后为空
+     */
+    void merge(BinarySearchTree &&rhs)
+    {
+        if (this == &rhs || rhs.root == nullptr)
+            return;
+
+        BinaryNode *other = adoptNodes(rhs);
+        BinaryNode *mine = flatten(root);
+        root = nullptr;
+
+        BinaryNode *head = nullptr;
+        BinaryNode **tail = &head;
+        std::size_t count = 0;
+        while (mine != nullptr && other != nullptr)
+        {
+            BinaryNode **from;
+            if (comp(mine->element, other->element))
+            {
+                from = &mine;
+            }
+            else if (comp(other->element, mine->element))
+            {
+                from = &other;
+            }
+            else
+            {
+                // 重复元素，保留当前树中的那一个
+                BinaryNode *duplicate = other;
+                other = other->right;
+                destroyNode(duplicate);
+                continue;
+            }
+            *tail = *from;
+            tail = &(*from)->right;
+            *from = (*from)->right;
+            ++count;
+        }
+        *tail = mine != nullptr ? mine : other;
+        for (BinaryNode *t = *tail; t != nullptr; t = t->right)
+            ++count;
+
+        root = buildFromVine(head, count, nullptr);
+        initBalanceData(root);
+    }
+
+    /**
+     * @brief 批量插入区间中的元素
+     *
+     * 先一次性为整批元素建好节点并排序去重，再和树做一次同时下降的合并：
+     * 用子树的根把有序的批次二分成两半，分别并入左右子树，再用 join 接回去。
+     * 批次中没有元素落进的子树原样保留，不比较也不调整；每棵被触及的子树只调整一次平衡。
+     * 总代价 O(m log(n/m + 1))，而逐个插入是 O(m log n) 并且每次都从根开始。
+     * 左右两半互不相干，较大的子问题在线程池中并行执行。
+     * 与 insert 一样，已有的等价元素保持不变，批次内的重复元素只保留第一个。
+     * 批量操作、join / split 和集合运算都建立在 AVL 的高度之上，只有 AvlBalance 提供。
+     *
+     * @param first 区间起点
+     * @param last 区间终点
+     * @param pool 执行并行部分的线程池
+     */
+    template <std::input_iterator InputIt>
+    void insertBatch(InputIt first, InputIt last, ForkJoinPool &pool = ForkJoinPool::shared())
+        requires IsAvl
+    {
+        std::vector<BinaryNode *> nodes = createSortedNodes(first, last);
+        std::vector<BinaryNode *> duplicates;
+        root = unionNodes(root, nodes.data(), nodes.data() + nodes.size(), duplicates, pool);
+        for (BinaryNode *t : duplicates)
+            destroyNode(t);
+    }
+
+    /**
+     * @brief 批量删除区间中的元素
+     *
+     * 和 insertBatch 一样按子树的根二分有序的批次，同时下降；
+     * 根被删除时用 join 把左右两棵子树直接接起来。不存在的元素被忽略。
+     *
+     * @param first 区间起点
+     * @param last 区间终点
+     * @param pool 执行并行部分的线程池
+     */
+    template <std::input_iterator InputIt>
+    void removeBatch(InputIt first, InputIt last, ForkJoinPool &pool = ForkJoinPool::shared())
+        requires IsAvl
+    {
+        std::vector<Comparable> keys = sortedKeys(first, last);
+        std::vector<BinaryNode *> removed;
+        root = differenceKeys(root, keys.data(), keys.data() + keys.size(), removed, pool);
+        for (BinaryNode *t : removed)
+            destroyNode(t);
+    }
+
+    /**
+     * @brief 批量查找区间中的元素
+     *
+     * 把批次按元素排序后同时下降，共享从根开始的那部分路径。
+     *
+     * @param first 区间起点
+     * @param last 区间终点
+     * @param pool 执行并行部分的线程池
+     * @return 与输入顺序对应的查找结果
+     */
+    template <std::input_iterator InputIt>
+    std::vector<bool> containsBatch(InputIt first, InputIt last, ForkJoinPool &pool = ForkJoinPool::shared()) const
+        requires IsAvl
+    {
+        std::vector<Comparable> keys(first, last);
+        std::vector<std::size_t> order(keys.size());
+        for (std::size_t i = 0; i < order.size(); ++i)
+            order[i] = i;
+        std::sort(order.begin(), order.end(),
+                  [&](std::size_t a, std::size_t b) { return comp(keys[a], keys[b]); });
+        std::vector<unsigned char> hits(keys.size(), 0);
+        containsKeys(root, order.data(), order.data() + order.size(), keys, hits, pool);
+        return std::vector<bool>(hits.begin(), hits.end());
+    }
+
+    /**
+     * @brief 把 left、key、right 拼成一棵树
+     *
+     * 要求 left 的元素都在 key 之前、right 的元素都在 key 之后，否则抛出 IllegalArgumentException。
+     * 结果沿用 left 的比较器和分配器，right 的节点通过 adoptTree 接管。
+     * 拼接本身只沿较高一棵树的边界走 O(|h(left) - h(right)| + 1) 步。
+     *
+     * @param left 左边的树，调用后为空
+     * @param key 中间的元素
+     * @param right 右边的树，调用后为空
+     * @return 拼接后的树
+     */
+    static BinarySearchTree join(BinarySearchTree &&left, const Comparable &key, BinarySearchTree &&right)
+        requires IsAvl
+    {
+        if ((!left.isEmpty() && !left.comp(left.findMax(), key)) ||
+            (!right.isEmpty() && !left.comp(key, right.findMin())))
+            throw IllegalArgumentException{};
+        BinarySearchTree result{std::move(left)};
+        BinaryNode *k = result.createNode(key, nullptr, nullptr);
+        BinaryNode *r;
+        try
+        {
+            r = result.adoptTree(right);
+        }
+        catch (...)
+        {
+            result.destroyNode(k);
+            throw;
+        }
+        result.root = result.join(result.root, k, r);
+        return result;
+    }
+
+    /**
+     * @brief 把不在 key 之前的元素（大于等于 key 的元素）切出来，作为一棵新树返回
+     *
+     * 沿 key 的查找路径把树切成两半，每一层做一次 join，总共 O(log n)。
+     * 新树使用本树比较器和分配器的副本：副本与原分配器相等时（如 std::allocator），
+     * 节点直接交给新树；否则（如 SlabAllocator，每个副本有自己的内存池），
+     * 切出来的元素要移动到新树的节点中，多花 O(k) 时间，k 是切出的元素个数。
+     *
+     * @param key 分界元素
+     * @return 由不在 key 之前的元素组成的树
+     */
+    BinarySearchTree split(const Comparable &key)
+        requires IsAvl
+    {
+        SplitResult parts = splitNode(root, key);
+        root = parts.less;
+        BinaryNode *upper = parts.match != nullptr ? join(nullptr, parts.match, parts.greater) : parts.greater;
+        BinarySearchTree result{comp, Allocator(alloc)};
+        if (result.alloc == alloc)
+        {
+            result.root = upper;
+            return result;
+        }
+        BinaryNode *vine = flatten(upper);
+        std::size_t count;
+        BinaryNode *moved;
+        try
+        {
+            moved = result.moveVine(vine, *this, count);
+        }
+        catch (...)
+        {
+            // moveVine 失败时右链原样保留，整条接回本树
+            std::size_t rest = 0;
+            for (BinaryNode *t = vine; t != nullptr; t = t->right)
+                ++rest;
+            root = join(root, buildFromVine(vine, rest, nullptr));
+            throw;
+        }
+        result.root = result.buildFromVine(moved, count, nullptr);
+        return result;
+    }
+
+    /**
+     * @brief 并集：把 other 中的元素并入本树，等价元素保留本树的
+     *
+     * 用本树的根切开 other，两边递归求并集后再 join 回来，
+     * 工作量 O(m log(n/m + 1))，m、n 分别是较小和较大的树的大小。
+     * 两边的递归互不相干，在线程池中并行执行；子树足够小时不再分出任务。
+     * 并行部分只移动指针，不调用分配器；多余的节点在最后统一释放。
+     *
+     * @param other 另一棵树，按值传入，可以移动进来避免拷贝
+     * @param pool 执行并行部分的线程池
+     */
+    void unionWith(BinarySearchTree other, ForkJoinPool &pool = ForkJoinPool::shared())
+        requires IsAvl
+    {
+        BinaryNode *theirs = adoptTree(other);
+        std::vector<BinaryNode *> garbage;
+        root = unionTrees(std::exchange(root, nullptr), theirs, garbage, pool);
+        for (BinaryNode *t : garbage)
+            makeEmpty(t);
+    }
+
+    /**
+     * @brief 交集：只保留同时在 other 中出现的元素
+     *
+     * 与 unionWith 同样的分治结构和代价。
+     */
+    void intersectWith(BinarySearchTree other, ForkJoinPool &pool = ForkJoinPool::shared())
+        requires IsAvl
+    {
+        BinaryNode *theirs = adoptTree(other);
+        std::vector<BinaryNode *> garbage;
+        root = intersectTrees(std::exchange(root, nullptr), theirs, garbage, pool);
+        for (BinaryNode *t : garbage)
+            makeEmpty(t);
+    }
+
+    /**
+     * @brief 差集：删除在 other 中出现的元素
+     *
+     * 与 unionWith 同样的分治结构和代价。
+     */
+    void differenceWith(BinarySearchTree other, ForkJoinPool &pool = ForkJoinPool::shared())
+        requires IsAvl
+    {
+        BinaryNode *theirs = adoptTree(other);
+        std::vector<BinaryNode *> garbage;
+        root = differenceTrees(std::exchange(root, nullptr), theirs, garbage, pool);
+        for (BinaryNode *t : garbage)
+            makeEmpty(t);
+    }
+
+    /**
+     * @brief 插入一个常量引用元素到树中
+     *
+     * @param x 要插入的元素
+     */
+    void insert(const Comparable &x)
+    {
+        insert(x, root);
+    }
+
+    /**
+     * @brief 插入一个右值引用元素到树中
+     *
+     * @param x 要插入的元素
+     */
+    void insert(Comparable &&x)
+    {
+        insert(std::move(x), root);
+    }
+
+    /**
+     * @brief 用参数直接在节点中构造元素并插入
+     *
+     * 先分配节点、就地构造元素，再用它去查找插入位置，所以元素只构造一次、
+     * 从不拷贝或移动；已存在等价元素时，刚构造的节点被释放。
+     *
+     * @param args 转发给元素构造函数的参数
+     * @return 指向插入的（或已有的）元素的迭代器，以及是否插入成功
+     */
+    template <typename... Args>
+    std::pair<const_iterator, bool> emplace(Args &&...args)
+    {
+        BinaryNode *node = createNode(std::in_place, std::forward<Args>(args)...);
+        try
+        {
+            SearchPath path;
+            InsertPosition pos = findInsertPosition(node->element, root, path);
+            if (pos.found != nullptr)
+            {
+                destroyNode(node);
+                if constexpr (IsSplay)
+                    splay(pos.found);
+                return {{pos.found, this}, false};
+            }
+            return {{link(node, pos, path), this}, true};
+        }
+        catch (...)
+        {
+            destroyNode(node);
+            throw;
+        }
+    }
+
+    /**
+     * @brief 先用 key 查找，只有不存在等价元素时才用 args 构造元素
+     *
+     * 与 emplace 相反，已存在时不分配节点也不构造元素。
+     * 调用者保证用 args 构造出的元素与 key 等价。
+     *
+     * @param key 用于查找的键，比较器透明时可以是其他类型
+     * @param args 转发给元素构造函数的参数
+     * @return 指向插入的（或已有的）元素的迭代器，以及是否插入成功
+     */
+    template <typename K, typename... Args>
+        requires std::same_as<K, Comparable> || TransparentCompare<Compare>
+    std::pair<const_iterator, bool> try_emplace(const K &key, Args &&...args)
+    {
+        SearchPath path;
+        InsertPosition pos = findInsertPosition(key, root, path);
+        if (pos.found != nullptr)
+            return {{pos.found, this}, false};
+        BinaryNode *node = createNode(std::in_place, std::forward<Args>(args)...);
+        return {{link(node, pos, path), this}, true};
+    }
+
+    /**
+     * @brief 摘下与 x 等价的节点，不释放也不移动元素
+     *
+     * @param x 要摘下的元素
+     * @return 持有该节点的句柄，不存在时为空句柄
+     */
+    node_type extract(const Comparable &x)
+    {
+        return extractKey(x);
+    }
+
+    template <typename K>
+        requires TransparentCompare<Compare>
+    node_type extract(const K &x)
+    {
+        return extractKey(x);
+    }
+
+    /**
+     * @brief 摘下迭代器指向的节点
+     *
+     * 借助父指针找到从根到该节点的路径，不需要比较元素。
+     *
+     * @param pos 指向本树中元素的迭代器
+     * @return 持有该节点的句柄
+     */
+    node_type extract(const_iterator pos)
+    {
+        if (pos.tree != this)
+            throw IteratorMismatchException{};
+        if (pos.current == nullptr)
+            throw IteratorOutOfBoundsException{};
+        BinaryNode *t = const_cast<BinaryNode *>(pos.current);
+        SearchPath path;
+        detach(pathTo(t, path), path);
+        return {t, shareAllocator(alloc)};
+    }
+
+    /**
+     * @brief 插入节点句柄中的节点
+     *
+     * 目标树的分配器与句柄中的分配器相等时（同一棵树，或者共用内存池的树），
+     * 节点直接挂进树里，不分配内存；否则把元素移动到用本树分配器创建的新节点中。
+     *
+     * @param nh 节点句柄，插入成功后变为空
+     * @return 插入位置、是否成功，以及失败时还给调用者的句柄
+     */
+    insert_return_type insert(node_type &&nh)
+    {
+        if (nh.empty())
+            return {end(), false, {}};
+        SearchPath path;
+        InsertPosition pos = findInsertPosition(nh.node->element, root, path);
+        if (pos.found != nullptr)
+            return {{pos.found, this}, false, std::move(nh)};
+        BinaryNode *node;
+        if (nh.alloc == alloc)
+            node = std::exchange(nh.node, nullptr);
+        else
+            node = createNode(std::move(nh.node->element), nullptr, nullptr);
+        nh.reset();
+        return {{link(node, pos, path), this}, true, {}};
+    }
+
+    /**
+     * @brief 从树中移除指定的元素
+     *
+     * @param x 要移除的元素
+     */
+    void remove(const Comparable &x)
+    {
+        remove(x, root);
+    }
+
+    /**
+     * @brief 异构删除版本，需要透明比较器
+     *
+     * @param x 能与元素比较的任意类型的值
+     */
+    template <typename K>
+        requires TransparentCompare<Compare>
+    void remove(const K &x)
+    {
+        remove(x, root);
+    }
+
+    /**
+     * @brief 拷贝赋值运算符
+     *
+     * 将一个树的资源拷贝到当前树中。对自赋值进行了排除。
+     *
+     * @param rhs 要拷贝的二叉搜索树
+     * @return 当前树的引用
+     */
+    BinarySearchTree &operator=(const BinarySearchTree &rhs)
+    {
+        if (this != &rhs)
+        {
+            BinarySearchTree temp(rhs);
+            swapContents(temp);
+        }
+        return *this;
+    }
+
+    /**
+     * @brief 移动赋值运算符
+     *
+     * 将一个树的资源移动到当前树中。
+     *
+     * @param rhs 要移动的二叉搜索树
+     * @return 当前树的引用
+     */
+    BinarySearchTree &operator=(BinarySearchTree &&rhs) noexcept
+    {
+        swapContents(rhs);
+        return *this;
+    }
+
+protected:
+    /// 是否维护子树大小
+    static constexpr bool TrackSize = SizePolicy::enabled;
+    /// 当前使用的平衡策略
+    static constexpr bool IsAvl = std::is_same_v<BalancePolicy, AvlBalance>;
+    static constexpr bool IsRedBlack = std::is_same_v<BalancePolicy, RedBlackBalance>;
+    static constexpr bool IsTreap = std::is_same_v<BalancePolicy, TreapBalance>;
+    static constexpr bool IsSplay = std::is_same_v<BalancePolicy, SplayBalance>;
+    static_assert(IsAvl || IsRedBlack || IsTreap || IsSplay, "未知的平衡策略");
+    /// 是否记录运行统计
+    static constexpr bool CollectStats = StatsPolicy::enabled;
+
+    using BalanceData = typename BalancePolicy::NodeData;
+
+    /**
+     * @brief 二叉树节点结构体
+     *
+     * 启用 TrackSubtreeSize 时从基类继承一个 size 字段，否则基类为空，不占空间。
+     * 平衡策略需要的字段（高度、颜色、优先级）同样来自基类，伸展树没有。
+     */
+    struct BinaryNode : SubtreeSizeField<TrackSize>, BalanceData
+    {
+        Comparable element; ///< 节点存储的元素
+        BinaryNode *left;   ///< 左子节点指针
+        BinaryNode *right;  ///< 右子节点指针
+        BinaryNode *parent; ///< 父节点指针，根节点为空，迭代器靠它向上走
+
+        /**
+         * @brief 构造函数，接受常量引用
+         *
+         * @param theElement 要存储的元素
+         * @param lt 左子节点指针
+         * @param rt 右子节点指针
+         * @param pt 父节点指针
+         */
+        BinaryNode(const Comparable &theElement, BinaryNode *lt, BinaryNode *rt, BinaryNode *pt = nullptr)
+            : element{theElement}, left{lt}, right{rt}, parent{pt} {}
+
+        /**
+         * @brief 构造函数，接受右值引用
+         *
+         * @param theElement 要存储的元素
+         * @param lt 左子节点指针
+         * @param rt 右子节点指针
+         * @param pt 父节点指针
+         */
+        BinaryNode(Comparable &&theElement, BinaryNode *lt, BinaryNode *rt, BinaryNode *pt = nullptr)
+            : element{std::move(theElement)}, left{lt}, right{rt}, parent{pt} {}
+
+        /**
+         * @brief 构造函数，用参数直接在节点里构造元素
+         *
+         * @param args 转发给元素构造函数的参数
+         */
+        template <typename... Args>
+        explicit BinaryNode(std::in_place_t, Args &&...args)
+            : element(std::forward<Args>(args)...), left{nullptr}, right{nullptr}, parent{nullptr} {}
+    };
+
+    /// 分配器能否一次性归还全部节点的内存：需要能整体归还，并能知道池是否还被别人共用
+    static constexpr bool BulkRelease = requires(NodeAllocator &a) {
+        a.release();
+        { a.isShared() } -> std::convertible_to<bool>;
+    };
+
+    [[no_unique_address]] Compare comp; ///< 比较器，通常是空类，不占空间
+    NodeAllocator alloc;                ///< 节点分配器，必须先于 root 初始化
+    [[no_unique_address]] mutable StatisticsField<CollectStats> stats; ///< 运行统计，查找时也会更新，必须先于 root 初始化
+    mutable BinaryNode *root;           ///< 树的根节点指针，伸展树在查找时也会调整
+
+    /**
+     * @brief 能否用一次 <=> 代替比较器：比较器就是标准库的 less，且 K 与元素支持三路比较
+     */
+    template <typename K>
+    static constexpr bool ThreeWay =
+        (std::is_same_v<Compare, std::less<Comparable>> || std::is_same_v<Compare, std::less<>>) &&
+        std::three_way_comparable_with<K, Comparable>;
+
+    /**
+     * @brief 单键下降用的比较：a 是否在 b 之前，开启统计时计数
+     */
+    template <typename A, typename B>
+    bool before(const A &a, const B &b) const
+    {
+        if constexpr (CollectStats)
+            ++stats.comparisons;
+        return comp(a, b);
+    }
+
+    /**
+     * @brief 单键下降用的三路比较，开启统计时计数
+     */
+    template <typename A, typename B>
+    auto threeWay(const A &a, const B &b) const
+    {
+        if constexpr (CollectStats)
+            ++stats.comparisons;
+        return a <=> b;
+    }
+
+    /**
+     * @brief 记录一次访问了 depth 个节点的下降
+     */
+    void noteSearch([[maybe_unused]] std::size_t depth) const
+    {
+        if constexpr (CollectStats)
+        {
+            ++stats.searches;
+            stats.totalSearchDepth += depth;
+            stats.maxSearchDepth = std::max<std::uint64_t>(stats.maxSearchDepth, depth);
+        }
+    }
+
+    /**
+     * @brief 通过分配器创建一个节点
+     *
+     * @param args 转发给 BinaryNode 构造函数的参数
+     * @return 新节点指针
+     */
+    template <typename... Args>
+    BinaryNode *createNode(Args &&...args)
+    {
+        BinaryNode *t = NodeTraits::allocate(alloc, 1);
+        try
+        {
+            NodeTraits::construct(alloc, t, std::forward<Args>(args)...);
+        }
+        catch (...)
+        {
+            NodeTraits::deallocate(alloc, t, 1);
+            throw;
+        }
+        if constexpr (CollectStats)
+            ++stats.allocations;
+        return t;
+    }
+
+    /**
+     * @brief 析构并归还一个节点
+     *
+     * @param t 要释放的节点指针
+     */
+    void destroyNode(BinaryNode *t)
+    {
+        NodeTraits::destroy(alloc, t);
+        NodeTraits::deallocate(alloc, t, 1);
+        if constexpr (CollectStats)
+            ++stats.deallocations;
+    }
+
+    /**
+     * @brief 析构所有元素，内存交给分配器整体归还
+     */
+    void releaseAll() noexcept
+        requires BulkRelease
+    {
+        if constexpr (!std::is_trivially_destructible_v<Comparable>)
+            destroyElements(root);
+        root = nullptr;
+        alloc.release();
+    }
+
+    /**
+     * @brief 取得一个能释放本树节点的分配器，供节点句柄和共用内存池的树使用
+     *
+     * 分配器支持 share()（如 SlabAllocator）时与本树共用内存池，否则是普通的副本。
+     */
+    static NodeAllocator shareAllocator(NodeAllocator &a)
+    {
+        if constexpr (requires { a.share(); })
+            return a.share();
+        else
+            return a;
+    }
+
+    /**
+     * @brief 交换两棵树的节点和分配器
+     *
+     * 节点属于各自的分配器，所以两者必须一起交换。
+     */
+    void swapContents(BinarySearchTree &rhs) noexcept
+    {
+        using std::swap;
+        swap(comp, rhs.comp);
+        swap(alloc, rhs.alloc);
+        swap(root, rhs.root);
+    }
+
+    /**
+     * @brief 接管另一棵树的全部节点
+     *
+     * 分配器相等时节点可以直接使用；分配器支持 splice（如 SlabAllocator）且对方的池
+     * 没有被共用时，先把对方的内存池并过来；都不行才用自己的分配器逐个重新创建节点。
+     *
+     * @param rhs 来源树，调用后为空
+     * @return 由接管的节点组成的有序右链
+     */
+    BinaryNode *adoptNodes(BinarySearchTree &rhs)
+    {
+        BinaryNode *vine = flatten(rhs.root);
+        rhs.root = nullptr;
+        if (alloc == rhs.alloc)
+            return vine;
+        if constexpr (requires { alloc.splice(rhs.alloc); })
+        {
+            if (alloc.splice(rhs.alloc))
+                return vine;
+        }
+        std::size_t count;
+        try
+        {
+            return moveVine(vine, rhs, count);
+        }
+        catch (...)
+        {
+            rhs.root = vine;
+            throw;
+        }
+    }
+
+    /**
+     * @brief 把 from 的右链上的元素逐个移动到本树新建的节点中，旧节点还给 from
+     *
+     * 先建好全部新节点，再归还旧节点。中途分配失败时，已经移过来的元素放回原来的节点，
+     * 新节点全部释放，vine 原样保留，调用者可以把它接回来源树，不会丢失元素。
+     *
+     * @param vine 来源右链，调用后为空（失败时不变）
+     * @param from 右链节点所属的树
+     * @param count 输出新链的长度
+     * @return 新的右链
+     */
+    BinaryNode *moveVine(BinaryNode *&vine, BinarySearchTree &from, std::size_t &count)
+    {
+        BinaryNode *head = nullptr;
+        BinaryNode **tail = &head;
+        count = 0;
+        try
+        {
+            for (BinaryNode *source = vine; source != nullptr; source = source->right)
+            {
+                BinaryNode *node = createNode(std::move(source->element), nullptr, nullptr);
+                *tail = node;
+                tail = &node->right;
+                ++count;
+            }
+        }
+        catch (...)
+        {
+            // 新链与来源右链一一对应，逐个把元素放回去，不需要再分配
+            for (BinaryNode *source = vine; head != nullptr; source = source->right)
+            {
+                std::destroy_at(std::addressof(source->element));
+                std::construct_at(std::addressof(source->element), std::move(head->element));
+                destroyNode(std::exchange(head, head->right));
+            }
+            throw;
+        }
+        while (vine != nullptr)
+            from.destroyNode(std::exchange(vine, vine->right));
+        return head;
+    }
+
+    /**
+     * @brief 接管另一棵树，尽量保持它原来的形状
+     *
+     * 分配器相等或者能 splice 时直接使用原来的节点，O(1)（不计 splice 的块数）；
+     * 否则逐个移动元素后重建成平衡树，O(n)。
+     *
+     * @param rhs 来源树，调用后为空
+     * @return 接管的树根，父指针为空
+     */
+    BinaryNode *adoptTree(BinarySearchTree &rhs)
+    {
+        if (alloc == rhs.alloc)
+            return std::exchange(rhs.root, nullptr);
+        if constexpr (requires { alloc.splice(rhs.alloc); })
+        {
+            if (alloc.splice(rhs.alloc))
+                return std::exchange(rhs.root, nullptr);
+        }
+        BinaryNode *vine = adoptNodes(rhs);
+        std::size_t count = 0;
+        for (BinaryNode *t = vine; t != nullptr; t = t->right)
+            ++count;
+        return buildFromVine(vine, count, nullptr);
+    }
+
+    /**
+     * @brief 把子树展平成一条有序的右链
+     *
+     * 和 makeEmpty 一样不断右旋，只是把节点接到链尾而不是释放，O(n) 时间、O(1) 空间。
+     * 链上节点的 left 都为空，height、parent 等字段失效，要靠 buildFromVine 重建。
+     *
+     * @param t 子树根节点
+     * @return 链头（最小元素）
+     */
+    BinaryNode *flatten(BinaryNode *t)
+    {
+        BinaryNode *head = nullptr;
+        BinaryNode **tail = &head;
+        while (t != nullptr)
+        {
+            if (t->left != nullptr)
+            {
+                BinaryNode *lt = t->left;
+                t->left = lt->right;
+                lt->right = t;
+                t = lt;
+            }
+            else
+            {
+                *tail = t;
+                tail = &t->right;
+                t = t->right;
+            }
+        }
+        return head;
+    }
+
+    /**
+     * @brief 把有序右链的前 n 个节点重建成完全平衡的树
+     *
+     * 按中序消耗链：先建左半边，再取一个节点作根，再建右半边。不分配内存。
+     *
+     * @param cursor 链上下一个待用的节点，调用后前移 n 个
+     * @param n 节点个数
+     * @param parent 新子树根的父节点
+     * @return 新子树的根
+     */
+    BinaryNode *buildFromVine(BinaryNode *&cursor, std::size_t n, BinaryNode *parent)
+    {
+        if (n == 0)
+            return nullptr;
+        std::size_t leftCount = (n - 1) / 2;
+        BinaryNode *lt = buildFromVine(cursor, leftCount, nullptr);
+        BinaryNode *t = cursor;
+        cursor = cursor->right;
+        t->left = lt;
+        t->parent = parent;
+        if (lt != nullptr)
+            lt->parent = t;
+        t->right = buildFromVine(cursor, n - 1 - leftCount, t);
+        updateHeight(t);
+        updateSize(t);
+        return t;
+    }
+
+    /// save 和 load 一次读写的字节数
+    static constexpr std::size_t SnapshotBufferBytes = std::size_t{1} << 16;
+
+    /**
+     * @brief load 用的输入游标：分块读取快照中的元素，并检查它们严格递增
+     *
+     * 只提供 buildBalanced 需要的 *it 和 ++it。元素可平凡复制，
+     * 读进按元素对齐的原始存储后就可以直接当作对象使用。
+     */
+    class SnapshotReader
+    {
+    public:
+        SnapshotReader(std::istream &in, std::uint64_t count, const Compare &comp)
+            : in{in}, remaining{count}, comp{comp},
+              capacity{std::max<std::size_t>(1, SnapshotBufferBytes / sizeof(Comparable))},
+              chunk{std::allocator<Comparable>{}.allocate(capacity)}, pos{0}, filled{0}
+        {
+            try
+            {
+                refill();
+            }
+            catch (...)
+            {
+                // 构造函数没有完成，析构函数不会被调用
+                std::allocator<Comparable>{}.deallocate(chunk, capacity);
+                throw;
+            }
+        }
+
+        SnapshotReader(const SnapshotReader &) = delete;
+        SnapshotReader &operator=(const SnapshotReader &) = delete;
+
+        ~SnapshotReader()
+        {
+            std::allocator<Comparable>{}.deallocate(chunk, capacity);
+        }
+
+        const Comparable &operator*() const
+        {
+            return chunk[pos];
+        }
+
+        SnapshotReader &operator++()
+        {
+            previous = chunk[pos];
+            if (++pos == filled)
+                refill();
+            if (pos < filled && !comp(*previous, chunk[pos]))
+                throw IllegalArgumentException{};
+            return *this;
+        }
+
+    private:
+        std::istream &in;
+        std::uint64_t remaining; ///< 文件中还没读入缓冲区的元素个数
+        const Compare &comp;
+        std::size_t capacity;
+        Comparable *chunk;
+        std::size_t pos;
+        std::size_t filled;
+        std::optional<Comparable> previous;
+
+        void refill()
+        {
+            pos = 0;
+            filled = static_cast<std::size_t>(std::min<std::uint64_t>(remaining, capacity));
+            remaining -= filled;
+            std::streamsize bytes = static_cast<std::streamsize>(filled * sizeof(Comparable));
+            if (filled > 0 && !in.read(reinterpret_cast<char *>(chunk), bytes))
+                throw IOException{};
+        }
+    };
+
+    /**
+     * @brief 用有序序列中的 n 个元素建一棵完全平衡的树
+     *
+     * 和 buildFromVine 的顺序相同，只是节点由分配器新建。
+     * 中途分配失败时释放已经建好的部分，再把异常抛出去。
+     *
+     * @param it 下一个待用的元素，调用后前移 n 个
+     * @param n 元素个数
+     * @param parent 新子树根的父节点
+     * @return 新子树的根
+     */
+    template <typename InputIt>
+    BinaryNode *buildBalanced(InputIt &it, std::size_t n, BinaryNode *parent)
+    {
+        if (n == 0)
+            return nullptr;
+        std::size_t leftCount = (n - 1) / 2;
+        BinaryNode *lt = buildBalanced(it, leftCount, nullptr);
+        BinaryNode *t;
+        try
+        {
+            t = createNode(*it, lt, nullptr, parent);
+        }
+        catch (...)
+        {
+            makeEmpty(lt);
+            throw;
+        }
+        if (lt != nullptr)
+            lt->parent = t;
+        // 读快照时 ++it 会校验数据，发现损坏就抛出异常，此时 t 还没有挂到任何地方
+        try
+        {
+            ++it;
+            t->right = buildBalanced(it, n - 1 - leftCount, t);
+        }
+        catch (...)
+        {
+            makeEmpty(t);
+            throw;
+        }
+        updateHeight(t);
+        updateSize(t);
+        return t;
+    }
+
+    /// 右值版本，方便直接传入 begin() 之类的临时迭代器
+    template <typename InputIt>
+    BinaryNode *buildBalanced(InputIt &&it, std::size_t n, BinaryNode *parent)
+        requires(!std::is_lvalue_reference_v<InputIt>)
+    {
+        InputIt cursor = std::move(it);
+        return buildBalanced(cursor, n, parent);
+    }
+
+    /**
+     * @brief 用左子树 l、孤立节点 k、右子树 r 拼成一棵 AVL 树
+     *
+     * 要求 l 中的元素都在 k 之前，r 中的都在 k 之后，l 和 r 各自平衡，高度可以相差任意多。
+     * 沿较高一侧靠内的边向下，找到与较矮一侧高度相差不超过 1 的子树，
+     * 在那里挂上 k，再沿走过的路径向上调整平衡，O(|h(l) - h(r)|)。
+     *
+     * @return 新树的根，父指针为空
+     */
+    BinaryNode *join(BinaryNode *l, BinaryNode *k, BinaryNode *r)
+    {
+        if (l != nullptr)
+            l->parent = nullptr;
+        if (r != nullptr)
+            r->parent = nullptr;
+        SearchPath path;
+        BinaryNode *result;
+        BinaryNode **slot;
+        BinaryNode *parent = nullptr;
+        if (height(l) > height(r) + 1)
+        {
+            // 左边高：沿 l 的右边界向下
+            result = l;
+            slot = &result;
+            while (height(*slot) > height(r) + 1)
+            {
+                path.push(slot);
+                parent = *slot;
+                slot = &parent->right;
+            }
+            l = *slot;
+        }
+        else if (height(r) > height(l) + 1)
+        {
+            // 右边高：沿 r 的左边界向下
+            result = r;
+            slot = &result;
+            while (height(*slot) > height(l) + 1)
+            {
+                path.push(slot);
+                parent = *slot;
+                slot = &parent->left;
+            }
+            r = *slot;
+        }
+        else
+        {
+            slot = &result;
+        }
+        k->left = l;
+        k->right = r;
+        k->parent = parent;
+        if (l != nullptr)
+            l->parent = k;
+        if (r != nullptr)
+            r->parent = k;
+        updateHeight(k);
+        updateSize(k);
+        *slot = k;
+        rebalance(path);
+        return result;
+    }
+
+    /**
+     * @brief 拼接两棵树，l 中的元素都在 r 之前
+     *
+     * 从 r 中摘下最小节点作为中间节点，再调用 join。
+     *
+     * @return 新树的根，父指针为空
+     */
+    BinaryNode *join(BinaryNode *l, BinaryNode *r)
+    {
+        if (r == nullptr)
+        {
+            if (l != nullptr)
+                l->parent = nullptr;
+            return l;
+        }
+        r->parent = nullptr;
+        SearchPath path;
+        BinaryNode **slot = &r;
+        while ((*slot)->left != nullptr)
+        {
+            path.push(slot);
+            slot = &(*slot)->left;
+        }
+        BinaryNode *k = *slot;
+        detach(slot, path);
+        return join(l, k, r);
+    }
+
+    /**
+     * @brief 为区间中的元素逐个建好节点，按比较器排序、去掉等价的重复元素
+     *
+     * 元素直接在节点里构造，排序只移动指针。节点按顺序串成右链，
+     * 落进空子树的一段可以直接交给 buildFromVine。
+     *
+     * @return 有序、无重复的节点
+     */
+    template <std::input_iterator InputIt>
+    std::vector<BinaryNode *> createSortedNodes(InputIt first, InputIt last)
+    {
+        std::vector<BinaryNode *> nodes;
+        if constexpr (std::forward_iterator<InputIt>)
+            nodes.reserve(static_cast<std::size_t>(std::distance(first, last)));
+        try
+        {
+            for (; first != last; ++first)
+            {
+                nodes.push_back(nullptr);
+                nodes.back() = createNode(*first, nullptr, nullptr);
+            }
+        }
+        catch (...)
+        {
+            for (BinaryNode *t : nodes)
+                if (t != nullptr)
+                    destroyNode(t);
+            throw;
+        }
+        auto before = [this](const BinaryNode *a, const BinaryNode *b) { return comp(a->element, b->element); };
+        if (!std::is_sorted(nodes.begin(), nodes.end(), before))
+            std::stable_sort(nodes.begin(), nodes.end(), before);
+        std::size_t count = 0;
+        for (BinaryNode *t : nodes)
+        {
+            if (count > 0 && !before(nodes[count - 1], t))
+                destroyNode(t);
+            else
+                nodes[count++] = t;
+        }
+        nodes.resize(count);
+        for (std::size_t i = 0; i + 1 < count; ++i)
+            nodes[i]->right = nodes[i + 1];
+        return nodes;
+    }
+
+    /**
+     * @brief 把区间中的元素复制出来，排序并去重
+     */
+    template <std::input_iterator InputIt>
+    std::vector<Comparable> sortedKeys(InputIt first, InputIt last) const
+    {
+        std::vector<Comparable> keys(first, last);
+        if (!std::is_sorted(keys.begin(), keys.end(), comp))
+            std::sort(keys.begin(), keys.end(), comp);
+        auto equivalent = [this](const Comparable &a, const Comparable &b) { return !comp(a, b) && !comp(b, a); };
+        keys.erase(std::unique(keys.begin(), keys.end(), equivalent), keys.end());
+        return keys;
+    }
+
+    /**
+     * @brief 把有序节点 [first, last) 并入子树 t
+     *
+     * 与 t 中已有元素等价的节点不挂进树里，放进 duplicates 由调用者释放。
+     *
+     * @return 合并后的子树根，父指针为空
+     */
+    BinaryNode *unionNodes(BinaryNode *t, BinaryNode **first, BinaryNode **last,
+                           std::vector<BinaryNode *> &duplicates, ForkJoinPool &pool)
+    {
+        if (first == last)
+            return t;
+        if (t == nullptr)
+        {
+            BinaryNode *cursor = *first;
+            return buildFromVine(cursor, static_cast<std::size_t>(last - first), nullptr);
+        }
+        BinaryNode **mid = std::lower_bound(first, last, t->element, [this](const BinaryNode *a, const Comparable &e)
+                                            { return comp(a->element, e); });
+        BinaryNode **next = mid;
+        if (mid != last && !comp(t->element, (*mid)->element))
+            duplicates.push_back(*next++);
+        BinaryNode *lt, *rt;
+        std::vector<BinaryNode *> rightDuplicates;
+        forkJoin(
+            pool, height(t) >= ParallelHeight && last - first >= ParallelBatch,
+            [&] { lt = unionNodes(t->left, first, mid, duplicates, pool); },
+            [&] { rt = unionNodes(t->right, next, last, rightDuplicates, pool); });
+        duplicates.insert(duplicates.end(), rightDuplicates.begin(), rightDuplicates.end());
+        return join(lt, t, rt);
+    }
+
+    /**
+     * @brief 从子树 t 中删除有序、无重复的元素 [first, last)
+     *
+     * 被删掉的节点放进 removed 由调用者释放。
+     *
+     * @return 删除后的子树根，父指针为空
+     */
+    BinaryNode *differenceKeys(BinaryNode *t, const Comparable *first, const Comparable *last,
+                               std::vector<BinaryNode *> &removed, ForkJoinPool &pool)
+    {
+        if (t == nullptr || first == last)
+            return t;
+        const Comparable *mid = std::lower_bound(first, last, t->element, comp);
+        const Comparable *next = mid;
+        bool hit = mid != last && !comp(t->element, *mid);
+        if (hit)
+            ++next;
+        BinaryNode *lt, *rt;
+        std::vector<BinaryNode *> rightRemoved;
+        forkJoin(
+            pool, height(t) >= ParallelHeight && last - first >= ParallelBatch,
+            [&] { lt = differenceKeys(t->left, first, mid, removed, pool); },
+            [&] { rt = differenceKeys(t->right, next, last, rightRemoved, pool); });
+        removed.insert(removed.end(), rightRemoved.begin(), rightRemoved.end());
+        if (!hit)
+            return join(lt, t, rt);
+        removed.push_back(t);
+        return join(lt, rt);
+    }
+
+    /**
+     * @brief 在子树 t 中同时查找 order 中的元素，order 按元素排好序
+     */
+    void containsKeys(const BinaryNode *t, const std::size_t *first, const std::size_t *last,
+                      const std::vector<Comparable> &keys, std::vector<unsigned char> &found, ForkJoinPool &pool) const
+    {
+        if (t == nullptr || first == last)
+            return;
+        const std::size_t *mid = std::lower_bound(first, last, t->element, [&](std::size_t i, const Comparable &e)
+                                                  { return comp(keys[i], e); });
+        const std::size_t *next = mid;
+        // 批次中可能有重复元素，它们都命中当前节点
+        while (next != last && !comp(t->element, keys[*next]))
+            found[*next++] = true;
+        forkJoin(
+            pool, t->height >= ParallelHeight && last - first >= ParallelBatch,
+            [&] { containsKeys(t->left, first, mid, keys, found, pool); },
+            [&] { containsKeys(t->right, next, last, keys, found, pool); });
+    }
+
+    /// 子树至少这么高时才把左右两半分给不同线程，太小的任务不值得同步
+    static constexpr int ParallelHeight = 12;
+    /// 批量操作中一批至少这么多个元素时才并行
+    static constexpr std::ptrdiff_t ParallelBatch = 1024;
+
+    /**
+     * @brief 值得并行时在线程池中同时执行 f 和 g，否则依次执行
+     */
+    template <typename F, typename G>
+    static void forkJoin(ForkJoinPool &pool, bool worthIt, F &&f, G &&g)
+    {
+        // 统计计数不是原子的，开启统计时不并行
+        if (worthIt && !CollectStats)
+        {
+            pool.invoke(f, g);
+        }
+        else
+        {
+            f();
+            g();
+        }
+    }
+
+    /**
+     * @brief split 的结果：在 key 之前的、与 key 等价的（孤立节点）、在 key 之后的
+     */
+    struct SplitResult
+    {
+        BinaryNode *less;
+        BinaryNode *match;
+        BinaryNode *greater;
+    };
+
+    /**
+     * @brief 沿 key 的查找路径把子树 t 切开
+     *
+     * 路径上的每个节点连同它不在路径上的那棵子树，用 join 接到对应的一边，
+     * 两边的高度依次递增，所以所有 join 的代价加起来是 O(h)。
+     *
+     * @return 三部分，两棵子树的父指针都为空
+     */
+    SplitResult splitNode(BinaryNode *t, const Comparable &key)
+    {
+        if (t == nullptr)
+            return {nullptr, nullptr, nullptr};
+        BinaryNode *lt = t->left;
+        BinaryNode *rt = t->right;
+        if (comp(key, t->element))
+        {
+            SplitResult parts = splitNode(lt, key);
+            parts.greater = join(parts.greater, t, rt);
+            return parts;
+        }
+        if (comp(t->element, key))
+        {
+            SplitResult parts = splitNode(rt, key);
+            parts.less = join(lt, t, parts.less);
+            return parts;
+        }
+        if (lt != nullptr)
+            lt->parent = nullptr;
+        if (rt != nullptr)
+            rt->parent = nullptr;
+        isolate(t);
+        return {lt, t, rt};
+    }
+
+    /**
+     * @brief 把节点的指针字段重置成孤立节点的样子
+     */
+    void isolate(BinaryNode *t)
+    {
+        t->left = t->right = t->parent = nullptr;
+        static_cast<BalanceData &>(*t) = BalanceData{};
+        if constexpr (TrackSize)
+            t->size = 1;
+    }
+
+    /**
+     * @brief 两棵子树的并集，等价元素保留 a 中的，b 中多余的节点放进 garbage
+     */
+    BinaryNode *unionTrees(BinaryNode *a, BinaryNode *b, std::vector<BinaryNode *> &garbage, ForkJoinPool &pool)
+    {
+        if (a == nullptr || b == nullptr)
+        {
+            BinaryNode *t = a != nullptr ? a : b;
+            if (t != nullptr)
+                t->parent = nullptr;
+            return t;
+        }
+        bool worthIt = std::min(height(a), height(b)) >= ParallelHeight;
+        BinaryNode *l1 = a->left;
+        BinaryNode *r1 = a->right;
+        SplitResult parts = splitNode(b, a->element);
+        BinaryNode *lt, *rt;
+        std::vector<BinaryNode *> rightGarbage;
+        forkJoin(
+            pool, worthIt,
+            [&] { lt = unionTrees(l1, parts.less, garbage, pool); },
+            [&] { rt = unionTrees(r1, parts.greater, rightGarbage, pool); });
+        garbage.insert(garbage.end(), rightGarbage.begin(), rightGarbage.end());
+        if (parts.match != nullptr)
+            garbage.push_back(parts.match);
+        return join(lt, a, rt);
+    }
+
+    /**
+     * @brief 两棵子树的交集，保留 a 中的节点，其余节点（或整棵子树）放进 garbage
+     */
+    BinaryNode *intersectTrees(BinaryNode *a, BinaryNode *b, std::vector<BinaryNode *> &garbage, ForkJoinPool &pool)
+    {
+        if (a == nullptr || b == nullptr)
+        {
+            if (a != nullptr)
+                garbage.push_back(a);
+            if (b != nullptr)
+                garbage.push_back(b);
+            return nullptr;
+        }
+        bool worthIt = std::min(height(a), height(b)) >= ParallelHeight;
+        BinaryNode *l1 = a->left;
+        BinaryNode *r1 = a->right;
+        SplitResult parts = splitNode(b, a->element);
+        BinaryNode *lt, *rt;
+        std::vector<BinaryNode *> rightGarbage;
+        forkJoin(
+            pool, worthIt,
+            [&] { lt = intersectTrees(l1, parts.less, garbage, pool); },
+            [&] { rt = intersectTrees(r1, parts.greater, rightGarbage, pool); });
+        garbage.insert(garbage.end(), rightGarbage.begin(), rightGarbage.end());
+        if (parts.match != nullptr)
+        {
+            garbage.push_back(parts.match);
+            return join(lt, a, rt);
+        }
+        isolate(a);
+        garbage.push_back(a);
+        return join(lt, rt);
+    }
+
+    /**
+     * @brief 两棵子树的差集 a - b，删掉的节点（或整棵子树）放进 garbage
+     */
+    BinaryNode *differenceTrees(BinaryNode *a, BinaryNode *b, std::vector<BinaryNode *> &garbage, ForkJoinPool &pool)
+    {
+        if (a == nullptr || b == nullptr)
+        {
+            if (b != nullptr)
+                garbage.push_back(b);
+            if (a != nullptr)
+                a->parent = nullptr;
+            return a;
+        }
+        bool worthIt = std::min(height(a), height(b)) >= ParallelHeight;
+        BinaryNode *l1 = a->left;
+        BinaryNode *r1 = a->right;
+        SplitResult parts = splitNode(b, a->element);
+        BinaryNode *lt, *rt;
+        std::vector<BinaryNode *> rightGarbage;
+        forkJoin(
+            pool, worthIt,
+            [&] { lt = differenceTrees(l1, parts.less, garbage, pool); },
+            [&] { rt = differenceTrees(r1, parts.greater, rightGarbage, pool); });
+        garbage.insert(garbage.end(), rightGarbage.begin(), rightGarbage.end());
+        if (parts.match == nullptr)
+            return join(lt, a, rt);
+        garbage.push_back(parts.match);
+        isolate(a);
+        garbage.push_back(a);
+        return join(lt, rt);
+    }
+
+    /**
+     * @brief 查找最小元素
+     *
+     * 一路向左走到底即可，用循环实现，深度再大也不会爆栈。
+     *
+     * @param t 当前节点指针
+     * @return 最小元素所在的节点指针
+     */
+    BinaryNode *findMin(BinaryNode *t) const
+    {
+        /// 从一个空节点开始查找，返回空指针
+        if (t != nullptr)
+        {
+            /// 向左无路了，当前节点就是最小元素
+            while (t->left != nullptr)
+            {
+                t = t->left;
+            }
+        }
+        return t;
+    }
+
+    /**
+     * @brief 查找最大元素
+     *
+     * @param t 当前节点指针
+     * @return 最大元素所在的节点指针
+     */
+    BinaryNode *findMax(BinaryNode *t) const
+    {
+        if (t != nullptr)
+        {
+            while (t->right != nullptr)
+            {
+                t = t->right;
+            }
+        }
+        return t;
+    }
+
+    /**
+     * @brief 查找与 x 等价的节点
+     *
+     * 支持三路比较时，一次 <=> 就决定向左、向右还是找到了。
+     * 否则每层只问 comp(x, 当前元素)：是就向左，否则向右并记下当前节点。
+     * 记下的最后一个节点是不大于 x 的最大元素，走到底后再比较一次就知道是否等价。
+     * 两种方式每层都只比较一次，循环实现，不占用额外的栈空间。
+     *
+     * @param x 要查找的值
+     * @return 找到的节点，不存在时返回空指针
+     */
+    template <typename K>
+    BinaryNode *findNode(const K &x) const
+    {
+        BinaryNode *t = root;
+        BinaryNode *result = nullptr;
+        [[maybe_unused]] BinaryNode *last = nullptr; // 最后访问的节点，伸展树把它转到根
+        [[maybe_unused]] std::size_t depth = 0;       // 访问过的节点数，只在统计时使用
+        if constexpr (ThreeWay<K>)
+        {
+            while (t != nullptr)
+            {
+                last = t;
+                if constexpr (CollectStats)
+                    ++depth;
+                auto order = threeWay(x, t->element);
+                if (order < 0)
+                {
+                    t = t->left;
+                }
+                else if (order > 0)
+                {
+                    t = t->right;
+                }
+                else
+                {
+                    result = t; // 找到元素
+                    break;
+                }
+            }
+        }
+        else
+        {
+            BinaryNode *candidate = nullptr;
+            while (t != nullptr)
+            {
+                last = t;
+                if constexpr (CollectStats)
+                    ++depth;
+                if (before(x, t->element))
+                {
+                    t = t->left;
+                }
+                else
+                {
+                    candidate = t;
+                    t = t->right;
+                }
+            }
+            if (candidate != nullptr && !before(candidate->element, x))
+                result = candidate;
+        }
+        noteSearch(depth);
+        if constexpr (IsSplay)
+            const_cast<BinarySearchTree *>(this)->splay(result != nullptr ? result : last);
+        return result;
+    }
+
+    /**
+     * @brief 第一个不在 x 之前的节点
+     */
+    template <typename K>
+    BinaryNode *lowerBoundNode(const K &x) const
+    {
+        BinaryNode *t = root;
+        BinaryNode *result = nullptr;
+        [[maybe_unused]] std::size_t depth = 0;
+        while (t != nullptr)
+        {
+            if constexpr (CollectStats)
+                ++depth;
+            if (before(t->element, x))
+            {
+                t = t->right;
+            }
+            else
+            {
+                result = t;
+                t = t->left;
+            }
+        }
+        noteSearch(depth);
+        return result;
+    }
+
+    /**
+     * @brief 第一个在 x 之后的节点
+     */
+    template <typename K>
+    BinaryNode *upperBoundNode(const K &x) const
+    {
+        BinaryNode *t = root;
+        BinaryNode *result = nullptr;
+        [[maybe_unused]] std::size_t depth = 0;
+        while (t != nullptr)
+        {
+            if constexpr (CollectStats)
+                ++depth;
+            if (before(x, t->element))
+            {
+                result = t;
+                t = t->left;
+            }
+            else
+            {
+                t = t->right;
+            }
+        }
+        noteSearch(depth);
+        return result;
+    }
+
+    /**
+     * @brief 中序写出树中的元素，每行一个
+     *
+     * 用显式栈代替递归，栈放在堆上，深度只受内存限制。
+     */
+    template <typename Buffer>
+    void exportInOrder(Buffer &out) const
+    {
+        std::vector<BinaryNode *> path;
+        BinaryNode *t = root;
+        while (t != nullptr || !path.empty())
+        {
+            /// 先把左链全部压栈
+            while (t != nullptr)
+            {
+                path.push_back(t);
+                t = t->left;
+            }
+            t = path.back();
+            path.pop_back();
+            out.putValue(t->element); // 写出当前节点
+            out.put('\n');
+            t = t->right; // 再处理右子树
+        }
+    }
+
+    /**
+     * @brief 以 Graphviz DOT 格式写出树的形状
+     *
+     * 节点编号为 n0、n1……，在写出父节点时分配；只有一个孩子时，缺失的那一边画成一个点。
+     */
+    template <typename Buffer>
+    void exportDot(Buffer &out) const
+    {
+        out.put("digraph BinarySearchTree {\n    node [shape=circle];\n");
+        std::vector<std::pair<BinaryNode *, std::size_t>> pending;
+        if (root != nullptr)
+            pending.push_back({root, 0});
+        std::size_t next = 1;
+        while (!pending.empty())
+        {
+            auto [t, id] = pending.back();
+            pending.pop_back();
+            out.put("    n");
+            out.putValue(id);
+            out.put(" [label=\"");
+            out.putDotLabel(t->element);
+            if constexpr (IsAvl)
+            {
+                out.put("\\nh=");
+                out.putValue(t->height);
+            }
+            if constexpr (IsTreap)
+            {
+                out.put("\\np=");
+                out.putValue(t->priority);
+            }
+            out.put('"');
+            if constexpr (IsRedBlack)
+                out.put(t->red ? ", color=red, fontcolor=red" : ", style=filled, fillcolor=black, fontcolor=white");
+            out.put("];\n");
+
+            BinaryNode *children[2] = {t->left, t->right};
+            std::size_t childIds[2] = {0, 0};
+            for (int side = 0; side < 2; ++side)
+            {
+                if (children[side] == nullptr && children[1 - side] == nullptr)
+                    continue;
+                std::size_t child = next++;
+                childIds[side] = child;
+                out.put("    n");
+                out.putValue(id);
+                out.put(" -> n");
+                out.putValue(child);
+                out.put(";\n");
+                if (children[side] == nullptr)
+                {
+                    out.put("    n");
+                    out.putValue(child);
+                    out.put(" [shape=point];\n");
+                }
+            }
+            // 先压右孩子，保证左子树先输出
+            for (int side = 1; side >= 0; --side)
+                if (children[side] != nullptr)
+                    pending.push_back({children[side], childIds[side]});
+        }
+        out.put("}\n");
+    }
+
+    /**
+     * @brief 以嵌套 JSON 对象写出树的形状，空树写成 null
+     *
+     * 栈里记录每个节点已经写到哪一步：0 还没开始，1 左子树已写完，2 右子树已写完。
+     */
+    template <typename Buffer>
+    void exportJson(Buffer &out) const
+    {
+        if (root == nullptr)
+        {
+            out.put("null\n");
+            return;
+        }
+        std::vector<std::pair<BinaryNode *, int>> pending{{root, 0}};
+        while (!pending.empty())
+        {
+            auto &[t, stage] = pending.back();
+            if (stage == 0)
+            {
+                out.put("{\"value\":");
+                out.putJson(t->element);
+                out.put(",\"left\":");
+                stage = 1;
+                if (t->left != nullptr)
+                    pending.push_back({t->left, 0});
+                else
+                    out.put("null");
+            }
+            else if (stage == 1)
+            {
+                out.put(",\"right\":");
+                stage = 2;
+                if (t->right != nullptr)
+                    pending.push_back({t->right, 0});
+                else
+                    out.put("null");
+            }
+            else
+            {
+                out.put('}');
+                pending.pop_back();
+            }
+        }
+        out.put('\n');
+    }
+
+    /**
+     * @brief 清空子树中的所有元素
+     *
+     * 不做后序遍历，而是不断右旋把左子树“拧”到右边：
+     * 根没有左孩子时直接释放根，沿右链继续。每次右旋都让右链上多一个节点，
+     * 每个节点至多被旋转一次、释放一次，所以总代价是 O(n)，且不需要任何栈。
+     *
+     * @param t 当前节点指针
+     */
+    void makeEmpty(BinaryNode *&t)
+    {
+        while (t != nullptr)
+        {
+            if (t->left != nullptr)
+            {
+                BinaryNode *lt = t->left;
+                t->left = lt->right;
+                lt->right = t;
+                t = lt;
+            }
+            else
+            {
+                BinaryNode *rt = t->right;
+                destroyNode(t);
+                t = rt;
+            }
+        }
+        /// 循环结束时 t 已经是空指针
+    }
+
+    /**
+     * @brief 只析构子树中的元素，不归还内存
+     *
+     * 配合分配器的 release() 使用，内存随后整体归还。和 makeEmpty 一样用旋转展平。
+     *
+     * @param t 当前节点指针
+     */
+    void destroyElements(BinaryNode *t)
+    {
+        while (t != nullptr)
+        {
+            if (t->left != nullptr)
+            {
+                BinaryNode *lt = t->left;
+                t->left = lt->right;
+                lt->right = t;
+                t = lt;
+            }
+            else
+            {
+                BinaryNode *rt = t->right;
+                NodeTraits::destroy(alloc, t);
+                t = rt;
+            }
+        }
+    }
+
+    int height(BinaryNode *t) const
+    {
+        return t == nullptr ? 0 : t->height;
+    }
+
+    /**
+     * @brief 根据孩子重新计算高度，只有 AVL 策略有高度字段
+     */
+    void updateHeight(BinaryNode *t)
+    {
+        if constexpr (IsAvl)
+        {
+            if (t != nullptr)
+                t->height = std::max(height(t->left), height(t->right)) + 1;
+        }
+    }
+
+    std::size_t size(BinaryNode *t) const
+        requires TrackSize
+    {
+        return t == nullptr ? 0 : t->size;
+    }
+
+    /**
+     * @brief 统计小于（或不大于）x 的元素个数
+     *
+     * 每向右走一步，就把左子树和当前节点一起计入。
+     *
+     * @param x 要比较的元素
+     * @param inclusive 为 true 时把等于 x 的元素也算进去
+     * @return 元素个数
+     */
+    std::size_t countBelow(const Comparable &x, bool inclusive) const
+        requires TrackSize
+    {
+        std::size_t count = 0;
+        BinaryNode *t = root;
+        while (t != nullptr)
+        {
+            if (before(t->element, x) || (inclusive && !before(x, t->element)))
+            {
+                count += size(t->left) + 1;
+                t = t->right;
+            }
+            else
+            {
+                t = t->left;
+            }
+        }
+        return count;
+    }
+
+    /**
+     * @brief 根据孩子重新计算子树大小，未启用时什么也不做
+     */
+    void updateSize(BinaryNode *t)
+    {
+        if constexpr (TrackSize)
+        {
+            if (t != nullptr)
+                t->size = size(t->left) + size(t->right) + 1;
+        }
+    }
+
+    BinaryNode *rightRotate(BinaryNode *y)
+    {
+        BinaryNode *x = y->left;
+        BinaryNode *T2 = x->right;
+
+        x->right = y;
+        y->left = T2;
+
+        x->parent = y->parent;
+        y->parent = x;
+        if (T2 != nullptr)
+            T2->parent = y;
+
+        updateHeight(y);
+        updateHeight(x);
+        updateSize(y);
+        updateSize(x);
+
+        return x;
+    }
+
+    BinaryNode *leftRotate(BinaryNode *x)
+    {
+        BinaryNode *y = x->right;
+        BinaryNode *T2 = y->left;
+
+        y->left = x;
+        x->right = T2;
+
+        y->parent = x->parent;
+        x->parent = y;
+        if (T2 != nullptr)
+            T2->parent = x;
+
+        updateHeight(x);
+        updateHeight(y);
+        updateSize(x);
+        updateSize(y);
+
+        return y;
+    }
+
+    int getBalance(BinaryNode *t) const
+    {
+        return t == nullptr ? 0 : height(t->left) - height(t->right);
+    }
+
+    /**
+     * @brief 恢复以 t 为根的子树的 AVL 性质
+     *
+     * 调用前 t 的左右子树都已经平衡，且高度差不超过 2。
+     * 只看高度来判断四种情况，不需要再比较元素。
+     *
+     * @param t 子树根节点指针的引用，旋转后指向新的根
+     */
+    void balance(BinaryNode *&t)
+    {
+        // 更新高度和子树大小
+        updateHeight(t);
+        updateSize(t);
+
+        // 获取平衡因子
+        int b = getBalance(t);
+
+        if (b > 1)
+        {
+            // 左右情况先转成左左情况
+            bool zigzag = getBalance(t->left) < 0;
+            if (zigzag)
+                t->left = leftRotate(t->left);
+            // 左左情况
+            t = rightRotate(t);
+            if constexpr (CollectStats)
+                ++(zigzag ? stats.rotationsLR : stats.rotationsLL);
+        }
+        else if (b < -1)
+        {
+            // 右左情况先转成右右情况
+            bool zigzag = getBalance(t->right) > 0;
+            if (zigzag)
+                t->right = rightRotate(t->right);
+            // 右右情况
+            t = leftRotate(t);
+            if constexpr (CollectStats)
+                ++(zigzag ? stats.rotationsRL : stats.rotationsRR);
+        }
+    }
+
+    /**
+     * @brief 记录从根往下走过的指针槽位
+     *
+     * 插入和删除先沿路径向下，再沿同一条路径向上调整平衡。
+     * 用它代替递归，退化成链的树也不会爆栈。平衡树的高度很小，
+     * 路径放在对象内部的数组里，只有特别深的树才会用到堆上的 vector。
+     */
+    class SearchPath
+    {
+    public:
+        void push(BinaryNode **slot)
+        {
+            if (count < InlineDepth)
+                inlineSlots[count] = slot;
+            else
+                overflow.push_back(slot);
+            ++count;
+        }
+
+        BinaryNode **&operator[](std::size_t i)
+        {
+            return i < InlineDepth ? inlineSlots[i] : overflow[i - InlineDepth];
+        }
+
+        std::size_t size() const
+        {
+            return count;
+        }
+
+        /**
+         * @brief 调整为 n 个槽位，多出的槽位由调用者填写
+         */
+        void resize(std::size_t n)
+        {
+            count = n;
+            overflow.resize(n > InlineDepth ? n - InlineDepth : 0);
+        }
+
+    private:
+        static constexpr std::size_t InlineDepth = 64;
+        BinaryNode **inlineSlots[InlineDepth];
+        std::vector<BinaryNode **> overflow;
+        std::size_t count = 0;
+    };
+
+    /**
+     * @brief 沿记录的路径自底向上调整平衡
+     */
+    void rebalance(SearchPath &path)
+    {
+        for (std::size_t i = path.size(); i-- > 0;)
+            balance(*path[i]);
+    }
+
+    /**
+     * @brief 插入位置：新节点挂在 slot 上，父节点为 parent；found 非空表示已有等价元素
+     */
+    struct InsertPosition
     {
-        return contains(x, root);
-    }
+        BinaryNode **slot;
+        BinaryNode *parent;
+        BinaryNode *found;
+    };
 
     /**
-     * @brief 检查树是否为空
+     * @brief 查找 x 的插入位置，并记录从根到插入位置的路径
      *
-     * @return 如果树为空，则返回 true；否则返回 false
+     * 和 findNode 一样每层只比较一次；不支持三路比较时，
+     * 走到底后检查记下的候选节点，与 x 等价就说明已经存在。
+     *
+     * @param x 要插入的元素（或与它等价的键）
+     * @param t 根节点指针
+     * @param path 输出路径
      */
-    bool isEmpty() const
+    template <typename K>
+    InsertPosition findInsertPosition(const K &x, BinaryNode *&t, SearchPath &path)
     {
-        return root == nullptr;
+        BinaryNode **slot = &t;
+        BinaryNode *parent = nullptr;
+        BinaryNode *candidate = nullptr; // 最后一个不在 x 之后的节点
+        while (*slot != nullptr)
+        {
+            path.push(slot);
+            parent = *slot;
+            if constexpr (ThreeWay<K>)
+            {
+                auto order = threeWay(x, parent->element);
+                if (order < 0)
+                    slot = &parent->left;
+                else if (order > 0)
+                    slot = &parent->right;
+                else
+                {
+                    noteSearch(path.size());
+                    return {nullptr, nullptr, parent};
+                }
+            }
+            else
+            {
+                if (before(x, parent->element))
+                {
+                    slot = &parent->left;
+                }
+                else
+                {
+                    candidate = parent;
+                    slot = &parent->right;
+                }
+            }
+        }
+        noteSearch(path.size());
+        if (candidate != nullptr && !before(candidate->element, x))
+            return {nullptr, nullptr, candidate};
+        return {slot, parent, nullptr};
     }
 
     /**
-     * @brief 打印树的结构
-     *
-     * 将树的结构输出到指定的输出流，默认输出到标准输出流。
+     * @brief 把一个孤立节点挂到插入位置上，再自底向上调整平衡
      *
-     * @param out 输出流，默认为 std::cout
+     * 旋转只改指针，节点本身不动，所以返回的指针在调整后仍然有效。
      */
-    void printTree(std::ostream &out = std::cout) const
+    BinaryNode *link(BinaryNode *node, const InsertPosition &pos, SearchPath &path)
     {
-        if (isEmpty())
+        node->parent = pos.parent;
+        *pos.slot = node;
+        if constexpr (IsAvl)
         {
-            out << "Empty tree" << std::endl;
+            rebalance(path);
         }
         else
         {
-            printTree(root, out);
+            updateSizes(path);
+            if constexpr (IsRedBlack)
+                insertFixup(node);
+            else if constexpr (IsTreap)
+                while (node->parent != nullptr && node->priority > node->parent->priority)
+                    rotateUp(node);
+            else
+                splay(node);
         }
+        return node;
     }
 
     /**
-     * @brief 清空树中的所有元素
+     * @brief 插入一个元素到树中，右值会被移动进节点
      *
-     * 释放树中所有节点占用的内存，使树变为空。
-     */
-    void makeEmpty()
-    {
-        makeEmpty(root);
-    }
-
-    /**
-     * @brief 插入一个常量引用元素到树中
+     * 先找到插入位置并记录路径，已存在时不分配节点。
      *
      * @param x 要插入的元素
+     * @param t 根节点指针
      */
-    void insert(const Comparable &x)
+    template <typename X>
+    void insert(X &&x, BinaryNode *&t)
     {
-        insert(x, root);
+        SearchPath path;
+        InsertPosition pos = findInsertPosition(x, t, path);
+        if (pos.found == nullptr)
+            link(createNode(std::forward<X>(x), nullptr, nullptr), pos, path);
+        else if constexpr (IsSplay)
+            splay(pos.found);
     }
 
     /**
-     * @brief 插入一个右值引用元素到树中
-     *
-     * @param x 要插入的元素
+     * @brief 删除节点的实现
+     * 先找到节点，再把它从树中摘下并释放。
      */
-    void insert(Comparable &&x)
+    template <typename K>
+    void remove(const K &x, BinaryNode *&t)
     {
-        insert(std::move(x), root);
+        SearchPath path;
+        BinaryNode **slot = findSlot(x, t, path);
+        if (slot == nullptr)
+            return;
+        BinaryNode *oldNode = *slot;
+        detach(slot, path);
+        destroyNode(oldNode);
     }
 
     /**
-     * @brief 从树中移除指定的元素
-     *
-     * @param x 要移除的元素
+     * @brief 摘下与 x 等价的节点，交给节点句柄
      */
-    void remove(const Comparable &x)
+    template <typename K>
+    node_type extractKey(const K &x)
     {
-        remove(x, root);
+        SearchPath path;
+        BinaryNode **slot = findSlot(x, root, path);
+        if (slot == nullptr)
+            return {};
+        BinaryNode *t = *slot;
+        detach(slot, path);
+        return {t, shareAllocator(alloc)};
     }
 
     /**
-     * @brief 拷贝赋值运算符
+     * @brief 查找与 x 等价的节点所在的槽位
      *
-     * 将一个树的资源拷贝到当前树中。对自赋值进行了排除。
+     * 查找时每层只比较一次，不支持三路比较时同样走到底再确认候选节点。
      *
-     * @param rhs 要拷贝的二叉搜索树
-     * @return 当前树的引用
+     * @param x 要查找的值
+     * @param t 根节点指针
+     * @param path 输出从根到该节点之上的路径
+     * @return 指向该节点的槽位，不存在时返回空指针
      */
-    BinarySearchTree &operator=(const BinarySearchTree &rhs)
+    template <typename K>
+    BinaryNode **findSlot(const K &x, BinaryNode *&t, SearchPath &path)
     {
-        if (this != &rhs)
+        BinaryNode **slot = &t;
+        BinaryNode **match = nullptr; // 与 x 等价的节点（或候选节点）所在的槽位
+        std::size_t matchDepth = 0;
+        while (*slot != nullptr)
         {
-            BinarySearchTree temp(rhs);
-            std::swap(root, temp.root);
+            if constexpr (ThreeWay<K>)
+            {
+                auto order = threeWay(x, (*slot)->element);
+                if (order == 0)
+                {
+                    noteSearch(path.size() + 1);
+                    return slot;
+                }
+                path.push(slot);
+                slot = order < 0 ? &(*slot)->left : &(*slot)->right;
+            }
+            else
+            {
+                path.push(slot);
+                if (before(x, (*slot)->element))
+                {
+                    slot = &(*slot)->left;
+                }
+                else
+                {
+                    match = slot;
+                    matchDepth = path.size() - 1;
+                    slot = &(*slot)->right;
+                }
+            }
         }
-        return *this;
+        noteSearch(path.size());
+        if (match == nullptr || before((*match)->element, x))
+            return nullptr;
+        // 路径只保留到该节点之上
+        path.resize(matchDepth);
+        return match;
     }
 
     /**
-     * @brief 移动赋值运算符
-     *
-     * 将一个树的资源移动到当前树中。
-     *
-     * @param rhs 要移动的二叉搜索树
-     * @return 当前树的引用
+     * @brief 节点 t 在树中的槽位：父节点的某个孩子指针，或者根指针
      */
-    BinarySearchTree &operator=(BinarySearchTree &&rhs) noexcept
+    BinaryNode **slotOf(BinaryNode *t)
     {
-        std::swap(root, rhs.root);
-        return *this;
+        if (t->parent == nullptr)
+            return &root;
+        return t->parent->left == t ? &t->parent->left : &t->parent->right;
     }
 
-protected:
     /**
-     * @brief 二叉树节点结构体
+     * @brief 由本树的节点构造迭代器，t 为空指针时得到 end()
+     *
+     * 迭代器的构造函数只对 BinarySearchTree 开放，派生类通过它取得迭代器。
      */
-    struct BinaryNode
+    const_iterator makeIterator(const BinaryNode *t) const
     {
-        Comparable element; ///< 节点存储的元素
-        BinaryNode *left;   ///< 左子节点指针
-        BinaryNode *right;  ///< 右子节点指针
-        int height;         ///< 节点的高度
-
-        /**
-         * @brief 构造函数，接受常量引用
-         *
-         * @param theElement 要存储的元素
-         * @param lt 左子节点指针
-         * @param rt 右子节点指针
-         */
-        BinaryNode(const Comparable &theElement, BinaryNode *lt, BinaryNode *rt)
-            : element{theElement}, left{lt}, right{rt} {}
-
-        /**
-         * @brief 构造函数，接受右值引用
-         *
-         * @param theElement 要存储的元素
-         * @param lt 左子节点指针
-         * @param rt 右子节点指针
-         */
-        BinaryNode(Comparable &&theElement, BinaryNode *lt, BinaryNode *rt)
-            : element{std::move(theElement)}, left{lt}, right{rt} {}
-    };
-
-    BinaryNode *root; ///< 树的根节点指针
+        return {t, this};
+    }
 
     /**
-     * @brief 递归查找最小元素
+     * @brief 沿父指针得到从根到 t 之上的路径
      *
-     * @param t 当前节点指针
-     * @return 最小元素所在的节点指针
+     * @return t 的槽位
      */
-    BinaryNode *findMin(BinaryNode *t) const
+    BinaryNode **pathTo(BinaryNode *t, SearchPath &path)
     {
-        /// 从一个空节点开始查找，返回空指针
-        if (t == nullptr)
-        {
-            return nullptr;
-        }
-        /// 向左无路了，当前节点就是最小元素
-        if (t->left == nullptr)
-        {
-            return t;
-        }
-        /// 否则继续向左查找
-        return findMin(t->left);
+        std::size_t depth = 0;
+        for (BinaryNode *p = t->parent; p != nullptr; p = p->parent)
+            ++depth;
+        path.resize(depth);
+        for (BinaryNode *p = t->parent; p != nullptr; p = p->parent)
+            path[--depth] = slotOf(p);
+        return slotOf(t);
     }
 
     /**
-     * @brief 递归查找最大元素
+     * @brief 把 *slot 处的节点从树中摘下，并沿 path 恢复平衡
      *
-     * @param t 当前节点指针
-     * @return 最大元素所在的节点指针
+     * 通过重组树的结构来删除节点，避免元素复制。
+     * 有两个孩子时，把右子树的最小节点摘下来顶替被删节点，
+     * 这段路径也记录下来，保证它上面的高度同样被更新。
+     * treap 不用接替者（那样接替者会带上被删节点的优先级），
+     * 而是把被删节点朝优先级较高的孩子一侧旋转下去，直到它最多只有一个孩子。
+     * 摘下的节点不释放，它的指针字段被重置，可以直接挂到别处。
+     *
+     * @param slot 指向要摘下的节点的槽位
+     * @param path 从根到该节点之上的路径
      */
-    BinaryNode *findMax(BinaryNode *t) const
+    void detach(BinaryNode **slot, SearchPath &path)
     {
-        /// 这里没有使用递归，而是使用循环，更高效
-        /// findMin 也可以改成循环实现
-        if (t != nullptr)
+        BinaryNode *oldNode = *slot;
+        if constexpr (IsTreap)
         {
-            while (t->right != nullptr)
+            // 每次把优先级较高的孩子转上来，堆序保持不变；转上来的节点进入路径，稍后更新大小
+            while (oldNode->left != nullptr && oldNode->right != nullptr)
             {
-                t = t->right;
+                bool leftUp = oldNode->left->priority > oldNode->right->priority;
+                BinaryNode *up = leftUp ? oldNode->left : oldNode->right;
+                rotateUp(up);
+                path.push(slot);
+                slot = leftUp ? &up->right : &up->left;
             }
         }
-        return t;
-    }
-
-    /**
-     * @brief 递归检查树中是否包含指定的元素
-     *
-     * @param x 要查找的元素
-     * @param t 当前节点指针
-     * @return 如果树中包含该元素，则返回 true；否则返回 false
-     */
-    bool contains(const Comparable &x, BinaryNode *t) const
-    {
-        /// 这是递归版本，也可以有循环版本
-        if (t == nullptr)
+        // 结构上真正少了一个节点的位置：x 顶替了它，xParent 是 x 的父节点，红黑树和伸展树据此调整
+        BinaryNode *x;
+        BinaryNode *xParent;
+        bool xLeft;
+        bool removedRed;
+        if (oldNode->left == nullptr || oldNode->right == nullptr)
         {
-            return false;
+            BinaryNode *child = oldNode->left != nullptr ? oldNode->left : oldNode->right;
+            if (child != nullptr)
+                child->parent = oldNode->parent;
+            *slot = child;
+            x = child;
+            xParent = oldNode->parent;
+            xLeft = xParent != nullptr && slot == &xParent->left;
+            removedRed = isRed(oldNode);
         }
-        if (x < t->element)
+        else
         {
-            return contains(x, t->left);
+            path.push(slot);
+            std::size_t mark = path.size();
+            BinaryNode **minSlot = &oldNode->right;
+            while ((*minSlot)->left != nullptr)
+            {
+                path.push(minSlot);
+                minSlot = &(*minSlot)->left;
+            }
+            BinaryNode *minNode = *minSlot;
+            x = minNode->right;
+            xParent = minNode->parent == oldNode ? minNode : minNode->parent;
+            xLeft = minNode->parent != oldNode;
+            removedRed = isRed(minNode);
+            // 接替者继承被删节点的颜色，原位置上的性质不受影响
+            static_cast<BalanceData &>(*minNode) = static_cast<const BalanceData &>(*oldNode);
+            *minSlot = minNode->right; // 将父节点指向最小节点的右子树
+            if (minNode->right != nullptr)
+                minNode->right->parent = minNode->parent;
+            minNode->left = oldNode->left;
+            minNode->right = oldNode->right;
+            minNode->left->parent = minNode;
+            if (minNode->right != nullptr)
+                minNode->right->parent = minNode;
+            minNode->parent = oldNode->parent;
+            *slot = minNode;
+            // 路径上的第一个槽位原本是 oldNode->right，现在换成了 minNode->right
+            if (path.size() > mark)
+                path[mark] = &minNode->right;
         }
-        else if (x > t->element)
+        isolate(oldNode);
+        if constexpr (IsAvl)
         {
-            return contains(x, t->right);
+            rebalance(path);
         }
         else
         {
-            return true; // 找到元素
+            updateSizes(path);
+            if constexpr (IsRedBlack)
+            {
+                if (!removedRed)
+                    removeFixup(x, xParent, xLeft);
+            }
+            else if constexpr (IsSplay)
+            {
+                splay(xParent);
+            }
         }
     }
 
     /**
-     * @brief 递归打印树的结构
+     * @brief 插入或删除后沿路径自底向上更新子树大小，未启用时什么也不做
      *
-     * @param t 当前节点指针
-     * @param out 输出流
+     * 非 AVL 策略随后的旋转只涉及相邻的节点，会自己维护大小。
      */
-    void printTree(BinaryNode *t, std::ostream &out) const
+    void updateSizes(SearchPath &path)
     {
-        /// 中序遍历
-        if (t != nullptr)
-        {
-            printTree(t->left, out);        // 先打印左子树
-            out << t->element << std::endl; // 打印当前节点
-            printTree(t->right, out);       // 再打印右子树
-        }
+        if constexpr (TrackSize)
+            for (std::size_t i = path.size(); i-- > 0;)
+                updateSize(*path[i]);
     }
 
     /**
-     * @brief 递归清空树中的所有元素
-     *
-     * @param t 当前节点指针
+     * @brief 把 x 旋转到它父节点的位置上，同时更新祖父节点（或根）的指针
      */
-    void makeEmpty(BinaryNode *&t)
+    void rotateUp(BinaryNode *x)
     {
-        /// 这必须是一个后序遍历，为什么？
-        if (t != nullptr)
-        {
-            makeEmpty(t->left);
-            makeEmpty(t->right);
-            delete t;
-            /// delete 并不会自动将指针置空，这里需要手动置空
-            t = nullptr;
-        }
+        BinaryNode *p = x->parent;
+        BinaryNode **slot = slotOf(p);
+        if constexpr (CollectStats)
+            ++(x == p->left ? stats.rotationsLL : stats.rotationsRR);
+        *slot = x == p->left ? rightRotate(p) : leftRotate(p);
     }
 
-    int height(BinaryNode *t) const
+    bool isRed(const BinaryNode *t) const
     {
-        return t == nullptr ? 0 : t->height;
+        if constexpr (IsRedBlack)
+            return t != nullptr && t->red;
+        else
+            return false;
     }
 
-    void updateHeight(BinaryNode *t)
+    /**
+     * @brief 红黑树插入红色节点 z 后的修复
+     *
+     * 叔节点为红时把颜色推给祖父，问题上移两层；为黑时一到两次旋转结束。
+     */
+    void insertFixup(BinaryNode *z)
     {
-        if (t != nullptr)
+        while (isRed(z->parent))
         {
-            t->height = std::max(height(t->left), height(t->right)) + 1;
+            BinaryNode *p = z->parent;
+            BinaryNode *g = p->parent; // 父节点是红的，所以不是根，祖父一定存在
+            BinaryNode *uncle = p == g->left ? g->right : g->left;
+            if (isRed(uncle))
+            {
+                p->red = false;
+                uncle->red = false;
+                g->red = true;
+                z = g;
+                continue;
+            }
+            // 内侧的孩子先转到外侧
+            if ((p == g->left) != (z == p->left))
+            {
+                rotateUp(z);
+                std::swap(z, p);
+            }
+            rotateUp(p);
+            p->red = false;
+            g->red = true;
+            break;
         }
-    }
-
-    BinaryNode *rightRotate(BinaryNode *y)
-    {
-        BinaryNode *x = y->left;
-        BinaryNode *T2 = x->right;
-
-        x->right = y;
-        y->left = T2;
-
-        updateHeight(y);
-        updateHeight(x);
-
-        return x;
-    }
-
-    BinaryNode *leftRotate(BinaryNode *x)
-    {
-        BinaryNode *y = x->right;
-        BinaryNode *T2 = y->left;
-
-        y->left = x;
-        x->right = T2;
-
-        updateHeight(x);
-        updateHeight(y);
-
-        return y;
-    }
-
-    int getBalance(BinaryNode *t) const
-    {
-        return t == nullptr ? 0 : height(t->left) - height(t->right);
+        root->red = false;
     }
 
     /**
-     * @brief 递归插入一个常量引用元素到树中
+     * @brief 红黑树删除黑色节点后的修复
      *
-     * @param x 要插入的元素
-     * @param t 当前节点指针
+     * x 所在的一侧少了一个黑节点（x 可能为空，所以另外给出父节点和方向）。
+     * 兄弟为红时先转成兄弟为黑；兄弟的孩子都黑时把问题上移，否则最多两次旋转结束。
+     *
+     * @param x 顶替被删节点的子树根
+     * @param parent x 的父节点
+     * @param left x 是否是左孩子
      */
-    void insert(const Comparable &x, BinaryNode *&t)
+    void removeFixup(BinaryNode *x, BinaryNode *parent, bool left)
     {
-        if (t == nullptr)
+        while (parent != nullptr && !isRed(x))
         {
-            t = new BinaryNode{x, nullptr, nullptr};
-            return;
-        }
-
-        if (x < t->element)
-            insert(x, t->left);
-        else if (x > t->element)
-            insert(x, t->right);
-        else
+            BinaryNode *sibling = left ? parent->right : parent->left;
+            if (isRed(sibling))
+            {
+                sibling->red = false;
+                parent->red = true;
+                rotateUp(sibling);
+                sibling = left ? parent->right : parent->left;
+            }
+            BinaryNode *nearChild = left ? sibling->left : sibling->right;
+            BinaryNode *farChild = left ? sibling->right : sibling->left;
+            if (!isRed(nearChild) && !isRed(farChild))
+            {
+                sibling->red = true;
+                x = parent;
+                parent = x->parent;
+                left = parent != nullptr && x == parent->left;
+                continue;
+            }
+            if (!isRed(farChild))
+            {
+                nearChild->red = false;
+                sibling->red = true;
+                rotateUp(nearChild);
+                farChild = sibling;
+                sibling = nearChild;
+            }
+            sibling->red = parent->red;
+            parent->red = false;
+            farChild->red = false;
+            rotateUp(sibling);
             return;
-
-        // 更新高度
-        updateHeight(t);
-
-        // 获取平衡因子
-        int balance = getBalance(t);
-
-        // 执行必要的旋转操作
-        // 左左情况
-        if (balance > 1 && x < t->left->element)
-            t = rightRotate(t);
-
-        // 右右情况
-        if (balance < -1 && x > t->right->element)
-            t = leftRotate(t);
-
-        // 左右情况
-        if (balance > 1 && x > t->left->element)
-        {
-            t->left = leftRotate(t->left);
-            t = rightRotate(t);
-        }
-
-        // 右左情况
-        if (balance < -1 && x < t->right->element)
-        {
-            t->right = rightRotate(t->right);
-            t = leftRotate(t);
         }
+        if (x != nullptr)
+            x->red = false;
     }
 
     /**
-     * @brief 分离最小节点
-     * 从给定子树中移除并返回最小节点，同时正确处理其右子树的连接
+     * @brief 伸展：把 x 一路旋转到根
+     *
+     * 父节点是根时旋转一次；x、父、祖父在一条线上时先转父再转 x，
+     * 否则连续转两次 x。前一种做法让访问路径上的节点深度大约减半，是均摊界的关键。
      */
-    BinaryNode *detachMin(BinaryNode *&t)
+    void splay(BinaryNode *x)
     {
-        if (t == nullptr)
-            return nullptr;
-
-        if (t->left == nullptr)
+        if (x == nullptr)
+            return;
+        while (x->parent != nullptr)
         {
-            // 找到最小节点
-            BinaryNode *minNode = t;
-            t = t->right; // 将父节点指向最小节点的右子树
-            return minNode;
+            BinaryNode *p = x->parent;
+            BinaryNode *g = p->parent;
+            if (g != nullptr)
+                rotateUp((x == p->left) == (p == g->left) ? p : x);
+            rotateUp(x);
         }
-        return detachMin(t->left);
     }
 
     /**
-     * @brief 删除节点的实现
-     * 通过重组树的结构来删除节点，避免元素复制
+     * @brief 为批量建成的树补上平衡策略需要的字段
+     *
+     * 批量建出的树各处子树大小最多差一，空指针只出现在最深的两层。
+     * AVL 的高度在建树时已经算好；红黑树把最深一层染红、其余染黑，
+     * 每条路径上的黑节点数就都相同；treap 把一组随机优先级从大到小按层序分给各节点；
+     * 伸展树什么也不用做。
      */
-    void remove(const Comparable &x, BinaryNode *&t)
+    void initBalanceData(BinaryNode *t)
     {
-        if (t == nullptr)
-            return;
-
-        if (x < t->element)
-            remove(x, t->left);
-        else if (t->element < x)
-            remove(x, t->right);
-        else
+        if constexpr (IsRedBlack || IsTreap)
         {
-            if (t->left == nullptr)
+            std::vector<BinaryNode *> order;
+            std::vector<std::size_t> levelStart;
+            if (t != nullptr)
+                order.push_back(t);
+            for (std::size_t begin = 0; begin < order.size();)
             {
-                BinaryNode *oldNode = t;
-                t = t->right;
-                delete oldNode;
+                levelStart.push_back(begin);
+                std::size_t end = order.size();
+                for (std::size_t i = begin; i < end; ++i)
+                {
+                    if (order[i]->left != nullptr)
+                        order.push_back(order[i]->left);
+                    if (order[i]->right != nullptr)
+                        order.push_back(order[i]->right);
+                }
+                begin = end;
             }
-            else if (t->right == nullptr)
+            if constexpr (IsRedBlack)
             {
-                BinaryNode *oldNode = t;
-                t = t->left;
-                delete oldNode;
+                std::size_t deepest = levelStart.size() > 1 ? levelStart.back() : order.size();
+                for (std::size_t i = 0; i < order.size(); ++i)
+                    order[i]->red = i >= deepest;
             }
             else
             {
-                BinaryNode *minNode = detachMin(t->right);
-                minNode->left = t->left;
-                minNode->right = t->right;
-                BinaryNode *oldNode = t;
-                t = minNode;
-                delete oldNode;
+                std::vector<unsigned> priorities(order.size());
+                for (unsigned &p : priorities)
+                    p = TreapBalance::randomPriority();
+                std::sort(priorities.begin(), priorities.end(), std::greater<unsigned>{});
+                for (std::size_t i = 0; i < order.size(); ++i)
+                    order[i]->priority = priorities[i];
             }
         }
-
-        if (t == nullptr)
-            return;
-
-        // 更新高度
-        updateHeight(t);
-
-        // 获取平衡因子
-        int balance = getBalance(t);
-
-        // 左左情况
-        if (balance > 1 && getBalance(t->left) >= 0)
-            t = rightRotate(t);
-
-        // 右右情况
-        if (balance < -1 && getBalance(t->right) <= 0)
-            t = leftRotate(t);
-
-        // 左右情况
-        if (balance > 1 && getBalance(t->left) < 0)
-        {
-            t->left = leftRotate(t->left);
-            t = rightRotate(t);
-        }
-
-        // 右左情况
-        if (balance < -1 && getBalance(t->right) > 0)
-        {
-            t->right = rightRotate(t->right);
-            t = leftRotate(t);
-        }
     }
 
     /**
-     * @brief 递归克隆树的结构
+     * @brief 克隆树的结构
      *
-     * @param t 当前节点指针
-     * @return 新的节点指针
+     * 先序复制，用显式栈记录“源节点”、“新节点应该挂在哪个指针上”和新节点的父节点。
+     * 中途分配失败时，已经复制出的部分是一棵完整的树，释放掉再把异常抛出去。
+     *
+     * @param t 源树的根节点指针
+     * @return 新树的根节点指针
      */
-    BinaryNode *clone(BinaryNode *t) const
+    BinaryNode *clone(BinaryNode *t)
     {
-        if (t == nullptr)
+        BinaryNode *copy = nullptr;
+        std::vector<std::tuple<BinaryNode *, BinaryNode **, BinaryNode *>> pending;
+        if (t != nullptr)
+            pending.emplace_back(t, &copy, nullptr);
+        try
         {
-            return nullptr;
+            while (!pending.empty())
+            {
+                auto [src, slot, parent] = pending.back();
+                pending.pop_back();
+                BinaryNode *node = createNode(src->element, nullptr, nullptr, parent);
+                static_cast<BalanceData &>(*node) = static_cast<const BalanceData &>(*src);
+                if constexpr (TrackSize)
+                    node->size = src->size;
+                *slot = node;
+                if (src->right != nullptr)
+                    pending.emplace_back(src->right, &node->right, node);
+                if (src->left != nullptr)
+                    pending.emplace_back(src->left, &node->left, node);
+            }
+        }
+        catch (...)
+        {
+            makeEmpty(copy);
+            throw;
         }
-        return new BinaryNode{t->element, clone(t->left), clone(t->right)};
+        return copy;
     }
 };
+
+#endif
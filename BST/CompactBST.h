@@ -0,0 +1,587 @@
+/**
+ * @file CompactBST.h
+ * @brief 节点存放在连续数组中、用 32 位下标和 2 位平衡因子的紧凑 AVL 树
+ *
+ * BinarySearchTree 的每个节点除了元素，还有三个 8 字节指针和一个 int 高度，
+ * 对 int 这样的小键，一个元素要占 32 字节以上，真正有用的只有 4 字节。
+ * 这里所有节点都放在一个 std::vector 里，孩子用 32 位下标表示；
+ * AVL 只需要知道左右子树高度差（-1、0、+1），它被塞进左孩子下标的最高两位。
+ * 一个 int 节点只有 12 字节，同样大小的缓存能装下两倍多的节点。
+ */
+
+#ifndef __COMPACT_BST_MARK__
+#define __COMPACT_BST_MARK__
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <utility>
+#include <vector>
+#include "BST.h"
+
+/**
+ * @brief 紧凑布局的 AVL 树，接口与 BinarySearchTree 的基本操作相同
+ *
+ * 没有父指针，插入和删除沿着记录下来的下标路径自底向上调整平衡因子。
+ * 删除时把数组最后一个节点搬进空出来的位置，数组始终是稠密的，不需要空闲链表，
+ * 代价是多一次从根出发的查找，用来找到被搬动节点的父亲。
+ * 因为只存下标，拷贝整棵树就是拷贝一个数组。
+ * 节点数最多为 2^30 - 1，超过时抛出 IllegalArgumentException。
+ *
+ * @tparam Comparable 元素类型，需要可移动
+ * @tparam Compare 比较器
+ */
+template <typename Comparable, typename Compare = std::less<Comparable>>
+class CompactBinarySearchTree
+{
+public:
+    CompactBinarySearchTree() : root{Nil}, comp{} {}
+
+    explicit CompactBinarySearchTree(const Compare &c) : root{Nil}, comp{c} {}
+
+    /**
+     * @brief 查找并返回树中的最小元素
+     */
+    const Comparable &findMin() const
+    {
+        if (isEmpty())
+            throw UnderflowException{};
+        std::uint32_t t = root;
+        while (child(t, 0) != Nil)
+            t = child(t, 0);
+        return pool[t].element;
+    }
+
+    /**
+     * @brief 查找并返回树中的最大元素
+     */
+    const Comparable &findMax() const
+    {
+        if (isEmpty())
+            throw UnderflowException{};
+        std::uint32_t t = root;
+        while (child(t, 1) != Nil)
+            t = child(t, 1);
+        return pool[t].element;
+    }
+
+    /**
+     * @brief 检查树中是否包含指定的元素
+     *
+     * @param x 要查找的元素
+     * @return 如果树中包含该元素，则返回 true；否则返回 false
+     */
+    bool contains(const Comparable &x) const
+    {
+        // 每层只比较一次，记住最后一个不小于 x 的节点，走到底再判断相等；
+        // 比较结果直接当作孩子下标，循环里没有难以预测的分支
+        std::uint32_t candidate = Nil;
+        std::uint32_t t = root;
+        while (t != Nil)
+        {
+            bool right = comp(pool[t].element, x);
+            candidate = right ? candidate : t;
+            t = child(t, right);
+        }
+        return candidate != Nil && !comp(x, pool[candidate].element);
+    }
+
+    bool isEmpty() const
+    {
+        return root == Nil;
+    }
+
+    /**
+     * @brief 元素个数，就是数组长度
+     */
+    std::size_t size() const
+    {
+        return pool.size();
+    }
+
+    /**
+     * @brief 节点数组占用的字节数，包括预留但还没用到的部分
+     */
+    std::size_t memoryUsage() const
+    {
+        return pool.capacity() * sizeof(Node);
+    }
+
+    /**
+     * @brief 预先为 n 个元素分配空间，避免插入过程中反复扩容
+     */
+    void reserve(std::size_t n)
+    {
+        pool.reserve(n);
+    }
+
+    /**
+     * @brief 按 van Emde Boas 顺序重新排列节点数组，O(n log log n)
+     *
+     * 随机插入后，相邻的下标只是插入时间相邻，查找路径上的节点散落在整个数组里。
+     * 重排时把树从中间一层切开：上半棵树先递归排好，再依次递归排下面的每棵子树。
+     * 不管缓存行多大，一次查找访问的缓存行数都只有 log_B n 的常数倍，
+     * 而按层序排时只有靠近根的几层挨在一起，越往下每一层都要换一个缓存行。
+     * 适合在批量建树之后、大量查找之前调用一次。
+     */
+    void optimizeLayout()
+    {
+        if (isEmpty())
+            return;
+        std::vector<std::uint32_t> order;
+        order.reserve(pool.size());
+        appendVebOrder(root, height(), order);
+        std::vector<std::uint32_t> position(pool.size());
+        for (std::size_t i = 0; i < order.size(); ++i)
+            position[order[i]] = static_cast<std::uint32_t>(i);
+        std::vector<Node> packed;
+        packed.reserve(pool.size());
+        for (std::uint32_t t : order)
+        {
+            packed.push_back(std::move(pool[t]));
+            for (std::uint32_t &link : packed.back().links)
+            {
+                std::uint32_t c = link & IndexMask;
+                if (c != Nil)
+                    link = (link & ~IndexMask) | position[c];
+            }
+        }
+        pool.swap(packed);
+        root = 0;
+    }
+
+    /**
+     * @brief 检查树的不变式
+     *
+     * 元素严格递增，每个节点存放的平衡因子等于实际的右子树高度减左子树高度且不超过 ±1，
+     * 数组中的每个节点都恰好在树上出现一次。用显式栈后序遍历。
+     *
+     * @return 全部满足时返回 true
+     */
+    bool validate() const
+    {
+        if (isEmpty())
+            return pool.empty();
+
+        /// 一棵已检查完的子树：最小、最大节点的下标，高度，节点数
+        struct Summary
+        {
+            std::uint32_t min;
+            std::uint32_t max;
+            int height;
+            std::size_t size;
+        };
+        const Summary empty{Nil, Nil, 0, 0};
+        std::vector<Summary> done;
+        std::vector<std::pair<std::uint32_t, bool>> pending{{root, false}};
+        while (!pending.empty())
+        {
+            auto [t, expanded] = pending.back();
+            if (!expanded)
+            {
+                // 下标越界或者路径长得不可能（链接成环）时，树已经损坏
+                if (t >= pool.size() || pending.size() > 2 * MaxDepth)
+                    return false;
+                // 先压右孩子，左子树先检查完，它的结果在 done 中也排在前面
+                pending.back().second = true;
+                for (int side = 1; side >= 0; --side)
+                    if (child(t, side) != Nil)
+                        pending.push_back({child(t, side), false});
+                continue;
+            }
+            pending.pop_back();
+            Summary r = empty, l = empty;
+            if (child(t, 1) != Nil)
+            {
+                r = done.back();
+                done.pop_back();
+            }
+            if (child(t, 0) != Nil)
+            {
+                l = done.back();
+                done.pop_back();
+            }
+            if ((l.max != Nil && !comp(pool[l.max].element, pool[t].element)) ||
+                (r.min != Nil && !comp(pool[t].element, pool[r.min].element)))
+                return false;
+            int bf = balanceFactor(t);
+            if (bf != r.height - l.height || bf < -1 || bf > 1)
+                return false;
+            done.push_back({l.min != Nil ? l.min : t, r.max != Nil ? r.max : t, std::max(l.height, r.height) + 1,
+                            l.size + r.size + 1});
+        }
+        return done.back().size == pool.size();
+    }
+
+    /**
+     * @brief 中序打印，用显式栈遍历
+     */
+    void printTree(std::ostream &out = std::cout) const
+    {
+        if (isEmpty())
+        {
+            out << "Empty tree" << std::endl;
+            return;
+        }
+        std::vector<std::uint32_t> path;
+        std::uint32_t t = root;
+        while (t != Nil || !path.empty())
+        {
+            while (t != Nil)
+            {
+                path.push_back(t);
+                t = child(t, 0);
+            }
+            t = path.back();
+            path.pop_back();
+            out << pool[t].element << '\n';
+            t = child(t, 1);
+        }
+        out.flush();
+    }
+
+    /**
+     * @brief 删除所有元素，并归还数组的空间
+     */
+    void makeEmpty()
+    {
+        std::vector<Node>{}.swap(pool);
+        root = Nil;
+    }
+
+    /**
+     * @brief 插入一个元素，已存在时什么也不做
+     *
+     * @param x 要插入的元素
+     */
+    void insert(const Comparable &x)
+    {
+        insertImpl(x);
+    }
+
+    /**
+     * @brief 插入一个右值元素，已存在时什么也不做
+     *
+     * @param x 要插入的元素
+     */
+    void insert(Comparable &&x)
+    {
+        insertImpl(std::move(x));
+    }
+
+    /**
+     * @brief 删除一个元素，不存在时什么也不做
+     *
+     * @param x 要删除的元素
+     */
+    void remove(const Comparable &x)
+    {
+        Path path;
+        std::uint32_t t = root;
+        while (t != Nil)
+        {
+            bool right;
+            if (comp(x, pool[t].element))
+                right = false;
+            else if (comp(pool[t].element, x))
+                right = true;
+            else
+                break;
+            path.push(t, right);
+            t = child(t, right);
+        }
+        if (t == Nil)
+            return;
+
+        // 有两个孩子时，用右子树的最小节点顶替，真正摘掉的是那个最多只有一个孩子的节点
+        std::uint32_t victim = t;
+        if (child(t, 0) != Nil && child(t, 1) != Nil)
+        {
+            path.push(t, true);
+            victim = child(t, 1);
+            while (child(victim, 0) != Nil)
+            {
+                path.push(victim, false);
+                victim = child(victim, 0);
+            }
+            pool[t].element = std::move(pool[victim].element);
+        }
+        std::uint32_t only = child(victim, 0) != Nil ? child(victim, 0) : child(victim, 1);
+        if (path.size == 0)
+            root = only;
+        else
+            setChild(path.node[path.size - 1], path.right[path.size - 1], only);
+
+        // 自底向上：子树变矮才需要继续往上看
+        for (std::size_t k = path.size; k-- > 0;)
+        {
+            std::uint32_t a = path.node[k];
+            int bf = balanceFactor(a) + (path.right[k] ? -1 : 1);
+            if (bf == 1 || bf == -1)
+            {
+                // 原来两边一样高，现在只是一边矮了一层，高度不变
+                setBalanceFactor(a, bf);
+                break;
+            }
+            if (bf == 0)
+            {
+                setBalanceFactor(a, 0);
+                continue;
+            }
+            bool shorter;
+            std::uint32_t top = rebalance(a, bf, shorter);
+            replaceChild(path, k, top);
+            if (!shorter)
+                break;
+        }
+        release(victim);
+    }
+
+protected:
+    /// 下标占低 30 位，全 1 表示空
+    static constexpr std::uint32_t IndexBits = 30;
+    static constexpr std::uint32_t IndexMask = (std::uint32_t{1} << IndexBits) - 1;
+    static constexpr std::uint32_t Nil = IndexMask;
+
+    /// AVL 树高约为 1.44 log2(n)，2^30 个节点的树高不超过 44
+    static constexpr std::size_t MaxDepth = 64;
+
+    /**
+     * @brief 树的层数，空树为 0
+     *
+     * 每一层都走向较高的子树（平衡因子为 +1 时向右，否则向左），O(log n)。
+     */
+    unsigned height() const
+    {
+        unsigned levels = 0;
+        for (std::uint32_t t = root; t != Nil; t = child(t, balanceFactor(t) > 0))
+            ++levels;
+        return levels;
+    }
+
+    /**
+     * @brief 把以 t 为根的前 levels 层按 van Emde Boas 顺序追加到 order
+     *
+     * 递归深度是 log(levels)，切开的每一层用显式栈收集。
+     */
+    void appendVebOrder(std::uint32_t t, unsigned levels, std::vector<std::uint32_t> &order) const
+    {
+        if (levels == 1)
+        {
+            order.push_back(t);
+            return;
+        }
+        unsigned top = levels / 2;
+        appendVebOrder(t, top, order);
+        // 上半棵树下面一层的节点，从左到右，每个都是一棵下半子树的根
+        std::vector<std::uint32_t> bottoms;
+        std::vector<std::pair<std::uint32_t, unsigned>> stack{{t, 0}};
+        while (!stack.empty())
+        {
+            auto [u, depth] = stack.back();
+            stack.pop_back();
+            if (depth == top)
+            {
+                bottoms.push_back(u);
+                continue;
+            }
+            for (int side = 1; side >= 0; --side)
+                if (child(u, side) != Nil)
+                    stack.push_back({child(u, side), depth + 1});
+        }
+        for (std::uint32_t b : bottoms)
+            appendVebOrder(b, levels - top, order);
+    }
+
+    /**
+     * @brief 节点：元素和两个孩子下标
+     *
+     * links[0] 的最高两位存放平衡因子加一（右子树高度减左子树高度，取值 -1、0、+1）。
+     */
+    struct Node
+    {
+        Comparable element;
+        std::uint32_t links[2];
+
+        template <typename X>
+        explicit Node(X &&x) : element{std::forward<X>(x)}, links{Nil | (std::uint32_t{1} << IndexBits), Nil} {}
+    };
+
+    std::vector<Node> pool;  ///< 所有节点，稠密存放
+    std::uint32_t root;      ///< 根的下标
+    [[no_unique_address]] Compare comp;
+
+    /**
+     * @brief 从根到当前节点的路径，以及在每个节点往哪边走
+     */
+    struct Path
+    {
+        std::uint32_t node[MaxDepth];
+        bool right[MaxDepth];
+        std::size_t size = 0;
+
+        void push(std::uint32_t t, bool r)
+        {
+            node[size] = t;
+            right[size] = r;
+            ++size;
+        }
+    };
+
+    std::uint32_t child(std::uint32_t t, bool right) const
+    {
+        return pool[t].links[right] & IndexMask;
+    }
+
+    void setChild(std::uint32_t t, bool right, std::uint32_t c)
+    {
+        std::uint32_t &link = pool[t].links[right];
+        link = (link & ~IndexMask) | c;
+    }
+
+    int balanceFactor(std::uint32_t t) const
+    {
+        return static_cast<int>(pool[t].links[0] >> IndexBits) - 1;
+    }
+
+    void setBalanceFactor(std::uint32_t t, int bf)
+    {
+        std::uint32_t &link = pool[t].links[0];
+        link = (link & IndexMask) | (static_cast<std::uint32_t>(bf + 1) << IndexBits);
+    }
+
+    /**
+     * @brief 把 path 第 k 个节点在其父亲（或根）处的位置换成 t
+     */
+    void replaceChild(const Path &path, std::size_t k, std::uint32_t t)
+    {
+        if (k == 0)
+            root = t;
+        else
+            setChild(path.node[k - 1], path.right[k - 1], t);
+    }
+
+    template <typename X>
+    void insertImpl(X &&x)
+    {
+        Path path;
+        std::uint32_t t = root;
+        while (t != Nil)
+        {
+            bool right;
+            if (comp(x, pool[t].element))
+                right = false;
+            else if (comp(pool[t].element, x))
+                right = true;
+            else
+                return;
+            path.push(t, right);
+            t = child(t, right);
+        }
+        if (pool.size() >= Nil)
+            throw IllegalArgumentException{};
+
+        // 先记下路径再追加节点：扩容会搬动数组，但下标不变
+        std::uint32_t fresh = static_cast<std::uint32_t>(pool.size());
+        pool.emplace_back(std::forward<X>(x));
+        if (path.size == 0)
+        {
+            root = fresh;
+            return;
+        }
+        setChild(path.node[path.size - 1], path.right[path.size - 1], fresh);
+
+        // 自底向上：子树长高才需要继续往上看，插入时最多旋转一次
+        for (std::size_t k = path.size; k-- > 0;)
+        {
+            std::uint32_t a = path.node[k];
+            int bf = balanceFactor(a) + (path.right[k] ? 1 : -1);
+            if (bf == 0)
+            {
+                setBalanceFactor(a, 0);
+                return;
+            }
+            if (bf == 1 || bf == -1)
+            {
+                setBalanceFactor(a, bf);
+                continue;
+            }
+            bool shorter;
+            replaceChild(path, k, rebalance(a, bf, shorter));
+            return;
+        }
+    }
+
+    /**
+     * @brief 平衡因子为 ±2 的节点 a 经过旋转恢复平衡，返回新的子树根
+     *
+     * 平衡因子只有两位，放不下 ±2，所以 a 的临时平衡因子由参数传入。
+     *
+     * @param a 失衡的节点
+     * @param bf a 的平衡因子，为 2 或 -2
+     * @param shorter 输出旋转后子树是否比失衡前矮了一层（删除时用来决定是否继续向上）
+     */
+    std::uint32_t rebalance(std::uint32_t a, int bf, bool &shorter)
+    {
+        bool heavy = bf > 0;       // 较高的一侧
+        int sign = heavy ? 1 : -1; // 把两种对称情况统一成“右侧较高”来计算
+        std::uint32_t b = child(a, heavy);
+        int bb = balanceFactor(b) * sign;
+        if (bb >= 0)
+        {
+            // 右右（或左左）情况：一次旋转
+            setChild(a, heavy, child(b, !heavy));
+            setChild(b, !heavy, a);
+            setBalanceFactor(a, (1 - bb) * sign);
+            setBalanceFactor(b, (bb - 1) * sign);
+            shorter = bb != 0;
+            return b;
+        }
+        // 右左（或左右）情况：两次旋转，b 的内侧孩子 c 成为新的根
+        std::uint32_t c = child(b, !heavy);
+        int bc = balanceFactor(c) * sign;
+        setChild(a, heavy, child(c, !heavy));
+        setChild(b, !heavy, child(c, heavy));
+        setChild(c, !heavy, a);
+        setChild(c, heavy, b);
+        setBalanceFactor(a, (bc == 1 ? -1 : 0) * sign);
+        setBalanceFactor(b, (bc == -1 ? 1 : 0) * sign);
+        setBalanceFactor(c, 0);
+        shorter = true;
+        return c;
+    }
+
+    /**
+     * @brief 回收已经从树上摘下的节点 victim
+     *
+     * 把最后一个节点搬进 victim 的位置再缩短数组。被搬动的节点仍在树上，
+     * 按它的元素从根查找一遍就能找到指向它的链接，改成新的下标。
+     */
+    void release(std::uint32_t victim)
+    {
+        std::uint32_t last = static_cast<std::uint32_t>(pool.size() - 1);
+        if (victim != last)
+        {
+            const Comparable &x = pool[last].element;
+            std::uint32_t parent = Nil;
+            bool right = false;
+            std::uint32_t t = root;
+            while (t != last)
+            {
+                parent = t;
+                right = comp(pool[t].element, x);
+                t = child(t, right);
+            }
+            pool[victim] = std::move(pool[last]);
+            if (parent == Nil)
+                root = victim;
+            else
+                setChild(parent, right, victim);
+        }
+        pool.pop_back();
+    }
+};
+
+#endif
@@ -0,0 +1,446 @@
+/**
+ * @file ConcurrentBST.h
+ * @brief 支持多线程无锁读的 AVL 树
+ *
+ * BinarySearchTree 没有任何同步，只能整体套一把互斥锁，读者要在写者后面排队。
+ * 这里的做法是写时复制（路径复制）：节点一旦发布就不再修改，写者把从根到
+ * 修改点的路径复制一份，其余子树与旧版本共享，最后用一次原子存储发布新根。
+ * 读者只需读一次根指针，之后看到的是一个完整、不变的版本，不需要加锁。
+ *
+ * 被替换下来的旧节点不能立即释放，因为可能还有读者在用。读者进入读区时
+ * 在当前“阶段”的计数器上加一，离开时减一；写者回收前切换阶段，等旧阶段的
+ * 计数归零，即所有可能看到旧节点的读者都已离开（一次宽限期），再统一释放。
+ * 计数器按线程分散在不同的缓存行上，读者之间几乎没有争用。
+ */
+
+#ifndef __CONCURRENT_BST_MARK__
+#define __CONCURRENT_BST_MARK__
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "BST.h"
+
+/**
+ * @brief 读者无锁、写者互斥的并发 AVL 树
+ *
+ * contains / findMin / findMax 可以在任意多个线程中与写者同时调用，
+ * 它们不加锁、不等待写者，只在写者切换阶段的瞬间可能重试一次登记。
+ * insert / remove 之间用互斥锁串行化，每次修改复制 O(log n) 个节点。
+ *
+ * @tparam Comparable 元素类型，需要可拷贝
+ */
+template <typename Comparable>
+class ConcurrentBinarySearchTree
+{
+public:
+    ConcurrentBinarySearchTree() : root{nullptr}, phase{0} {}
+
+    ConcurrentBinarySearchTree(const ConcurrentBinarySearchTree &) = delete;
+    ConcurrentBinarySearchTree &operator=(const ConcurrentBinarySearchTree &) = delete;
+
+    /**
+     * @brief 析构函数，调用者保证此时已经没有其他线程在访问
+     */
+    ~ConcurrentBinarySearchTree()
+    {
+        destroy(root.load(std::memory_order_relaxed));
+        for (const Node *t : retired)
+            delete t;
+    }
+
+    /**
+     * @brief 检查树中是否包含指定的元素，不加锁
+     */
+    bool contains(const Comparable &x) const
+    {
+        ReadSection section{*this};
+        const Node *t = root.load(std::memory_order_acquire);
+        while (t != nullptr)
+        {
+            if (x < t->element)
+                t = t->left;
+            else if (t->element < x)
+                t = t->right;
+            else
+                return true;
+        }
+        return false;
+    }
+
+    /**
+     * @brief 返回最小元素的副本，不加锁
+     *
+     * 读区结束后节点可能被回收，所以返回值而不是引用。
+     */
+    Comparable findMin() const
+    {
+        ReadSection section{*this};
+        const Node *t = root.load(std::memory_order_acquire);
+        if (t == nullptr)
+            throw UnderflowException{};
+        while (t->left != nullptr)
+            t = t->left;
+        return t->element;
+    }
+
+    /**
+     * @brief 返回最大元素的副本，不加锁
+     */
+    Comparable findMax() const
+    {
+        ReadSection section{*this};
+        const Node *t = root.load(std::memory_order_acquire);
+        if (t == nullptr)
+            throw UnderflowException{};
+        while (t->right != nullptr)
+            t = t->right;
+        return t->element;
+    }
+
+    bool isEmpty() const
+    {
+        return root.load(std::memory_order_acquire) == nullptr;
+    }
+
+    /**
+     * @brief 插入一个元素，已存在时什么也不做
+     */
+    void insert(const Comparable &x)
+    {
+        std::lock_guard<std::mutex> lock{writeLock};
+        update([&](const Node *old) { return insert(x, old); });
+        reclaimIfNeeded();
+    }
+
+    /**
+     * @brief 删除一个元素，不存在时什么也不做
+     */
+    void remove(const Comparable &x)
+    {
+        std::lock_guard<std::mutex> lock{writeLock};
+        update([&](const Node *old) { return remove(x, old); });
+        reclaimIfNeeded();
+    }
+
+    /**
+     * @brief 清空树，旧节点同样等宽限期过后再释放
+     */
+    void makeEmpty()
+    {
+        std::lock_guard<std::mutex> lock{writeLock};
+        update([&](const Node *old) {
+            retireAll(old);
+            return nullptr;
+        });
+        reclaimIfNeeded();
+    }
+
+private:
+    /**
+     * @brief 不可变节点，发布以后任何字段都不会再被修改
+     */
+    struct Node
+    {
+        Comparable element;
+        const Node *left;
+        const Node *right;
+        int height;
+    };
+
+    /// 读者计数器的分片数，每个分片独占一个缓存行
+    static constexpr std::size_t Stripes = 64;
+    /// 累积多少个待回收节点以后做一次宽限期
+    static constexpr std::size_t ReclaimThreshold = 4096;
+
+    struct alignas(64) PaddedCounter
+    {
+        std::atomic<long> value{0};
+    };
+
+    std::atomic<const Node *> root;                  ///< 当前版本的根
+    mutable std::atomic<unsigned> phase;             ///< 当前阶段，0 或 1
+    mutable PaddedCounter readers[2][Stripes];       ///< 每个阶段、每个分片上正在读的线程数
+    std::mutex writeLock;                            ///< 写者之间互斥
+    std::vector<const Node *> retired;               ///< 已被替换、等待回收的节点
+    std::vector<const Node *> created;               ///< 本次修改新建的节点
+    std::vector<const Node *> superseded;            ///< 本次修改替换下来的节点，发布新根后才移入 retired
+
+    /**
+     * @brief 当前线程使用的计数器分片，第一次调用时分配
+     */
+    static std::size_t threadStripe()
+    {
+        static std::atomic<std::size_t> nextStripe{0};
+        thread_local std::size_t stripe = nextStripe.fetch_add(1, std::memory_order_relaxed) % Stripes;
+        return stripe;
+    }
+
+    /**
+     * @brief 读区：构造时登记到当前阶段，析构时注销
+     *
+     * 登记后要再确认一次阶段没有变化。如果恰好在加一的前后阶段被切换了，
+     * 写者可能已经检查过这个计数器，那就撤销登记，换到新阶段重来。
+     */
+    class ReadSection
+    {
+    public:
+        explicit ReadSection(const ConcurrentBinarySearchTree &tree) : stripe{threadStripe()}
+        {
+            while (true)
+            {
+                unsigned p = tree.phase.load();
+                counter = &tree.readers[p][stripe].value;
+                counter->fetch_add(1);
+                if (tree.phase.load() == p)
+                    break;
+                counter->fetch_sub(1, std::memory_order_release);
+            }
+        }
+
+        ~ReadSection()
+        {
+            counter->fetch_sub(1, std::memory_order_release);
+        }
+
+        ReadSection(const ReadSection &) = delete;
+        ReadSection &operator=(const ReadSection &) = delete;
+
+    private:
+        std::size_t stripe;
+        std::atomic<long> *counter;
+    };
+
+    /**
+     * @brief 等待一次宽限期：切换阶段后，旧阶段上的读者全部离开
+     *
+     * 之后新进入的读者登记在新阶段，它们读到的一定是已经发布的新根。
+     */
+    void synchronize()
+    {
+        unsigned old = phase.load();
+        phase.store(old ^ 1u);
+        for (std::size_t i = 0; i < Stripes; ++i)
+        {
+            while (readers[old][i].value.load() != 0)
+                std::this_thread::yield();
+        }
+    }
+
+    /**
+     * @brief 待回收节点足够多时，等一次宽限期再统一释放
+     */
+    void reclaimIfNeeded()
+    {
+        if (retired.size() < ReclaimThreshold)
+            return;
+        synchronize();
+        for (const Node *t : retired)
+            delete t;
+        retired.clear();
+    }
+
+    /**
+     * @brief 在写锁内执行一次修改：f 由旧根算出新根，成功后发布新根
+     *
+     * 修改过程中新建节点（元素拷贝）可能抛出异常，这时旧根仍然是当前版本，
+     * 被替换下来的节点还可以被访问，不能交给回收；只释放这次新建的节点，树保持不变。
+     * 发布新根之前先为 retired 预留空间，发布之后就不会再失败。
+     */
+    template <typename F>
+    void update(F &&f)
+    {
+        const Node *old = root.load(std::memory_order_relaxed);
+        created.clear();
+        superseded.clear();
+        const Node *updated;
+        try
+        {
+            updated = f(old);
+            std::size_t needed = retired.size() + superseded.size();
+            if (needed > retired.capacity())
+                retired.reserve(std::max(needed, 2 * retired.capacity()));
+        }
+        catch (...)
+        {
+            for (const Node *t : created)
+                delete t;
+            created.clear();
+            superseded.clear();
+            throw;
+        }
+        if (updated != old)
+            root.store(updated, std::memory_order_release);
+        retired.insert(retired.end(), superseded.begin(), superseded.end());
+        created.clear();
+        superseded.clear();
+    }
+
+    /**
+     * @brief 记下被本次修改替换的节点
+     */
+    void retire(const Node *t)
+    {
+        superseded.push_back(t);
+    }
+
+    void retireAll(const Node *t)
+    {
+        if (t != nullptr)
+        {
+            retireAll(t->left);
+            retireAll(t->right);
+            retire(t);
+        }
+    }
+
+    void destroy(const Node *t)
+    {
+        if (t != nullptr)
+        {
+            destroy(t->left);
+            destroy(t->right);
+            delete t;
+        }
+    }
+
+    static int height(const Node *t)
+    {
+        return t == nullptr ? 0 : t->height;
+    }
+
+    /**
+     * @brief 新建节点并记入 created，修改失败时由 update 释放
+     */
+    const Node *make(const Node *l, const Comparable &x, const Node *r)
+    {
+        const Node *t = new Node{x, l, r, std::max(height(l), height(r)) + 1};
+        try
+        {
+            created.push_back(t);
+        }
+        catch (...)
+        {
+            delete t;
+            throw;
+        }
+        return t;
+    }
+
+    /**
+     * @brief 用左子树 l、元素 x、右子树 r 组成一棵平衡的新子树
+     *
+     * l 和 r 的高度差最多为 2。需要旋转时不能改旧节点，
+     * 而是新建旋转后的节点，被拆开的旧节点交给回收。
+     */
+    const Node *balance(const Node *l, const Comparable &x, const Node *r)
+    {
+        int hl = height(l);
+        int hr = height(r);
+        if (hl > hr + 1)
+        {
+            retire(l);
+            // 左左情况：一次右旋
+            if (height(l->left) >= height(l->right))
+                return make(l->left, l->element, make(l->right, x, r));
+            // 左右情况：两次旋转
+            const Node *lr = l->right;
+            retire(lr);
+            return make(make(l->left, l->element, lr->left), lr->element, make(lr->right, x, r));
+        }
+        if (hr > hl + 1)
+        {
+            retire(r);
+            // 右右情况：一次左旋
+            if (height(r->right) >= height(r->left))
+                return make(make(l, x, r->left), r->element, r->right);
+            // 右左情况：两次旋转
+            const Node *rl = r->left;
+            retire(rl);
+            return make(make(l, x, rl->left), rl->element, make(rl->right, r->element, r->right));
+        }
+        return make(l, x, r);
+    }
+
+    /**
+     * @brief 路径复制的插入，元素已存在时原样返回 t
+     */
+    const Node *insert(const Comparable &x, const Node *t)
+    {
+        if (t == nullptr)
+            return make(nullptr, x, nullptr);
+        if (x < t->element)
+        {
+            const Node *lt = insert(x, t->left);
+            if (lt == t->left)
+                return t;
+            retire(t);
+            return balance(lt, t->element, t->right);
+        }
+        if (t->element < x)
+        {
+            const Node *rt = insert(x, t->right);
+            if (rt == t->right)
+                return t;
+            retire(t);
+            return balance(t->left, t->element, rt);
+        }
+        return t;
+    }
+
+    /**
+     * @brief 路径复制地摘下子树中的最小节点
+     *
+     * @param minNode 输出被摘下的最小节点，它的元素由调用者复制
+     */
+    const Node *removeMin(const Node *t, const Node *&minNode)
+    {
+        retire(t);
+        if (t->left == nullptr)
+        {
+            minNode = t;
+            return t->right;
+        }
+        const Node *lt = removeMin(t->left, minNode);
+        return balance(lt, t->element, t->right);
+    }
+
+    /**
+     * @brief 路径复制的删除，元素不存在时原样返回 t
+     */
+    const Node *remove(const Comparable &x, const Node *t)
+    {
+        if (t == nullptr)
+            return nullptr;
+        if (x < t->element)
+        {
+            const Node *lt = remove(x, t->left);
+            if (lt == t->left)
+                return t;
+            retire(t);
+            return balance(lt, t->element, t->right);
+        }
+        if (t->element < x)
+        {
+            const Node *rt = remove(x, t->right);
+            if (rt == t->right)
+                return t;
+            retire(t);
+            return balance(t->left, t->element, rt);
+        }
+        retire(t);
+        if (t->left == nullptr)
+            return t->right;
+        if (t->right == nullptr)
+            return t->left;
+        const Node *minNode;
+        const Node *rt = removeMin(t->right, minNode);
+        return balance(t->left, minNode->element, rt);
+    }
+};
+
+#endif
@@ -0,0 +1,206 @@
+/**
+ * @file ForkJoinPool.h
+ * @brief 分治算法用的简单 fork-join 线程池
+ *
+ * 只提供一个原语 invoke(f, g)：f 在当前线程执行，g 放进队列等空闲的工作线程领取。
+ * 当前线程做完 f 以后，g 如果还没被领走就收回来自己做；已经被领走，
+ * 就一边执行队列里的其他任务一边等它完成，所以等待的线程不会闲着，也不会死锁。
+ * 递归算法在每一层调用 invoke，就得到它的并行版本。
+ */
+
+#ifndef __FORK_JOIN_POOL_MARK__
+#define __FORK_JOIN_POOL_MARK__
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+/**
+ * @brief fork-join 线程池
+ *
+ * 调用 invoke 的线程自己也参与计算，所以并发度为 n 的池只有 n - 1 个工作线程。
+ * 并发度为 1 时 invoke 直接依次执行两个任务，没有任何同步开销。
+ * 任务粒度应当比较粗（由调用者在递归到足够小时停止 fork），队列只用一把互斥锁保护。
+ */
+class ForkJoinPool
+{
+public:
+    /**
+     * @brief 构造线程池
+     *
+     * @param threads 并发度（包括调用者），默认是硬件线程数
+     */
+    explicit ForkJoinPool(unsigned threads = std::thread::hardware_concurrency())
+    {
+        for (unsigned i = 1; i < threads; ++i)
+            workers.emplace_back([this] { work(); });
+    }
+
+    ForkJoinPool(const ForkJoinPool &) = delete;
+    ForkJoinPool &operator=(const ForkJoinPool &) = delete;
+
+    ~ForkJoinPool()
+    {
+        {
+            std::lock_guard<std::mutex> guard{lock};
+            stopping = true;
+        }
+        ready.notify_all();
+        for (std::thread &t : workers)
+            t.join();
+    }
+
+    /**
+     * @brief 进程内共享的默认线程池，第一次使用时创建
+     */
+    static ForkJoinPool &shared()
+    {
+        static ForkJoinPool pool;
+        return pool;
+    }
+
+    /**
+     * @brief 参与计算的线程数，包括调用者
+     */
+    unsigned concurrency() const
+    {
+        return static_cast<unsigned>(workers.size()) + 1;
+    }
+
+    /**
+     * @brief 并行执行 f 和 g，两者都完成后返回
+     *
+     * 任何一个抛出异常，都等两者结束后再把异常抛给调用者（f 的优先）。
+     */
+    template <typename F, typename G>
+    void invoke(F &&f, G &&g)
+    {
+        if (workers.empty())
+        {
+            f();
+            g();
+            return;
+        }
+        using Callable = std::remove_reference_t<G>;
+        Task task{[](void *p) { (*static_cast<Callable *>(p))(); },
+                  const_cast<void *>(static_cast<const void *>(std::addressof(g)))};
+        push(&task);
+        std::exception_ptr error;
+        try
+        {
+            f();
+        }
+        catch (...)
+        {
+            error = std::current_exception();
+        }
+        if (reclaim(&task))
+            task.run();
+        else
+            while (!task.done.load(std::memory_order_acquire))
+                if (!runOne())
+                    std::this_thread::yield();
+        if (error)
+            std::rethrow_exception(error);
+        if (task.error)
+            std::rethrow_exception(task.error);
+    }
+
+private:
+    /**
+     * @brief 队列中的任务，存放在发起者的栈上，发起者等它完成后才返回
+     */
+    struct Task
+    {
+        void (*call)(void *);
+        void *arg;
+        std::atomic<bool> done{false};
+        std::exception_ptr error;
+
+        Task(void (*c)(void *), void *a) : call{c}, arg{a} {}
+
+        void run()
+        {
+            try
+            {
+                call(arg);
+            }
+            catch (...)
+            {
+                error = std::current_exception();
+            }
+            done.store(true, std::memory_order_release);
+        }
+    };
+
+    std::mutex lock;                  ///< 保护 queue 和 stopping
+    std::condition_variable ready;    ///< 队列非空或线程池关闭
+    std::deque<Task *> queue;         ///< 等待领取的任务，越靠前的越早放入、通常也越大
+    bool stopping = false;            ///< 析构时通知工作线程退出
+    std::vector<std::thread> workers; ///< 工作线程
+
+    void push(Task *task)
+    {
+        {
+            std::lock_guard<std::mutex> guard{lock};
+            queue.push_back(task);
+        }
+        ready.notify_one();
+    }
+
+    /**
+     * @brief 任务还没被领走时把它从队列中取回
+     */
+    bool reclaim(Task *task)
+    {
+        std::lock_guard<std::mutex> guard{lock};
+        auto it = std::find(queue.rbegin(), queue.rend(), task);
+        if (it == queue.rend())
+            return false;
+        queue.erase(std::next(it).base());
+        return true;
+    }
+
+    /**
+     * @brief 取出并执行一个最早放入的任务，队列为空时返回 false
+     */
+    bool runOne()
+    {
+        Task *task;
+        {
+            std::lock_guard<std::mutex> guard{lock};
+            if (queue.empty())
+                return false;
+            task = queue.front();
+            queue.pop_front();
+        }
+        task->run();
+        return true;
+    }
+
+    void work()
+    {
+        while (true)
+        {
+            Task *task;
+            {
+                std::unique_lock<std::mutex> guard{lock};
+                ready.wait(guard, [this] { return stopping || !queue.empty(); });
+                if (stopping)
+                    return;
+                task = queue.front();
+                queue.pop_front();
+            }
+            task->run();
+        }
+    }
+};
+
+#endif
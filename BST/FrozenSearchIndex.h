@@ -0,0 +1,182 @@
+/**
+ * @file FrozenSearchIndex.h
+ * @brief 只读的 Eytzinger（BFS 顺序）查找索引
+ *
+ * 把有序元素按完全二叉树的层序放进一个数组：下标 k 的两个孩子是 2k 和 2k+1。
+ * 查找时不需要任何指针，下降一层只是一次乘二加一，可以写成没有分支的形式；
+ * 而且前几层集中在数组开头，总在缓存里，更深的层可以提前几层预取。
+ * 适合读多写少的阶段：由 BinarySearchTree::freeze() 生成，之后不再修改。
+ */
+
+#ifndef __FROZEN_SEARCH_INDEX_MARK__
+#define __FROZEN_SEARCH_INDEX_MARK__
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <vector>
+
+/**
+ * @brief 不可修改的 Eytzinger 布局查找索引
+ *
+ * @tparam Comparable 元素类型，需要可拷贝
+ * @tparam Compare 比较器，与生成它的树相同
+ */
+template <typename Comparable, typename Compare = std::less<Comparable>>
+class FrozenSearchIndex
+{
+public:
+    /**
+     * @brief 构造一个空索引
+     */
+    FrozenSearchIndex() : count{0}, comp{} {}
+
+    /**
+     * @brief 从严格递增的区间构造索引
+     *
+     * 按中序递归地给完全二叉树的各个位置填值，O(n)。
+     *
+     * @param first 区间起点
+     * @param last 区间终点
+     * @param c 比较器
+     */
+    template <std::input_iterator InputIt>
+    FrozenSearchIndex(InputIt first, InputIt last, const Compare &c = Compare{}) : comp{c}
+    {
+        std::vector<Comparable> sorted(first, last);
+        count = sorted.size();
+        if (count == 0)
+            return;
+        // 下标 0 不用，放一份最小元素占位，使下标从 1 开始
+        data.assign(count + 1, sorted.front());
+        std::size_t next = 0;
+        fill(sorted, next, 1);
+    }
+
+    /**
+     * @brief 元素个数
+     */
+    std::size_t size() const
+    {
+        return count;
+    }
+
+    bool isEmpty() const
+    {
+        return count == 0;
+    }
+
+    /**
+     * @brief 检查索引中是否包含 x
+     */
+    bool contains(const Comparable &x) const
+    {
+        std::size_t k = search(x);
+        return k != 0 && !comp(x, data[k]);
+    }
+
+    /**
+     * @brief 第一个不小于 x 的元素
+     *
+     * @return 指向该元素的指针，不存在时返回 nullptr
+     */
+    const Comparable *lower_bound(const Comparable &x) const
+    {
+        std::size_t k = search(x);
+        return k == 0 ? nullptr : &data[k];
+    }
+
+    /**
+     * @brief 严格小于 x 的元素个数
+     *
+     * 找到 lower_bound 后，由它的下标算出它在有序序列中的名次，不需要额外存储。
+     */
+    std::size_t rank(const Comparable &x) const
+    {
+        std::size_t k = search(x);
+        return k == 0 ? count : rankOf(k);
+    }
+
+private:
+    std::vector<Comparable> data; ///< Eytzinger 顺序的元素，data[1] 是根
+    std::size_t count;            ///< 元素个数
+    [[no_unique_address]] Compare comp;
+
+    /// 一个缓存行能放下的元素个数，预取时往下看这么多个“孙辈”
+    static constexpr std::size_t BlockSize = sizeof(Comparable) >= 64 ? 1 : 64 / sizeof(Comparable);
+
+    /**
+     * @brief 中序填充：左子树、当前位置、右子树
+     */
+    void fill(std::vector<Comparable> &sorted, std::size_t &next, std::size_t k)
+    {
+        if (k > count)
+            return;
+        fill(sorted, next, 2 * k);
+        data[k] = std::move(sorted[next++]);
+        fill(sorted, next, 2 * k + 1);
+    }
+
+    /**
+     * @brief 以下标 k 为根的子树的大小，O(1)
+     *
+     * 完全二叉树中这棵子树在往下第 d 层占据 [k * 2^d, (k + 1) * 2^d)，
+     * 除了最深的一层都是满的，最深的一层截到 count 为止。
+     */
+    std::size_t subtreeSize(std::size_t k) const
+    {
+        if (k > count)
+            return 0;
+        // s 是最深一层相对 k 的层数
+        int s = std::bit_width(count) - std::bit_width(k);
+        if ((k << s) > count)
+            --s;
+        std::size_t full = (std::size_t{1} << s) - 1;
+        return full + std::min(count - (k << s) + 1, std::size_t{1} << s);
+    }
+
+    /**
+     * @brief 下标 k 处的元素在有序序列中的名次，O(log n)
+     *
+     * k 的二进制去掉最高位后，从高到低每一位是从根走到 k 的一步（0 向左，1 向右）。
+     * 每次向右走，就越过了当前节点和它的整棵左子树；最后再加上 k 自己的左子树。
+     */
+    std::size_t rankOf(std::size_t k) const
+    {
+        std::size_t r = 0;
+        std::size_t u = 1;
+        for (int bit = std::bit_width(k) - 2; bit >= 0; --bit)
+        {
+            std::size_t right = (k >> bit) & 1;
+            if (right)
+                r += subtreeSize(2 * u) + 1;
+            u = 2 * u + right;
+        }
+        return r + subtreeSize(2 * k);
+    }
+
+    /**
+     * @brief 找到第一个不小于 x 的元素的下标，不存在时返回 0
+     *
+     * 循环体只有一次比较，比较结果直接参与下标运算，没有分支。
+     * 走到底以后，下标的二进制末尾连续的 1 表示最后几步都向右走了，
+     * 去掉它们以及再上一位，就回到了最后一次向左走之前的节点，即答案。
+     */
+    std::size_t search(const Comparable &x) const
+    {
+        std::size_t k = 1;
+        while (k <= count)
+        {
+#if defined(__GNUC__)
+            // k * BlockSize 开始的一整个缓存行都是几层以后的后代，提前取进来
+            __builtin_prefetch(data.data() + std::min(k * BlockSize, count));
+#endif
+            k = 2 * k + comp(data[k], x);
+        }
+        return k >> (std::countr_one(k) + 1);
+    }
+};
+
+#endif
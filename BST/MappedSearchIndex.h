@@ -0,0 +1,191 @@
+/**
+ * @file MappedSearchIndex.h
+ * @brief 直接在内存映射的快照文件上查找的只读索引
+ *
+ * BinarySearchTree::save 写出的快照就是一个有序数组加一个文件头。
+ * 把文件 mmap 进来，不用反序列化、不用建树，打开的代价与元素个数无关；
+ * 查找时只有被二分访问到的页才会从磁盘读入，并由操作系统的页缓存在进程间共享。
+ * 适合重启后马上就要开始服务、之后又不再修改的大索引。只支持 POSIX 系统。
+ */
+
+#ifndef __MAPPED_SEARCH_INDEX_MARK__
+#define __MAPPED_SEARCH_INDEX_MARK__
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "BST.h"
+
+/**
+ * @brief 内存映射的只读快照索引
+ *
+ * 只能移动，不能拷贝；析构时解除映射。
+ *
+ * @tparam Comparable 元素类型，必须与写出快照的树相同，需要可平凡复制
+ * @tparam Compare 比较器，与写出快照的树相同
+ */
+template <typename Comparable, typename Compare = std::less<Comparable>>
+class MappedSearchIndex
+{
+    static_assert(std::is_trivially_copyable_v<Comparable>, "只有可平凡复制的元素才能直接映射");
+
+public:
+    /**
+     * @brief 映射一个快照文件
+     *
+     * 只检查文件头和文件长度，不读取元素，O(1)。
+     *
+     * @param path 由 BinarySearchTree::save 写出的文件
+     * @param c 比较器
+     * @throws IOException 文件无法打开或映射
+     * @throws IllegalArgumentException 不是本类型的快照，或文件长度与元素个数不符
+     */
+    explicit MappedSearchIndex(const std::string &path, const Compare &c = Compare{})
+        : mapping{nullptr}, bytes{0}, data{nullptr}, count{0}, comp{c}
+    {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            throw IOException{};
+        struct stat info;
+        if (::fstat(fd, &info) != 0)
+        {
+            ::close(fd);
+            throw IOException{};
+        }
+        bytes = static_cast<std::size_t>(info.st_size);
+        if (bytes < sizeof(SnapshotHeader))
+        {
+            ::close(fd);
+            throw IllegalArgumentException{};
+        }
+        void *p = ::mmap(nullptr, bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd); // 映射建立后文件描述符就不再需要了
+        if (p == MAP_FAILED)
+            throw IOException{};
+        mapping = p;
+
+        const SnapshotHeader *header = static_cast<const SnapshotHeader *>(mapping);
+        if (!header->matches<Comparable>() ||
+            header->count != (bytes - sizeof(SnapshotHeader)) / sizeof(Comparable) ||
+            (bytes - sizeof(SnapshotHeader)) % sizeof(Comparable) != 0)
+        {
+            unmap();
+            throw IllegalArgumentException{};
+        }
+        count = static_cast<std::size_t>(header->count);
+        data = reinterpret_cast<const Comparable *>(static_cast<const char *>(mapping) + sizeof(SnapshotHeader));
+    }
+
+    MappedSearchIndex(const MappedSearchIndex &) = delete;
+    MappedSearchIndex &operator=(const MappedSearchIndex &) = delete;
+
+    MappedSearchIndex(MappedSearchIndex &&rhs) noexcept
+        : mapping{std::exchange(rhs.mapping, nullptr)}, bytes{std::exchange(rhs.bytes, 0)},
+          data{std::exchange(rhs.data, nullptr)}, count{std::exchange(rhs.count, 0)}, comp{rhs.comp}
+    {
+    }
+
+    MappedSearchIndex &operator=(MappedSearchIndex &&rhs) noexcept
+    {
+        std::swap(mapping, rhs.mapping);
+        std::swap(bytes, rhs.bytes);
+        std::swap(data, rhs.data);
+        std::swap(count, rhs.count);
+        std::swap(comp, rhs.comp);
+        return *this;
+    }
+
+    ~MappedSearchIndex()
+    {
+        unmap();
+    }
+
+    /**
+     * @brief 元素个数
+     */
+    std::size_t size() const
+    {
+        return count;
+    }
+
+    bool isEmpty() const
+    {
+        return count == 0;
+    }
+
+    /**
+     * @brief 检查索引中是否包含 x
+     */
+    bool contains(const Comparable &x) const
+    {
+        std::size_t k = search(x);
+        return k != count && !comp(x, data[k]);
+    }
+
+    /**
+     * @brief 第一个不小于 x 的元素
+     *
+     * @return 指向映射区中该元素的指针，不存在时返回 nullptr
+     */
+    const Comparable *lower_bound(const Comparable &x) const
+    {
+        std::size_t k = search(x);
+        return k == count ? nullptr : data + k;
+    }
+
+    /**
+     * @brief 严格小于 x 的元素个数
+     */
+    std::size_t rank(const Comparable &x) const
+    {
+        return search(x);
+    }
+
+private:
+    void *mapping;            ///< 映射区起点，即文件头
+    std::size_t bytes;        ///< 映射区长度
+    const Comparable *data;   ///< 紧跟在文件头之后的有序元素
+    std::size_t count;        ///< 元素个数
+    [[no_unique_address]] Compare comp;
+
+    void unmap()
+    {
+        if (mapping != nullptr)
+            ::munmap(mapping, bytes);
+        mapping = nullptr;
+    }
+
+    /**
+     * @brief 第一个不小于 x 的元素的下标，不存在时返回 count
+     *
+     * 每轮把区间缩小一半，比较结果只决定起点要不要前移，没有难以预测的分支。
+     * 下一轮可能访问的两个位置提前预取，缺页和缓存未命中可以部分重叠。
+     */
+    std::size_t search(const Comparable &x) const
+    {
+        if (count == 0)
+            return 0;
+        const Comparable *first = data;
+        std::size_t len = count;
+        while (len > 1)
+        {
+            std::size_t half = len / 2;
+#if defined(__GNUC__)
+            __builtin_prefetch(first + half / 2);
+            __builtin_prefetch(first + half + half / 2);
+#endif
+            first = comp(first[half - 1], x) ? first + half : first;
+            len -= half;
+        }
+        return static_cast<std::size_t>(first - data) + comp(*first, x);
+    }
+};
+
+#endif
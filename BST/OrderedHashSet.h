@@ -0,0 +1,341 @@
+/**
+ * @file OrderedHashSet.h
+ * @brief AVL 树加上指向节点的开放寻址哈希表：精确查找 O(1)，同时保持有序
+ *
+ * 大多数查询只是问某个元素在不在，AVL 树每次都要从根走 log n 层；
+ * 哈希表查找是 O(1)，却没有顺序。这里把两者合在一起：元素只存一份，放在树的节点里，
+ * 哈希表的每个槽位存节点指针和元素的哈希值。旋转只改指针、不搬动节点，
+ * 所以槽位里的指针在树调整平衡以后依然有效。
+ * contains / find 只查哈希表；迭代、findMin / findMax、lower_bound 等有序操作只用树；
+ * insert / remove 同时维护两者。
+ */
+
+#ifndef __ORDERED_HASH_SET_MARK__
+#define __ORDERED_HASH_SET_MARK__
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+#include "BST.h"
+
+/**
+ * @brief 带哈希索引的有序集合
+ *
+ * 哈希表用线性探测，删除时把后面的元素往回挪（backward shift），不留墓碑，
+ * 负载因子不超过 3/4。哈希值先乘上一个黄金比例常数再取高位，
+ * 像 std::hash<int> 这样的恒等哈希也不会扎堆。
+ *
+ * @tparam Comparable 元素类型
+ * @tparam Hash 哈希函数
+ * @tparam KeyEqual 相等判断，必须与 Compare 的等价关系一致
+ * @tparam Compare 比较器，决定有序操作的顺序
+ * @tparam Allocator 树节点的分配器
+ */
+template <typename Comparable, typename Hash = std::hash<Comparable>, typename KeyEqual = std::equal_to<Comparable>,
+          typename Compare = std::less<Comparable>, typename Allocator = SlabAllocator<Comparable>>
+class OrderedHashSet : protected BinarySearchTree<Comparable, Compare, Allocator>
+{
+    using Tree = BinarySearchTree<Comparable, Compare, Allocator>;
+    using BinaryNode = typename Tree::BinaryNode;
+    using SearchPath = typename Tree::SearchPath;
+    using InsertPosition = typename Tree::InsertPosition;
+
+public:
+    using const_iterator = typename Tree::const_iterator;
+    using iterator = const_iterator;
+
+    OrderedHashSet() : hasher{}, equal{}, count{0}, shift{64} {}
+
+    /**
+     * @brief 拷贝构造函数：树深拷贝以后节点地址都变了，哈希表按新节点重建
+     */
+    OrderedHashSet(const OrderedHashSet &rhs)
+        : Tree(rhs), hasher{rhs.hasher}, equal{rhs.equal}, count{0}, shift{64}
+    {
+        rebuildIndex();
+    }
+
+    /**
+     * @brief 移动构造函数：节点原样交给新对象，哈希表直接接管
+     */
+    OrderedHashSet(OrderedHashSet &&rhs) noexcept
+        : Tree(std::move(rhs)), hasher{std::move(rhs.hasher)}, equal{std::move(rhs.equal)},
+          slots{std::move(rhs.slots)}, count{std::exchange(rhs.count, 0)}, shift{std::exchange(rhs.shift, 64)}
+    {
+        rhs.slots.clear();
+    }
+
+    OrderedHashSet &operator=(OrderedHashSet rhs) noexcept
+    {
+        Tree::operator=(std::move(static_cast<Tree &>(rhs)));
+        std::swap(hasher, rhs.hasher);
+        std::swap(equal, rhs.equal);
+        std::swap(slots, rhs.slots);
+        std::swap(count, rhs.count);
+        std::swap(shift, rhs.shift);
+        return *this;
+    }
+
+    using Tree::begin;
+    using Tree::end;
+    using Tree::findMin;
+    using Tree::findMax;
+    using Tree::isEmpty;
+    using Tree::lower_bound;
+    using Tree::upper_bound;
+    using Tree::printTree;
+    using Tree::exportTree;
+
+    /**
+     * @brief 元素个数
+     */
+    std::size_t size() const
+    {
+        return count;
+    }
+
+    /**
+     * @brief 检查集合中是否包含 x，只查哈希表，期望 O(1)
+     */
+    bool contains(const Comparable &x) const
+    {
+        return findSlot(x, hasher(x)) != NotFound;
+    }
+
+    /**
+     * @brief 查找 x，只查哈希表，期望 O(1)
+     *
+     * @return 指向该元素的迭代器，从它出发可以按顺序遍历；不存在时返回 end()
+     */
+    const_iterator find(const Comparable &x) const
+    {
+        std::size_t i = findSlot(x, hasher(x));
+        return this->makeIterator(i == NotFound ? nullptr : slots[i].node);
+    }
+
+    /**
+     * @brief 插入一个元素，已存在时什么也不做
+     *
+     * 先查哈希表，已存在就不必下降树；否则插入树中，再把新节点登记到哈希表。
+     *
+     * @param x 要插入的元素
+     */
+    void insert(const Comparable &x)
+    {
+        insertImpl(x);
+    }
+
+    /**
+     * @brief 插入一个右值元素，已存在时什么也不做
+     *
+     * @param x 要插入的元素
+     */
+    void insert(Comparable &&x)
+    {
+        insertImpl(std::move(x));
+    }
+
+    /**
+     * @brief 删除一个元素，不存在时什么也不做
+     *
+     * 由哈希表直接找到节点，再沿父指针得到树中的路径，删除时不需要任何比较。
+     *
+     * @param x 要删除的元素
+     */
+    void remove(const Comparable &x)
+    {
+        std::size_t i = findSlot(x, hasher(x));
+        if (i == NotFound)
+            return;
+        BinaryNode *t = slots[i].node;
+        eraseSlot(i);
+        --count;
+        SearchPath path;
+        this->detach(this->pathTo(t, path), path);
+        this->destroyNode(t);
+    }
+
+    /**
+     * @brief 删除所有元素，哈希表保留容量
+     */
+    void makeEmpty()
+    {
+        Tree::makeEmpty();
+        std::fill(slots.begin(), slots.end(), Slot{});
+        count = 0;
+    }
+
+    /**
+     * @brief 检查树的不变式，以及哈希表与树中的元素一一对应
+     */
+    bool validate() const
+    {
+        if (!Tree::validate())
+            return false;
+        std::size_t found = 0;
+        for (std::size_t i = 0; i < slots.size(); ++i)
+        {
+            if (slots[i].node == nullptr)
+                continue;
+            ++found;
+            if (findSlot(slots[i].node->element, slots[i].hash) != i)
+                return false;
+        }
+        std::size_t inTree = 0;
+        for (const_iterator it = begin(); it != end(); ++it)
+            ++inTree;
+        return found == count && inTree == count;
+    }
+
+private:
+    /**
+     * @brief 哈希表槽位：节点指针为空表示空槽，hash 用来先筛掉大部分不相等的元素
+     */
+    struct Slot
+    {
+        BinaryNode *node = nullptr;
+        std::size_t hash = 0;
+    };
+
+    static constexpr std::size_t NotFound = static_cast<std::size_t>(-1);
+    static constexpr std::size_t MinCapacity = 16;
+
+    [[no_unique_address]] Hash hasher;
+    [[no_unique_address]] KeyEqual equal;
+    std::vector<Slot> slots; ///< 容量是 2 的幂
+    std::size_t count;       ///< 元素个数
+    unsigned shift;          ///< 64 减去容量的位数，取乘积高位时右移的位数
+
+    /**
+     * @brief 哈希值对应的起始槽位：乘以 2^64 / 黄金比例后取高位
+     */
+    std::size_t home(std::size_t hash) const
+    {
+        return static_cast<std::size_t>((static_cast<std::uint64_t>(hash) * 0x9E3779B97F4A7C15ull) >> shift);
+    }
+
+    std::size_t mask() const
+    {
+        return slots.size() - 1;
+    }
+
+    /**
+     * @brief 找到存放与 x 相等元素的槽位，不存在时返回 NotFound
+     */
+    std::size_t findSlot(const Comparable &x, std::size_t hash) const
+    {
+        if (slots.empty())
+            return NotFound;
+        for (std::size_t i = home(hash);; i = (i + 1) & mask())
+        {
+            const Slot &slot = slots[i];
+            if (slot.node == nullptr)
+                return NotFound;
+            if (slot.hash == hash && equal(slot.node->element, x))
+                return i;
+        }
+    }
+
+    /**
+     * @brief 把节点放进从 home 开始的第一个空槽，调用前要保证有空位
+     */
+    void place(BinaryNode *node, std::size_t hash)
+    {
+        std::size_t i = home(hash);
+        while (slots[i].node != nullptr)
+            i = (i + 1) & mask();
+        slots[i] = {node, hash};
+    }
+
+    /**
+     * @brief 清空槽位 i，把后面同一簇中能往回挪的元素挪过来，保持探测链不断
+     */
+    void eraseSlot(std::size_t i)
+    {
+        for (std::size_t j = (i + 1) & mask(); slots[j].node != nullptr; j = (j + 1) & mask())
+        {
+            // j 处元素的起始位置 k 若不在 (i, j] 之间，就说明它探测时经过了 i，可以挪到 i
+            std::size_t k = home(slots[j].hash);
+            if (((j - k) & mask()) >= ((j - i) & mask()))
+            {
+                slots[i] = slots[j];
+                i = j;
+            }
+        }
+        slots[i] = Slot{};
+    }
+
+    /**
+     * @brief 保证能再放下 n 个元素而负载因子不超过 3/4
+     */
+    void reserveFor(std::size_t n)
+    {
+        if (n * 4 <= slots.size() * 3)
+            return;
+        std::size_t capacity = std::max(MinCapacity, slots.size() * 2);
+        while (n * 4 > capacity * 3)
+            capacity *= 2;
+        std::vector<Slot> old(capacity);
+        old.swap(slots);
+        shift = 64 - static_cast<unsigned>(std::countr_zero(capacity));
+        for (const Slot &slot : old)
+            if (slot.node != nullptr)
+                place(slot.node, slot.hash);
+    }
+
+    /**
+     * @brief 按树中现有的节点重新建立哈希表
+     */
+    void rebuildIndex()
+    {
+        slots.clear();
+        count = 0;
+        std::vector<BinaryNode *> pending;
+        if (this->root != nullptr)
+            pending.push_back(this->root);
+        while (!pending.empty())
+        {
+            BinaryNode *t = pending.back();
+            pending.pop_back();
+            ++count;
+            if (t->left != nullptr)
+                pending.push_back(t->left);
+            if (t->right != nullptr)
+                pending.push_back(t->right);
+        }
+        reserveFor(count);
+        if (this->root != nullptr)
+            pending.push_back(this->root);
+        while (!pending.empty())
+        {
+            BinaryNode *t = pending.back();
+            pending.pop_back();
+            place(t, hasher(t->element));
+            if (t->left != nullptr)
+                pending.push_back(t->left);
+            if (t->right != nullptr)
+                pending.push_back(t->right);
+        }
+    }
+
+    template <typename X>
+    void insertImpl(X &&x)
+    {
+        std::size_t hash = hasher(x);
+        if (findSlot(x, hash) != NotFound)
+            return;
+        // 先扩容再改树：扩容失败时什么都没有改变，之后的步骤不会再失败
+        reserveFor(count + 1);
+        SearchPath path;
+        InsertPosition pos = this->findInsertPosition(x, this->root, path);
+        BinaryNode *node = this->link(this->createNode(std::forward<X>(x), nullptr, nullptr), pos, path);
+        place(node, hash);
+        ++count;
+    }
+};
+
+#endif
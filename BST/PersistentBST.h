@@ -0,0 +1,358 @@
+/**
+ * @file PersistentBST.h
+ * @brief 可持久化（不可变、路径复制）的 AVL 树
+ *
+ * BinarySearchTree 的拷贝构造和赋值都要调用 clone() 深拷贝整棵树，代价 O(n)。
+ * 这里的节点一旦建成就不再修改，并带有引用计数：多棵树（多个版本）可以共享子树。
+ * 拷贝一棵树只是让根的引用计数加一，O(1)；插入删除只复制从根到修改点的
+ * O(log n) 个节点，其余子树与旧版本共享，旧版本不受任何影响。
+ */
+
+#ifndef __PERSISTENT_BST_MARK__
+#define __PERSISTENT_BST_MARK__
+
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <memory>
+#include <utility>
+#include <vector>
+#include "BST.h"
+
+/**
+ * @brief 可持久化 AVL 树
+ *
+ * 每个对象是一个版本的句柄。引用计数是原子的，所以不同线程可以各自持有、
+ * 修改自己的句柄（就像 std::shared_ptr），但同一个句柄不能被多个线程同时修改。
+ *
+ * @tparam Comparable 元素类型，需要可拷贝
+ */
+template <typename Comparable>
+class PersistentBinarySearchTree
+{
+public:
+    PersistentBinarySearchTree() : root{nullptr} {}
+
+    /**
+     * @brief 拷贝构造函数，只增加根的引用计数，O(1)
+     */
+    PersistentBinarySearchTree(const PersistentBinarySearchTree &rhs) : root{retain(rhs.root)} {}
+
+    PersistentBinarySearchTree(PersistentBinarySearchTree &&rhs) noexcept : root{rhs.root}
+    {
+        rhs.root = nullptr;
+    }
+
+    ~PersistentBinarySearchTree()
+    {
+        release(root);
+    }
+
+    /**
+     * @brief 拷贝赋值运算符，O(1)。先增加再减少，自赋值也安全
+     */
+    PersistentBinarySearchTree &operator=(const PersistentBinarySearchTree &rhs)
+    {
+        Node *old = root;
+        root = retain(rhs.root);
+        release(old);
+        return *this;
+    }
+
+    PersistentBinarySearchTree &operator=(PersistentBinarySearchTree &&rhs) noexcept
+    {
+        std::swap(root, rhs.root);
+        return *this;
+    }
+
+    /**
+     * @brief 取当前版本的快照，O(1)
+     *
+     * 之后对任何一方的修改都不会影响另一方。
+     */
+    PersistentBinarySearchTree snapshot() const
+    {
+        return *this;
+    }
+
+    const Comparable &findMin() const
+    {
+        if (isEmpty())
+            throw UnderflowException{};
+        const Node *t = root;
+        while (t->left != nullptr)
+            t = t->left;
+        return t->element;
+    }
+
+    const Comparable &findMax() const
+    {
+        if (isEmpty())
+            throw UnderflowException{};
+        const Node *t = root;
+        while (t->right != nullptr)
+            t = t->right;
+        return t->element;
+    }
+
+    bool contains(const Comparable &x) const
+    {
+        const Node *t = root;
+        while (t != nullptr)
+        {
+            if (x < t->element)
+                t = t->left;
+            else if (t->element < x)
+                t = t->right;
+            else
+                return true;
+        }
+        return false;
+    }
+
+    bool isEmpty() const
+    {
+        return root == nullptr;
+    }
+
+    /**
+     * @brief 中序打印，用显式栈遍历
+     */
+    void printTree(std::ostream &out = std::cout) const
+    {
+        if (isEmpty())
+        {
+            out << "Empty tree" << std::endl;
+            return;
+        }
+        std::vector<const Node *> path;
+        const Node *t = root;
+        while (t != nullptr || !path.empty())
+        {
+            while (t != nullptr)
+            {
+                path.push_back(t);
+                t = t->left;
+            }
+            t = path.back();
+            path.pop_back();
+            out << t->element << '\n';
+            t = t->right;
+        }
+        out.flush();
+    }
+
+    /**
+     * @brief 清空当前版本，其他版本共享的节点不受影响
+     */
+    void makeEmpty()
+    {
+        release(root);
+        root = nullptr;
+    }
+
+    /**
+     * @brief 插入一个元素，只复制一条路径，O(log n) 时间和空间
+     */
+    void insert(const Comparable &x)
+    {
+        NodeRef updated = insert(x, root);
+        release(root);
+        root = updated.release();
+    }
+
+    /**
+     * @brief 删除一个元素，只复制一条路径，O(log n) 时间和空间
+     */
+    void remove(const Comparable &x)
+    {
+        NodeRef updated = remove(x, root);
+        release(root);
+        root = updated.release();
+    }
+
+private:
+    /**
+     * @brief 不可变节点，refs 记录有多少个父节点或树句柄指向它
+     */
+    struct Node
+    {
+        Comparable element;
+        Node *left;
+        Node *right;
+        int height;
+        std::atomic<int> refs;
+
+        Node(const Comparable &x, Node *lt, Node *rt)
+            : element{x}, left{lt}, right{rt},
+              height{std::max(PersistentBinarySearchTree::height(lt), PersistentBinarySearchTree::height(rt)) + 1},
+              refs{1} {}
+    };
+
+    Node *root;
+
+    static int height(const Node *t)
+    {
+        return t == nullptr ? 0 : t->height;
+    }
+
+    static Node *retain(Node *t)
+    {
+        if (t != nullptr)
+            t->refs.fetch_add(1, std::memory_order_relaxed);
+        return t;
+    }
+
+    /**
+     * @brief 放弃一个引用，最后一个引用消失时连同不再被共享的子树一起释放
+     */
+    static void release(Node *t)
+    {
+        if (t != nullptr && t->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            release(t->left);
+            release(t->right);
+            delete t;
+        }
+    }
+
+    /**
+     * @brief 放弃引用的删除器
+     */
+    struct Releaser
+    {
+        void operator()(Node *t) const
+        {
+            release(t);
+        }
+    };
+
+    /// 持有一个引用的节点指针。修改途中抛出异常时，已经取得的引用随之放弃，不会泄漏
+    using NodeRef = std::unique_ptr<Node, Releaser>;
+
+    /**
+     * @brief 取得 t 的一个新引用
+     */
+    static NodeRef share(Node *t)
+    {
+        return NodeRef{retain(t)};
+    }
+
+    /**
+     * @brief 新建节点，接管 l 和 r 的引用
+     *
+     * 节点构造成功以后才接管；构造（元素拷贝）抛出异常时 l 和 r 由参数析构放弃。
+     */
+    static NodeRef make(NodeRef l, const Comparable &x, NodeRef r)
+    {
+        NodeRef t{new Node{x, l.get(), r.get()}};
+        l.release();
+        r.release();
+        return t;
+    }
+
+    /**
+     * @brief 用 l、x、r 组成一棵平衡的新子树，接管 l 和 r 的引用
+     *
+     * 需要旋转时不改动被拆开的节点，而是取出（并引用）它的孩子组成新节点，
+     * 最后放弃对被拆开节点的引用。它若没有被其他版本共享，就会在这里释放。
+     * x 可能是被拆开节点中的元素，所以被拆开的节点在新节点建好以后才放弃。
+     */
+    static NodeRef balance(NodeRef l, const Comparable &x, NodeRef r)
+    {
+        int hl = height(l.get());
+        int hr = height(r.get());
+        if (hl > hr + 1)
+        {
+            // 左左情况：一次右旋
+            if (height(l->left) >= height(l->right))
+                return make(share(l->left), l->element, make(share(l->right), x, std::move(r)));
+            // 左右情况：两次旋转
+            Node *lr = l->right;
+            return make(make(share(l->left), l->element, share(lr->left)), lr->element,
+                        make(share(lr->right), x, std::move(r)));
+        }
+        if (hr > hl + 1)
+        {
+            // 右右情况：一次左旋
+            if (height(r->right) >= height(r->left))
+                return make(make(std::move(l), x, share(r->left)), r->element, share(r->right));
+            // 右左情况：两次旋转
+            Node *rl = r->left;
+            return make(make(std::move(l), x, share(rl->left)), rl->element,
+                        make(share(rl->right), r->element, share(r->right)));
+        }
+        return make(std::move(l), x, std::move(r));
+    }
+
+    /**
+     * @brief 在 t 中插入 x，返回新版本子树的一个引用；不需要修改时返回 t 本身
+     *
+     * t 是借用的，调用结束后仍由调用者持有。
+     */
+    static NodeRef insert(const Comparable &x, Node *t)
+    {
+        if (t == nullptr)
+            return make(nullptr, x, nullptr);
+        if (x < t->element)
+        {
+            NodeRef lt = insert(x, t->left);
+            if (lt.get() == t->left)
+                return share(t);
+            return balance(std::move(lt), t->element, share(t->right));
+        }
+        if (t->element < x)
+        {
+            NodeRef rt = insert(x, t->right);
+            if (rt.get() == t->right)
+                return share(t);
+            return balance(share(t->left), t->element, std::move(rt));
+        }
+        return share(t);
+    }
+
+    /**
+     * @brief 去掉 t 中的最小元素，返回新版本子树的一个引用
+     */
+    static NodeRef removeMin(Node *t)
+    {
+        if (t->left == nullptr)
+            return share(t->right);
+        return balance(removeMin(t->left), t->element, share(t->right));
+    }
+
+    /**
+     * @brief 在 t 中删除 x，返回新版本子树的一个引用；不需要修改时返回 t 本身
+     *
+     * 被删节点的后继元素直接从旧版本中拷贝，旧版本此时仍被调用者持有。
+     */
+    static NodeRef remove(const Comparable &x, Node *t)
+    {
+        if (t == nullptr)
+            return nullptr;
+        if (x < t->element)
+        {
+            NodeRef lt = remove(x, t->left);
+            if (lt.get() == t->left)
+                return share(t);
+            return balance(std::move(lt), t->element, share(t->right));
+        }
+        if (t->element < x)
+        {
+            NodeRef rt = remove(x, t->right);
+            if (rt.get() == t->right)
+                return share(t);
+            return balance(share(t->left), t->element, std::move(rt));
+        }
+        if (t->left == nullptr)
+            return share(t->right);
+        if (t->right == nullptr)
+            return share(t->left);
+        const Node *successor = t->right;
+        while (successor->left != nullptr)
+            successor = successor->left;
+        return balance(share(t->left), successor->element, removeMin(t->right));
+    }
+};
+
+#endif
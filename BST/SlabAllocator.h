@@ -0,0 +1,313 @@
+/**
+ * @file SlabAllocator.h
+ * @brief 为树节点准备的块式（slab/arena）分配器
+ *
+ * 节点按块成批地从系统申请，释放的节点挂到空闲链表上供下次复用。
+ * 这样插入删除基本不再调用 malloc/free，节点在内存中也更紧凑。
+ * 整棵树丢弃时，可以直接按块归还内存，不必逐个 delete。
+ */
+
+#ifndef __SLAB_ALLOCATOR_MARK__
+#define __SLAB_ALLOCATOR_MARK__
+
+#include <algorithm>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+/**
+ * @brief 块式节点分配器
+ *
+ * 提供 allocate/deallocate/rebind 等接口，可以经由 std::allocator_traits 换成节点类型使用，
+ * 但不满足标准库 Allocator 的全部要求：拷贝得到的是一个新的空池，与源对象不相等，
+ * 也不能释放源对象分配的内存；拷贝赋值被禁用。标准容器假定副本相等，不能用它。
+ * 它是为本目录中的树（BinarySearchTree 及以它为基础的容器）设计的：
+ * 树的拷贝本来就要逐个复制节点，各用各的池；转移节点前树先比较分配器，必要时用 splice() 并池。
+ * 每个分配器对象引用一个内存池，只有引用同一个池才相等（才能释放彼此分配的内存）。
+ * 需要多个对象共用一个池时显式调用 share()，池由引用计数管理，最后一个引用消失时归还全部块。
+ * 引用计数不是原子的：共用一个池的分配器不能在不同线程中同时使用。
+ *
+ * @tparam T 分配的对象类型
+ * @tparam MaxChunkSize 单个块最多容纳的对象数，块的大小从小到大倍增到这个上限
+ */
+template <typename T, std::size_t MaxChunkSize = 4096>
+class SlabAllocator
+{
+public:
+    using value_type = T;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+    using is_always_equal = std::false_type;
+
+    template <typename U>
+    struct rebind
+    {
+        using other = SlabAllocator<U, MaxChunkSize>;
+    };
+
+    SlabAllocator() noexcept = default;
+
+    /**
+     * @brief 拷贝构造函数
+     *
+     * 得到一个新的空池；要共用同一个池请用 share()。
+     */
+    SlabAllocator(const SlabAllocator &) noexcept : SlabAllocator{} {}
+
+    /**
+     * @brief 从其他类型的分配器转换（rebind 时使用），同样得到一个新的空池
+     */
+    template <typename U>
+    SlabAllocator(const SlabAllocator<U, MaxChunkSize> &) noexcept : SlabAllocator{} {}
+
+    /**
+     * @brief 移动构造函数，直接接管对方的池
+     */
+    SlabAllocator(SlabAllocator &&rhs) noexcept : pool{rhs.pool}
+    {
+        rhs.pool = nullptr;
+    }
+
+    SlabAllocator &operator=(SlabAllocator &&rhs) noexcept
+    {
+        swap(rhs);
+        return *this;
+    }
+
+    SlabAllocator &operator=(const SlabAllocator &) = delete;
+
+    ~SlabAllocator()
+    {
+        drop();
+    }
+
+    /**
+     * @brief 返回一个与本对象共用内存池的分配器，两者相等
+     *
+     * 本对象还没有池时先建一个。
+     */
+    SlabAllocator share()
+    {
+        if (pool == nullptr)
+            pool = new Pool;
+        ++pool->refs;
+        return SlabAllocator{pool};
+    }
+
+    /**
+     * @brief 内存池是否还被其他分配器引用
+     */
+    bool isShared() const noexcept
+    {
+        return pool != nullptr && pool->refs > 1;
+    }
+
+    /**
+     * @brief 分配 n 个对象的空间
+     *
+     * 单个对象优先从空闲链表取，其次从当前块切出；成片的请求直接交给全局 operator new。
+     */
+    T *allocate(std::size_t n)
+    {
+        if (n != 1)
+            return static_cast<T *>(::operator new(n * sizeof(T), std::align_val_t{alignof(T)}));
+
+        if (pool == nullptr)
+            pool = new Pool;
+        if (pool->freeList != nullptr)
+        {
+            Slot *slot = pool->freeList;
+            pool->freeList = slot->next;
+            return reinterpret_cast<T *>(slot);
+        }
+        if (pool->cursor == pool->chunkEnd)
+            pool->grow();
+        return reinterpret_cast<T *>(pool->cursor++);
+    }
+
+    /**
+     * @brief 归还 n 个对象的空间，单个对象挂回空闲链表，不会真正释放内存
+     */
+    void deallocate(T *p, std::size_t n) noexcept
+    {
+        if (n != 1)
+        {
+            ::operator delete(p, std::align_val_t{alignof(T)});
+            return;
+        }
+        Slot *slot = reinterpret_cast<Slot *>(p);
+        slot->next = pool->freeList;
+        pool->freeList = slot;
+    }
+
+    /**
+     * @brief 一次性归还所有块
+     *
+     * 调用后之前分配出去的对象全部失效，且不会调用它们的析构函数，
+     * 由调用者保证这些对象已经析构或者不需要析构。代价只和块数有关。
+     * 池还被其他分配器共用时不能归还，只放弃本对象的引用、换成一个新的空池，
+     * 块由最后一个引用者归还。
+     */
+    void release() noexcept
+    {
+        if (pool == nullptr)
+            return;
+        if (isShared())
+        {
+            drop();
+            return;
+        }
+        pool->freeChunks();
+    }
+
+    /**
+     * @brief 把另一个池的全部内存并入当前池
+     *
+     * 之后 rhs 分配出去的对象改由当前池负责释放，rhs 变为空池。
+     * rhs 的池还被其他分配器共用时不能并入（它们还会往那个池里归还对象），返回 false。
+     *
+     * @return 之后能否用本分配器释放 rhs 分配的对象
+     */
+    bool splice(SlabAllocator &rhs) noexcept
+    {
+        if (*this == rhs || rhs.pool == nullptr)
+            return true;
+        if (rhs.isShared())
+            return false;
+        if (pool == nullptr)
+        {
+            pool = std::exchange(rhs.pool, nullptr);
+            return true;
+        }
+        Pool *from = rhs.pool;
+        // 对方当前块中未切出的部分不能丢，把它们逐个挂到空闲链表上
+        while (from->cursor != from->chunkEnd)
+            rhs.deallocate(reinterpret_cast<T *>(from->cursor++), 1);
+        if (from->chunks != nullptr)
+        {
+            Chunk *last = from->chunks;
+            while (last->next != nullptr)
+                last = last->next;
+            last->next = pool->chunks;
+            pool->chunks = from->chunks;
+        }
+        if (from->freeList != nullptr)
+        {
+            Slot *last = from->freeList;
+            while (last->next != nullptr)
+                last = last->next;
+            last->next = pool->freeList;
+            pool->freeList = from->freeList;
+        }
+        from->chunks = nullptr;
+        from->freeList = nullptr;
+        from->cursor = from->chunkEnd = nullptr;
+        from->nextChunkSize = MinChunkSize;
+        return true;
+    }
+
+    void swap(SlabAllocator &rhs) noexcept
+    {
+        std::swap(pool, rhs.pool);
+    }
+
+    friend void swap(SlabAllocator &lhs, SlabAllocator &rhs) noexcept
+    {
+        lhs.swap(rhs);
+    }
+
+    /// 只有同一个池才能释放彼此的内存
+    bool operator==(const SlabAllocator &rhs) const noexcept
+    {
+        return this == &rhs || (pool != nullptr && pool == rhs.pool);
+    }
+
+private:
+    /// 一个槽位，空闲时存放链表指针，使用时存放对象
+    union Slot
+    {
+        Slot *next;
+        alignas(T) unsigned char storage[sizeof(T)];
+    };
+
+    /// 块头，后面紧跟着 capacity 个槽位
+    struct Chunk
+    {
+        Chunk *next;
+        std::size_t capacity;
+
+        Slot *slots()
+        {
+            return reinterpret_cast<Slot *>(reinterpret_cast<unsigned char *>(this) + HeaderSize);
+        }
+    };
+
+    static constexpr std::size_t MinChunkSize = MaxChunkSize < 32 ? MaxChunkSize : 32;
+    static constexpr std::size_t ChunkAlign = alignof(Chunk) > alignof(Slot) ? alignof(Chunk) : alignof(Slot);
+    /// 块头大小向上对齐到槽位的对齐要求，保证第一个槽位对齐
+    static constexpr std::size_t HeaderSize =
+        (sizeof(Chunk) + alignof(Slot) - 1) / alignof(Slot) * alignof(Slot);
+
+    /**
+     * @brief 内存池：块、空闲链表，以及引用它的分配器个数
+     */
+    struct Pool
+    {
+        Chunk *chunks = nullptr;    ///< 已申请的块组成的链表
+        Slot *freeList = nullptr;   ///< 被归还的槽位组成的链表
+        Slot *cursor = nullptr;     ///< 当前块中下一个未使用的槽位
+        Slot *chunkEnd = nullptr;   ///< 当前块的末尾
+        std::size_t nextChunkSize = MinChunkSize;
+        std::size_t refs = 1;       ///< 引用这个池的分配器个数
+
+        ~Pool()
+        {
+            freeChunks();
+        }
+
+        /**
+         * @brief 申请一个新块，块的大小倍增，直到 MaxChunkSize
+         */
+        void grow()
+        {
+            std::size_t capacity = nextChunkSize;
+            void *memory = ::operator new(HeaderSize + capacity * sizeof(Slot), std::align_val_t{ChunkAlign});
+            Chunk *chunk = ::new (memory) Chunk{chunks, capacity};
+            chunks = chunk;
+            cursor = chunk->slots();
+            chunkEnd = cursor + capacity;
+            if (nextChunkSize < MaxChunkSize)
+                nextChunkSize = std::min(nextChunkSize * 2, MaxChunkSize);
+        }
+
+        void freeChunks() noexcept
+        {
+            while (chunks != nullptr)
+            {
+                Chunk *next = chunks->next;
+                ::operator delete(chunks, std::align_val_t{ChunkAlign});
+                chunks = next;
+            }
+            freeList = nullptr;
+            cursor = chunkEnd = nullptr;
+            nextChunkSize = MinChunkSize;
+        }
+    };
+
+    Pool *pool = nullptr; ///< 引用的内存池，第一次分配或共用时才创建
+
+    explicit SlabAllocator(Pool *p) noexcept : pool{p} {}
+
+    /**
+     * @brief 放弃对池的引用，最后一个引用者归还全部块
+     */
+    void drop() noexcept
+    {
+        if (pool != nullptr && --pool->refs == 0)
+            delete pool;
+        pool = nullptr;
+    }
+};
+
+#endif
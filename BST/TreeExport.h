@@ -0,0 +1,268 @@
+/**
+ * @file TreeExport.h
+ * @brief 树导出用的输出缓冲区和格式
+ *
+ * 原来的 printTree 每个元素后面写一个 std::endl，每打印一个节点就刷新一次流，
+ * 导出大树时时间几乎全花在系统调用上。这里先把文本攒在一块缓冲区里，
+ * 满了才整块交给输出端（sink），整数用 std::to_chars 直接转成文本，不经过流的格式化。
+ * 输出端可以是任何接受 std::string_view 的可调用对象，也可以是 std::ostream。
+ */
+
+#ifndef __TREE_EXPORT_MARK__
+#define __TREE_EXPORT_MARK__
+
+#include <charconv>
+#include <cmath>
+#include <concepts>
+#include <cstddef>
+#include <optional>
+#include <ostream>
+#include <span>
+#include <sstream>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+/**
+ * @brief 导出格式
+ */
+enum class ExportFormat
+{
+    InOrder, ///< 中序文本，每行一个元素，与 printTree 相同
+    Dot,     ///< Graphviz DOT，画出树的形状和平衡信息
+    Json     ///< 嵌套的 JSON 对象：{"value": ..., "left": ..., "right": ...}，空子树为 null
+};
+
+/**
+ * @brief 输出端：能接受一段 std::string_view 的可调用对象
+ */
+template <typename Sink>
+concept ExportSink = std::invocable<Sink &, std::string_view>;
+
+/**
+ * @brief 把 std::ostream 包装成输出端，每次整块写入
+ */
+struct StreamSink
+{
+    std::ostream &out;
+
+    void operator()(std::string_view text) const
+    {
+        out.write(text.data(), static_cast<std::streamsize>(text.size()));
+    }
+};
+
+/**
+ * @brief 攒满一块再交给输出端的文本缓冲区
+ *
+ * 析构时不会自动 flush（flush 可能抛出异常），写完以后要显式调用。
+ *
+ * @tparam Sink 输出端类型
+ */
+template <ExportSink Sink>
+class ExportBuffer
+{
+public:
+    /// 调用者没有提供缓冲区时使用的大小
+    static constexpr std::size_t DefaultBytes = std::size_t{1} << 16;
+
+    /**
+     * @brief 构造缓冲区
+     *
+     * @param sink 输出端
+     * @param storage 调用者提供的缓冲区，为空时自己申请一块
+     */
+    explicit ExportBuffer(Sink &sink, std::span<char> storage = {}) : sink{sink}, used{0}
+    {
+        if constexpr (std::is_same_v<std::remove_const_t<Sink>, StreamSink>)
+            style = &sink.out;
+        if (storage.size() < MinBytes)
+        {
+            owned.resize(DefaultBytes);
+            storage = owned;
+        }
+        buffer = storage;
+    }
+
+    ExportBuffer(const ExportBuffer &) = delete;
+    ExportBuffer &operator=(const ExportBuffer &) = delete;
+
+    void put(char c)
+    {
+        if (used == buffer.size())
+            flush();
+        buffer[used++] = c;
+    }
+
+    void put(std::string_view text)
+    {
+        if (text.size() > buffer.size() - used)
+        {
+            flush();
+            // 比整个缓冲区还长的文本直接交给输出端
+            if (text.size() > buffer.size())
+            {
+                sink(text);
+                return;
+            }
+        }
+        text.copy(buffer.data() + used, text.size());
+        used += text.size();
+    }
+
+    /**
+     * @brief 原样写出一个值，与 out << x 的结果相同
+     *
+     * 输出端是 StreamSink 时沿用那个流的格式标志和精度（std::hex、std::setprecision 等），
+     * 但不理会宽度和 locale；其他输出端按流的默认格式。
+     */
+    template <typename T>
+    void putValue(const T &x)
+    {
+        format(x, style, [this](std::string_view text, bool) { put(text); });
+    }
+
+    /**
+     * @brief 写出一个 JSON 值：数值原样写出，其他的写成转义后的字符串
+     *
+     * 总是按默认格式转换，不受输出流格式标志的影响，保证数值是合法的 JSON。
+     * 浮点数用 std::to_chars 的最短表示，读回来与原值完全相同；
+     * NaN 和无穷大在 JSON 中没有对应的数值，写成 null。
+     */
+    template <typename T>
+    void putJson(const T &x)
+    {
+        if constexpr (std::is_floating_point_v<T>)
+        {
+            if (!std::isfinite(x))
+            {
+                put("null");
+                return;
+            }
+            char text[MinBytes];
+            auto result = std::to_chars(text, text + sizeof(text), x);
+            put(std::string_view{text, static_cast<std::size_t>(result.ptr - text)});
+            return;
+        }
+        format(x, nullptr, [this](std::string_view text, bool numeric) {
+            if (numeric)
+            {
+                put(text);
+                return;
+            }
+            put('"');
+            for (char c : text)
+            {
+                if (c == '"' || c == '\\')
+                {
+                    put('\\');
+                    put(c);
+                }
+                else if (static_cast<unsigned char>(c) < 0x20)
+                {
+                    const char *hex = "0123456789abcdef";
+                    put("\\u00");
+                    put(hex[(c >> 4) & 0xf]);
+                    put(hex[c & 0xf]);
+                }
+                else
+                {
+                    put(c);
+                }
+            }
+            put('"');
+        });
+    }
+
+    /**
+     * @brief 写出一个放在 DOT 双引号标签中的值，转义引号、反斜杠和换行，格式与 putValue 相同
+     */
+    template <typename T>
+    void putDotLabel(const T &x)
+    {
+        format(x, style, [this](std::string_view text, bool) {
+            for (char c : text)
+            {
+                if (c == '"' || c == '\\')
+                    put('\\');
+                if (c == '\n')
+                    put("\\n");
+                else
+                    put(c);
+            }
+        });
+    }
+
+    /**
+     * @brief 把缓冲区中的内容交给输出端
+     */
+    void flush()
+    {
+        if (used > 0)
+            sink(std::string_view{buffer.data(), used});
+        used = 0;
+    }
+
+private:
+    /// 至少要放得下一个 to_chars 的结果
+    static constexpr std::size_t MinBytes = 64;
+
+    Sink &sink;
+    std::span<char> buffer;
+    std::size_t used;
+    std::vector<char> owned;
+    std::optional<std::ostringstream> scratch; ///< 只有元素类型需要 operator<< 时才创建
+    const std::ostream *style = nullptr;       ///< putValue 沿用其格式的流，没有时用默认格式
+
+    /**
+     * @brief 把 x 转成文本交给 use，同时告诉它这是不是一个数值
+     *
+     * 十进制、不带正号的整数用 std::to_chars，结果与 operator<< 相同；
+     * 能转成 std::string_view 的类型直接使用；其余类型退回到 operator<<，
+     * 包括浮点数（to_chars 的最短表示与流的默认 6 位有效数字不同）和按字符输出的 char、bool。
+     * JSON 中的浮点数由 putJson 自己处理，不经过这里。
+     *
+     * @param like 按它的格式标志和精度转换，为空时用默认格式
+     */
+    template <typename T, typename Use>
+    void format(const T &x, const std::ostream *like, Use &&use)
+    {
+        constexpr bool integer = std::is_integral_v<T> && !std::is_same_v<T, bool> && !std::is_same_v<T, char> &&
+                                 !std::is_same_v<T, signed char> && !std::is_same_v<T, unsigned char>;
+        constexpr std::ios_base::fmtflags special = std::ios_base::basefield | std::ios_base::showpos;
+        if constexpr (integer)
+        {
+            if (like == nullptr || (like->flags() & special) == std::ios_base::dec)
+            {
+                char text[MinBytes];
+                auto result = std::to_chars(text, text + sizeof(text), x);
+                use(std::string_view{text, static_cast<std::size_t>(result.ptr - text)}, true);
+                return;
+            }
+        }
+        if constexpr (std::is_convertible_v<const T &, std::string_view>)
+        {
+            use(std::string_view{x}, false);
+        }
+        else
+        {
+            if (!scratch)
+                scratch.emplace();
+            scratch->str({});
+            if (like != nullptr)
+            {
+                scratch->flags(like->flags());
+                scratch->precision(like->precision());
+            }
+            else
+            {
+                scratch->flags(std::ios_base::skipws | std::ios_base::dec);
+                scratch->precision(6);
+            }
+            *scratch << x;
+            use(scratch->view(), integer);
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,370 @@
+/**
+ * @file TreeMap.h
+ * @brief 建立在 BinarySearchTree 之上的有序键值映射
+ *
+ * BinarySearchTree 只是集合：元素就是键，没有附带的值。拿 std::pair 当元素、
+ * 再写一个只比较 first 的比较器也能凑合，但“查一下、没有就插入、有就更新”要下降两次。
+ * 这里元素是“键 + 可变的值”，比较器透明地只比较键，
+ * 所有更新操作都只下降一次：找到就就地修改，找不到就在同一个位置挂上新节点。
+ */
+
+#ifndef __TREE_MAP_MARK__
+#define __TREE_MAP_MARK__
+
+#include <cstddef>
+#include <functional>
+#include <iostream>
+#include <utility>
+#include "BST.h"
+
+/**
+ * @brief TreeMap 的元素：键和值
+ *
+ * 成员名与 std::pair 相同。键决定元素在树中的位置，与 std::map 一样声明为 const；
+ * 值只能经由非 const 的 TreeMap 给出的 iterator 修改。
+ */
+template <typename Key, typename Value>
+struct TreeMapEntry
+{
+    const Key first;
+    Value second;
+
+    /**
+     * @brief 用键和构造值的参数直接构造
+     */
+    template <typename K, typename... Args>
+    explicit TreeMapEntry(K &&key, Args &&...args) : first(std::forward<K>(key)), second(std::forward<Args>(args)...)
+    {
+    }
+
+    friend std::ostream &operator<<(std::ostream &out, const TreeMapEntry &entry)
+    {
+        return out << entry.first << ": " << entry.second;
+    }
+};
+
+/**
+ * @brief 只比较键的透明比较器，既能比较两个元素，也能直接拿键和元素比较
+ */
+template <typename Key, typename Value, typename Compare>
+struct TreeMapKeyCompare
+{
+    using is_transparent = void;
+    using Entry = TreeMapEntry<Key, Value>;
+
+    [[no_unique_address]] Compare comp;
+
+    bool operator()(const Entry &a, const Entry &b) const
+    {
+        return comp(a.first, b.first);
+    }
+
+    bool operator()(const Key &a, const Entry &b) const
+    {
+        return comp(a, b.first);
+    }
+
+    bool operator()(const Entry &a, const Key &b) const
+    {
+        return comp(a.first, b);
+    }
+};
+
+/**
+ * @brief 有序键值映射，底层是 AVL 树
+ *
+ * 迭代器按键从小到大访问 TreeMapEntry，it->first 是键，it->second 是值。
+ * 非 const 的映射给出 iterator，可以经由它修改值；const 的映射只给出 const_iterator。
+ *
+ * @tparam Key 键类型
+ * @tparam Value 值类型
+ * @tparam Compare 键的比较器
+ * @tparam Allocator 节点的分配器
+ */
+template <typename Key, typename Value, typename Compare = std::less<Key>,
+          typename Allocator = SlabAllocator<TreeMapEntry<Key, Value>>>
+class TreeMap : protected BinarySearchTree<TreeMapEntry<Key, Value>, TreeMapKeyCompare<Key, Value, Compare>, Allocator>
+{
+    using Entry = TreeMapEntry<Key, Value>;
+    using Tree = BinarySearchTree<Entry, TreeMapKeyCompare<Key, Value, Compare>, Allocator>;
+    using BinaryNode = typename Tree::BinaryNode;
+    using SearchPath = typename Tree::SearchPath;
+    using InsertPosition = typename Tree::InsertPosition;
+
+public:
+    using const_iterator = typename Tree::const_iterator;
+    using value_type = Entry;
+
+    /**
+     * @brief 可以修改值的双向迭代器，键仍然只读
+     *
+     * 只能从非 const 的 TreeMap 得到；可以隐式转换成 const_iterator。
+     */
+    class iterator : public const_iterator
+    {
+    public:
+        using pointer = Entry *;
+        using reference = Entry &;
+
+        iterator() = default;
+
+        Entry &operator*() const
+        {
+            // 节点中的元素本身不是 const，const_iterator 只是不允许经由它修改
+            return const_cast<Entry &>(const_iterator::operator*());
+        }
+
+        Entry *operator->() const
+        {
+            return &**this;
+        }
+
+        iterator &operator++()
+        {
+            const_iterator::operator++();
+            return *this;
+        }
+
+        iterator operator++(int)
+        {
+            iterator old = *this;
+            ++(*this);
+            return old;
+        }
+
+        iterator &operator--()
+        {
+            const_iterator::operator--();
+            return *this;
+        }
+
+        iterator operator--(int)
+        {
+            iterator old = *this;
+            --(*this);
+            return old;
+        }
+
+    private:
+        explicit iterator(const_iterator it) : const_iterator{it} {}
+
+        friend class TreeMap;
+    };
+
+    TreeMap() : count{0} {}
+
+    explicit TreeMap(const Compare &c) : Tree(TreeMapKeyCompare<Key, Value, Compare>{c}), count{0} {}
+
+    TreeMap(const TreeMap &) = default;
+
+    /**
+     * @brief 移动构造函数：节点交给新对象，原对象的计数清零
+     */
+    TreeMap(TreeMap &&rhs) noexcept : Tree(std::move(rhs)), count{std::exchange(rhs.count, 0)} {}
+
+    TreeMap &operator=(TreeMap rhs) noexcept
+    {
+        Tree::operator=(std::move(static_cast<Tree &>(rhs)));
+        std::swap(count, rhs.count);
+        return *this;
+    }
+
+    using Tree::begin;
+    using Tree::end;
+
+    iterator begin()
+    {
+        return iterator{Tree::begin()};
+    }
+
+    iterator end()
+    {
+        return iterator{Tree::end()};
+    }
+
+    using Tree::isEmpty;
+    using Tree::printTree;
+    using Tree::exportTree;
+    using Tree::validate;
+
+    /**
+     * @brief 键值对的个数
+     */
+    std::size_t size() const
+    {
+        return count;
+    }
+
+    bool contains(const Key &key) const
+    {
+        return Tree::contains(key);
+    }
+
+    /**
+     * @brief 查找键对应的元素
+     *
+     * @return 指向该元素的迭代器，不存在时返回 end()
+     */
+    const_iterator find(const Key &key) const
+    {
+        return Tree::find(key);
+    }
+
+    /**
+     * @brief 查找键对应的元素，可以经由返回的迭代器修改值
+     */
+    iterator find(const Key &key)
+    {
+        return iterator{Tree::find(key)};
+    }
+
+    /**
+     * @brief 第一个键不小于 key 的元素
+     */
+    const_iterator lower_bound(const Key &key) const
+    {
+        return Tree::lower_bound(key);
+    }
+
+    iterator lower_bound(const Key &key)
+    {
+        return iterator{Tree::lower_bound(key)};
+    }
+
+    /**
+     * @brief 第一个键大于 key 的元素
+     */
+    const_iterator upper_bound(const Key &key) const
+    {
+        return Tree::upper_bound(key);
+    }
+
+    iterator upper_bound(const Key &key)
+    {
+        return iterator{Tree::upper_bound(key)};
+    }
+
+    /**
+     * @brief 键最小的元素
+     */
+    const Entry &findMin() const
+    {
+        return Tree::findMin();
+    }
+
+    /**
+     * @brief 键最大的元素
+     */
+    const Entry &findMax() const
+    {
+        return Tree::findMax();
+    }
+
+    /**
+     * @brief 返回键对应的值，不存在时先插入一个值初始化的值
+     *
+     * 只下降一次。
+     */
+    Value &operator[](const Key &key)
+    {
+        return tryEmplace(key).first->second;
+    }
+
+    Value &operator[](Key &&key)
+    {
+        return tryEmplace(std::move(key)).first->second;
+    }
+
+    /**
+     * @brief 键不存在时用 args 构造值并插入，存在时什么也不做
+     *
+     * 只下降一次；已存在时不构造值。
+     *
+     * @return 指向该键所在元素的迭代器，以及是否插入了新元素
+     */
+    template <typename K, typename... Args>
+        requires std::same_as<std::remove_cvref_t<K>, Key>
+    std::pair<iterator, bool> try_emplace(K &&key, Args &&...args)
+    {
+        return tryEmplace(std::forward<K>(key), std::forward<Args>(args)...);
+    }
+
+    /**
+     * @brief 键不存在时插入，存在时把值替换为 value
+     *
+     * 只下降一次。
+     *
+     * @return 指向该键所在元素的迭代器，以及是否插入了新元素
+     */
+    template <typename V>
+    std::pair<iterator, bool> insert_or_assign(const Key &key, V &&value)
+    {
+        SearchPath path;
+        InsertPosition pos = this->findInsertPosition(key, this->root, path);
+        if (pos.found != nullptr)
+        {
+            pos.found->element.second = std::forward<V>(value);
+            return {iterator{this->makeIterator(pos.found)}, false};
+        }
+        BinaryNode *node = this->createNode(std::in_place, key, std::forward<V>(value));
+        ++count;
+        return {iterator{this->makeIterator(this->link(node, pos, path))}, true};
+    }
+
+    /**
+     * @brief 原地更新：键不存在时先插入一个值初始化的值，然后对值调用 update
+     *
+     * 只下降一次，适合计数、累加这类“读出、修改、写回”的操作，例如
+     * map.upsert(word, [](int &n) { ++n; })。
+     *
+     * @param key 键
+     * @param update 接受 Value& 的可调用对象
+     * @return 更新后的值
+     */
+    template <typename F>
+    Value &upsert(const Key &key, F &&update)
+    {
+        Value &value = tryEmplace(key).first->second;
+        std::invoke(std::forward<F>(update), value);
+        return value;
+    }
+
+    /**
+     * @brief 删除键对应的元素，不存在时什么也不做
+     *
+     * @return 是否删除了元素
+     */
+    bool remove(const Key &key)
+    {
+        if (Tree::extract(key).empty())
+            return false;
+        --count;
+        return true;
+    }
+
+    void makeEmpty()
+    {
+        Tree::makeEmpty();
+        count = 0;
+    }
+
+private:
+    std::size_t count; ///< 元素个数
+
+    /**
+     * @brief 单次下降的 try_emplace，键可以是左值或右值
+     */
+    template <typename K, typename... Args>
+    std::pair<iterator, bool> tryEmplace(K &&key, Args &&...args)
+    {
+        SearchPath path;
+        InsertPosition pos = this->findInsertPosition(key, this->root, path);
+        if (pos.found != nullptr)
+            return {iterator{this->makeIterator(pos.found)}, false};
+        BinaryNode *node = this->createNode(std::in_place, std::forward<K>(key), std::forward<Args>(args)...);
+        ++count;
+        return {iterator{this->makeIterator(this->link(node, pos, path))}, true};
+    }
+};
+
+#endif
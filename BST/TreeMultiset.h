@@ -0,0 +1,302 @@
+/**
+ * @file TreeMultiset.h
+ * @brief 每个节点带出现次数的有序多重集合
+ *
+ * 用允许重复的树实现多重集合时，同一个值出现 k 次就要 k 个节点，
+ * 树更高，查找要多走几层，还要决定相等的元素往哪边放。
+ * 这里每个不同的值只占一个节点，节点里记出现次数：
+ * 插入已有的值只把次数加一，删除时次数减到零才真正摘下节点，
+ * 两者都只下降一次。
+ */
+
+#ifndef __TREE_MULTISET_MARK__
+#define __TREE_MULTISET_MARK__
+
+#include <cstddef>
+#include <functional>
+#include <iostream>
+#include <utility>
+#include "BST.h"
+
+template <typename Comparable, typename Compare, typename Allocator>
+class TreeMultiset;
+
+/**
+ * @brief TreeMultiset 的元素：值和它的出现次数
+ *
+ * 次数只能经由 TreeMultiset 的插入删除修改，外部只能读：
+ * 它必须与集合记录的元素总数保持一致。
+ */
+template <typename Comparable>
+struct CountedEntry
+{
+    Comparable value;
+
+    template <typename X>
+    CountedEntry(X &&x, std::size_t n) : value(std::forward<X>(x)), occurrences{n}
+    {
+    }
+
+    /**
+     * @brief 值出现的次数
+     */
+    std::size_t count() const
+    {
+        return occurrences;
+    }
+
+    friend std::ostream &operator<<(std::ostream &out, const CountedEntry &entry)
+    {
+        return out << entry.value << " x" << entry.occurrences;
+    }
+
+private:
+    std::size_t occurrences;
+
+    template <typename, typename, typename>
+    friend class TreeMultiset;
+};
+
+/**
+ * @brief 只比较值的透明比较器，既能比较两个元素，也能直接拿值和元素比较
+ */
+template <typename Comparable, typename Compare>
+struct CountedEntryCompare
+{
+    using is_transparent = void;
+    using Entry = CountedEntry<Comparable>;
+
+    [[no_unique_address]] Compare comp;
+
+    bool operator()(const Entry &a, const Entry &b) const
+    {
+        return comp(a.value, b.value);
+    }
+
+    bool operator()(const Comparable &a, const Entry &b) const
+    {
+        return comp(a, b.value);
+    }
+
+    bool operator()(const Entry &a, const Comparable &b) const
+    {
+        return comp(a.value, b);
+    }
+};
+
+/**
+ * @brief 有序多重集合，底层是 AVL 树，每个不同的值一个节点
+ *
+ * 迭代器按值从小到大访问每个不同的值一次，it->value 是值，it->count() 是出现次数。
+ *
+ * @tparam Comparable 元素类型
+ * @tparam Compare 比较器
+ * @tparam Allocator 节点的分配器
+ */
+template <typename Comparable, typename Compare = std::less<Comparable>,
+          typename Allocator = SlabAllocator<CountedEntry<Comparable>>>
+class TreeMultiset
+    : protected BinarySearchTree<CountedEntry<Comparable>, CountedEntryCompare<Comparable, Compare>, Allocator>
+{
+    using Entry = CountedEntry<Comparable>;
+    using Tree = BinarySearchTree<Entry, CountedEntryCompare<Comparable, Compare>, Allocator>;
+    using BinaryNode = typename Tree::BinaryNode;
+    using SearchPath = typename Tree::SearchPath;
+    using InsertPosition = typename Tree::InsertPosition;
+
+public:
+    using const_iterator = typename Tree::const_iterator;
+    using iterator = const_iterator;
+    using value_type = Entry;
+
+    TreeMultiset() : total{0}, distinct{0} {}
+
+    explicit TreeMultiset(const Compare &c) : Tree(CountedEntryCompare<Comparable, Compare>{c}), total{0}, distinct{0}
+    {
+    }
+
+    TreeMultiset(const TreeMultiset &) = default;
+
+    /**
+     * @brief 移动构造函数：节点交给新对象，原对象的计数清零
+     */
+    TreeMultiset(TreeMultiset &&rhs) noexcept
+        : Tree(std::move(rhs)), total{std::exchange(rhs.total, 0)}, distinct{std::exchange(rhs.distinct, 0)}
+    {
+    }
+
+    TreeMultiset &operator=(TreeMultiset rhs) noexcept
+    {
+        Tree::operator=(std::move(static_cast<Tree &>(rhs)));
+        std::swap(total, rhs.total);
+        std::swap(distinct, rhs.distinct);
+        return *this;
+    }
+
+    using Tree::begin;
+    using Tree::end;
+    using Tree::isEmpty;
+    using Tree::printTree;
+    using Tree::exportTree;
+    using Tree::validate;
+
+    /**
+     * @brief 元素总数，重复的值按出现次数计
+     */
+    std::size_t size() const
+    {
+        return total;
+    }
+
+    /**
+     * @brief 不同的值的个数，也就是节点个数
+     */
+    std::size_t distinctSize() const
+    {
+        return distinct;
+    }
+
+    bool contains(const Comparable &x) const
+    {
+        return Tree::contains(x);
+    }
+
+    /**
+     * @brief x 出现的次数，不存在时为 0
+     */
+    std::size_t count(const Comparable &x) const
+    {
+        const_iterator it = Tree::find(x);
+        return it == end() ? 0 : it->count();
+    }
+
+    /**
+     * @brief 查找 x 所在的元素，不存在时返回 end()
+     */
+    const_iterator find(const Comparable &x) const
+    {
+        return Tree::find(x);
+    }
+
+    /**
+     * @brief 第一个不小于 x 的元素
+     */
+    const_iterator lower_bound(const Comparable &x) const
+    {
+        return Tree::lower_bound(x);
+    }
+
+    /**
+     * @brief 第一个大于 x 的元素
+     */
+    const_iterator upper_bound(const Comparable &x) const
+    {
+        return Tree::upper_bound(x);
+    }
+
+    /**
+     * @brief 最小的值
+     */
+    const Comparable &findMin() const
+    {
+        return Tree::findMin().value;
+    }
+
+    /**
+     * @brief 最大的值
+     */
+    const Comparable &findMax() const
+    {
+        return Tree::findMax().value;
+    }
+
+    /**
+     * @brief 插入 n 个 x
+     *
+     * 只下降一次：已存在时把次数加 n，否则在找到的位置挂上新节点。
+     *
+     * @param x 要插入的值
+     * @param n 插入的个数，为 0 时什么也不做
+     */
+    void insert(const Comparable &x, std::size_t n = 1)
+    {
+        insertImpl(x, n);
+    }
+
+    void insert(Comparable &&x, std::size_t n = 1)
+    {
+        insertImpl(std::move(x), n);
+    }
+
+    /**
+     * @brief 删除至多 n 个 x
+     *
+     * 只下降一次：次数大于 n 时就地减去，否则摘下整个节点。
+     *
+     * @param x 要删除的值
+     * @param n 删除的个数
+     * @return 实际删除的个数，x 不存在时为 0
+     */
+    std::size_t remove(const Comparable &x, std::size_t n = 1)
+    {
+        SearchPath path;
+        BinaryNode **slot = this->findSlot(x, this->root, path);
+        if (slot == nullptr || n == 0)
+            return 0;
+        BinaryNode *t = *slot;
+        if (t->element.occurrences > n)
+        {
+            t->element.occurrences -= n;
+            total -= n;
+            return n;
+        }
+        std::size_t removed = t->element.occurrences;
+        this->detach(slot, path);
+        this->destroyNode(t);
+        total -= removed;
+        --distinct;
+        return removed;
+    }
+
+    /**
+     * @brief 删除 x 的所有出现
+     *
+     * @return 删除的个数
+     */
+    std::size_t removeAll(const Comparable &x)
+    {
+        return remove(x, static_cast<std::size_t>(-1));
+    }
+
+    void makeEmpty()
+    {
+        Tree::makeEmpty();
+        total = 0;
+        distinct = 0;
+    }
+
+private:
+    std::size_t total;    ///< 元素总数
+    std::size_t distinct; ///< 节点个数
+
+    template <typename X>
+    void insertImpl(X &&x, std::size_t n)
+    {
+        if (n == 0)
+            return;
+        SearchPath path;
+        InsertPosition pos = this->findInsertPosition(x, this->root, path);
+        if (pos.found != nullptr)
+        {
+            pos.found->element.occurrences += n;
+        }
+        else
+        {
+            this->link(this->createNode(std::in_place, std::forward<X>(x), n), pos, path);
+            ++distinct;
+        }
+        total += n;
+    }
+};
+
+#endif
@@ -0,0 +1,283 @@
+#include <iostream>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <string>
+#include <algorithm>
+#include <cmath>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <malloc.h>
+#include "BST.h"
+#include "BTree.h"
+#include "ConcurrentBST.h"
+#include "CompactBST.h"
+#include "OrderedHashSet.h"
+using namespace std;
+using namespace std::chrono;
+
+// 计时辅助函数，返回毫秒数
+template <typename Func>
+double timeIt(Func &&f){
+    auto start = steady_clock::now();
+    f();
+    return duration<double, milli>(steady_clock::now() - start).count();
+}
+
+// 堆上已经分配出去的字节数，包括 malloc 直接用 mmap 申请的大块
+size_t heapBytes(){
+    struct mallinfo2 info = mallinfo2();
+    return info.uordblks + info.hblkhd;
+}
+
+// 插入 keys，然后用 queries 查找，报告建树和查找时间，以及每个元素占用的内存
+// 树提供 optimizeLayout 时（如 CompactBinarySearchTree）建树后调用一次，计入建树时间
+template <typename Tree>
+double benchLookup(const string &name, const vector<int> &keys, const vector<int> &queries){
+    size_t before = heapBytes();
+    Tree tree;
+    double build = timeIt([&]{
+        for(int x : keys)
+            tree.insert(x);
+        if constexpr (requires { tree.optimizeLayout(); })
+            tree.optimizeLayout();
+    });
+    double perElement = double(heapBytes() - before) / keys.size();
+    size_t found = 0;
+    double lookup = timeIt([&]{
+        for(int x : queries)
+            found += tree.contains(x);
+    });
+    cout << name << ": 建树 " << build << " 毫秒, " << queries.size() << " 次查找 " << lookup
+         << " 毫秒 (命中 " << found << "), 每个元素 " << perElement << " 字节" << endl;
+    return lookup;
+}
+
+void benchBTree(int n){
+    cout << "=== B+ 树与 AVL 树查找对比 (n = " << n << ") ===" << endl;
+    mt19937 rnd(20241029);
+    vector<int> keys(n);
+    for(int i = 0; i < n; i++)
+        keys[i] = i * 2;
+    shuffle(keys.begin(), keys.end(), rnd);
+    // 一半查找命中，一半不命中
+    vector<int> queries(n);
+    for(int i = 0; i < n; i++)
+        queries[i] = rnd() % (2 * n);
+
+    double avl = benchLookup<BinarySearchTree<int>>("BinarySearchTree<int>", keys, queries);
+    double bt = benchLookup<BTree<int>>("BTree<int>（阶数 " + to_string(defaultBTreeOrder<int>()) + "）", keys, queries);
+    double bt15 = benchLookup<BTree<int, 15>>("BTree<int, 15>（叶子占一个缓存行）", keys, queries);
+    double compact = benchLookup<CompactBinarySearchTree<int>>("CompactBinarySearchTree<int>", keys, queries);
+    double hashed = benchLookup<OrderedHashSet<int>>("OrderedHashSet<int>", keys, queries);
+    cout << "查找加速比: " << avl / bt << "x (默认阶数), " << avl / bt15 << "x (阶数 15), " << avl / compact
+         << "x (紧凑 AVL), " << avl / hashed << "x (哈希索引)" << endl;
+}
+
+void benchFrozen(int n){
+    cout << "=== 冻结索引与 AVL 树查找对比 (n = " << n << ") ===" << endl;
+    mt19937 rnd(7);
+    vector<int> keys(n);
+    for(int i = 0; i < n; i++)
+        keys[i] = i * 2;
+    BinarySearchTree<int> tree(keys.begin(), keys.end());
+    auto index = tree.freeze();
+    vector<int> queries(n);
+    for(int i = 0; i < n; i++)
+        queries[i] = rnd() % (2 * n);
+
+    size_t foundTree = 0, foundIndex = 0, foundSorted = 0;
+    double treeTime = timeIt([&]{
+        for(int x : queries)
+            foundTree += tree.contains(x);
+    });
+    double indexTime = timeIt([&]{
+        for(int x : queries)
+            foundIndex += index.contains(x);
+    });
+    double sortedTime = timeIt([&]{
+        for(int x : queries)
+            foundSorted += binary_search(keys.begin(), keys.end(), x);
+    });
+    cout << "BinarySearchTree::contains: " << treeTime << " 毫秒 (命中 " << foundTree << ")" << endl;
+    cout << "FrozenSearchIndex::contains: " << indexTime << " 毫秒 (命中 " << foundIndex << ")" << endl;
+    cout << "有序数组 binary_search: " << sortedTime << " 毫秒 (命中 " << foundSorted << ")" << endl;
+    cout << "冻结索引相对 AVL 树加速比: " << treeTime / indexTime << "x" << endl;
+}
+
+// 用一把全局互斥锁包起来的 BinarySearchTree，作为对照
+class LockedTree{
+public:
+    bool contains(int x){
+        lock_guard<mutex> lock(m);
+        return tree.contains(x);
+    }
+    void insert(int x){
+        lock_guard<mutex> lock(m);
+        tree.insert(x);
+    }
+    void remove(int x){
+        lock_guard<mutex> lock(m);
+        tree.remove(x);
+    }
+
+private:
+    mutex m;
+    BinarySearchTree<int> tree;
+};
+
+// 一个写者不停插入删除，readers 个读者在固定时间内查找，返回每秒查找次数
+template <typename Tree>
+double readThroughput(Tree &tree, int n, int readers){
+    atomic<bool> stop{false};
+    atomic<long long> lookups{0};
+    atomic<size_t> hits{0}; // 记录命中数，防止查找被优化掉
+    thread writer([&]{
+        mt19937 rnd(1);
+        while(!stop){
+            int x = rnd() % (2 * n);
+            if(x & 1) tree.insert(x);
+            else tree.remove(x | 1);
+        }
+    });
+    vector<thread> pool;
+    for(int r = 0; r < readers; r++){
+        pool.emplace_back([&, r]{
+            mt19937 rnd(100 + r);
+            long long local = 0;
+            size_t found = 0;
+            while(!stop){
+                for(int i = 0; i < 256; i++)
+                    found += tree.contains(rnd() % (2 * n));
+                local += 256;
+            }
+            lookups += local;
+            hits += found;
+        });
+    }
+    const double seconds = 0.5;
+    this_thread::sleep_for(duration<double>(seconds));
+    stop = true;
+    writer.join();
+    for(auto &t : pool)
+        t.join();
+    return lookups / seconds;
+}
+
+void benchConcurrent(int n){
+    cout << "=== 并发读吞吐量 (n = " << n << ", 一个写者) ===" << endl;
+    cout << "硬件线程数: " << thread::hardware_concurrency() << endl;
+    LockedTree locked;
+    ConcurrentBinarySearchTree<int> concurrent;
+    for(int i = 0; i < n; i++){
+        locked.insert(i * 2);
+        concurrent.insert(i * 2);
+    }
+    unsigned maxReaders = max(4u, thread::hardware_concurrency());
+    for(unsigned readers = 1; readers <= maxReaders; readers *= 2){
+        double a = readThroughput(locked, n, readers);
+        double b = readThroughput(concurrent, n, readers);
+        cout << readers << " 个读者: 全局互斥锁 " << a / 1e6 << " M次/秒, 无锁读 " << b / 1e6
+             << " M次/秒 (" << b / a << "x)" << endl;
+    }
+}
+
+// 平衡策略对比用的负载：先按 fill 建树，再依次执行 ops
+struct Workload{
+    string name;
+    vector<int> fill;
+    vector<pair<char, int>> ops; // 'f' 查找, 'i' 插入, 'r' 删除
+};
+
+template <typename Policy>
+double runWorkload(const Workload &w, size_t &hits){
+    BinarySearchTree<int, less<int>, SlabAllocator<int>, NoSubtreeSize, Policy> tree;
+    for(int x : w.fill)
+        tree.insert(x);
+    // 只计 ops 的时间
+    return timeIt([&]{
+        for(auto [kind, x] : w.ops){
+            if(kind == 'f') hits += tree.contains(x);
+            else if(kind == 'i') tree.insert(x);
+            else tree.remove(x);
+        }
+    });
+}
+
+// 参数为 s 的 Zipf 分布，返回 [0, n) 中的名次，名次越小越常见
+class Zipf{
+public:
+    Zipf(int n, double s) : cdf(n){
+        double sum = 0;
+        for(int i = 0; i < n; i++)
+            cdf[i] = sum += 1.0 / pow(i + 1, s);
+        for(double &c : cdf)
+            c /= sum;
+    }
+    template <typename Rng>
+    int operator()(Rng &rnd){
+        double u = uniform_real_distribution<double>(0, 1)(rnd);
+        return min<int>(lower_bound(cdf.begin(), cdf.end(), u) - cdf.begin(), cdf.size() - 1);
+    }
+
+private:
+    vector<double> cdf;
+};
+
+void benchBalancing(int n){
+    cout << "=== 平衡策略对比 (n = " << n << ", 单位毫秒) ===" << endl;
+    mt19937 rnd(5);
+    vector<int> keys(n);
+    for(int i = 0; i < n; i++)
+        keys[i] = i * 2;
+    vector<int> shuffled = keys;
+    shuffle(shuffled.begin(), shuffled.end(), rnd);
+
+    vector<Workload> workloads(6);
+    workloads[0].name = "随机插入";
+    for(int x : shuffled)
+        workloads[0].ops.push_back({'i', x});
+
+    workloads[1].name = "均匀查找";
+    workloads[1].fill = shuffled;
+    for(int i = 0; i < n; i++)
+        workloads[1].ops.push_back({'f', (int)(rnd() % (2 * n))});
+
+    workloads[2].name = "顺序插入";
+    for(int x : keys)
+        workloads[2].ops.push_back({'i', x});
+
+    workloads[3].name = "顺序查找";
+    workloads[3].fill = shuffled;
+    for(int x : keys)
+        workloads[3].ops.push_back({'f', x});
+
+    workloads[4].name = "Zipf 查找";
+    workloads[4].fill = shuffled;
+    Zipf zipf(n, 0.99);
+    for(int i = 0; i < n; i++)
+        workloads[4].ops.push_back({'f', shuffled[zipf(rnd)]});
+
+    workloads[5].name = "删除为主";
+    workloads[5].fill = shuffled;
+    for(int i = 0; i < n; i++)
+        workloads[5].ops.push_back({rnd() % 10 < 6 ? 'r' : 'i', (int)(rnd() % (2 * n))});
+
+    size_t hits = 0; // 防止查找被优化掉
+    cout << "负载\t\tAVL\t红黑树\ttreap\t伸展树" << endl;
+    for(const Workload &w : workloads){
+        cout << w.name << "\t" << runWorkload<AvlBalance>(w, hits) << "\t" << runWorkload<RedBlackBalance>(w, hits)
+             << "\t" << runWorkload<TreapBalance>(w, hits) << "\t" << runWorkload<SplayBalance>(w, hits) << endl;
+    }
+    cout << "(命中 " << hits << ")" << endl;
+}
+
+int main(int argc, char *argv[]){
+    int n = argc > 1 ? stoi(argv[1]) : 2000000;
+    benchBTree(n);
+    benchFrozen(n);
+    benchConcurrent(n / 4);
+    benchBalancing(n / 4);
+    return 0;
+}
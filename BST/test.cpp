@@ -3,7 +3,30 @@
 #include <cmath>
 #include <random>
 #include <vector>
+#include <sstream>
+#include <set>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <string>
+#include <string_view>
+#include <filesystem>
+#include <fstream>
+#include <span>
+#include <iomanip>
+#include <stdexcept>
+#include <limits>
 #include "BST.h"
+#include "BTree.h"
+#include "ConcurrentBST.h"
+#include "PersistentBST.h"
+#include "CompactBST.h"
+#include "MappedSearchIndex.h"
+#include "OrderedHashSet.h"
+#include "TreeMap.h"
+#include "TreeMultiset.h"
+#include <map>
 using namespace std;
 
 class MyData{
@@ -42,18 +65,52 @@ public:
 
 bool MyData::checkCopy = false;
 
-class Checker : public BinarySearchTree<int>{
+// 可以移动的元素，记录拷贝次数：emplace 和节点句柄应当只移动、不拷贝
+class MovableData{
 private:
-    using BinarySearchTree<int>::root;
-    using node = BinarySearchTree<int>::BinaryNode;
+    int a, b;
+
+public:
+    MovableData(int a = 0, int b = 0) : a(a), b(b) {}
+    bool operator < (const MovableData &rhs) const{
+        return a < rhs.a || (a == rhs.a && b < rhs.b);
+    }
+    bool operator == (const MovableData &rhs) const{
+        return a == rhs.a && b == rhs.b;
+    }
+
+    static inline int copies = 0;
+
+    MovableData(const MovableData &rhs) : a(rhs.a), b(rhs.b) {
+        ++copies;
+    }
+    MovableData& operator = (const MovableData &rhs){
+        a = rhs.a;
+        b = rhs.b;
+        ++copies;
+        return *this;
+    }
+    MovableData(MovableData &&) noexcept = default;
+    MovableData& operator = (MovableData &&) noexcept = default;
+
+    friend ostream& operator << (ostream& out, const MovableData &rhs){
+        out << "(" << rhs.a << "," << rhs.b << ")";
+        return out;
+    }
+};
+
+template <typename Allocator = SlabAllocator<int>>
+class Checker : public BinarySearchTree<int, std::less<int>, Allocator>{
+private:
+    using BinarySearchTree<int, std::less<int>, Allocator>::root;
 
 public:
     void createChain(int N){
-        root = new node(1, nullptr, nullptr);
+        root = this->createNode(1, nullptr, nullptr);
         root->height = N;
         auto p = root;
         for(int i = 2; i <= N; i++){
-            p->right = new node(i, nullptr, nullptr);
+            p->right = this->createNode(i, nullptr, nullptr, p);
             p = p->right;
             p->height = N - i + 1;
         }
@@ -80,15 +137,1125 @@ void testRandomData(){
 void testIncreasingData(){
     cout << "------------------------------" << endl;
     const int N = 300000;
-    Checker bst;
+    Checker<> bst;
     bst.createChain(N);
     for(int i = N; i >= 1; i--)
         bst.remove(i);
     bst.printTree();
 }
 
+void testDeepChain(){
+    cout << "------------------------------" << endl;
+    const int N = 300000;
+    // 使用 std::allocator，析构时必须逐个释放节点，检验旋转展平不会爆栈
+    Checker<std::allocator<int>> bst;
+    bst.createChain(N);
+    BinarySearchTree<int, std::less<int>, std::allocator<int>> copy(bst);
+    cout << "深链查找: " << (copy.contains(N) && !copy.contains(N + 1) ? "正确" : "错误") << endl;
+    cout << "深链最小/最大: " << copy.findMin() << " " << copy.findMax() << endl;
+    ostringstream out;
+    copy.printTree(out);
+    string printed = out.str();
+    cout << "深链打印行数: " << count(printed.begin(), printed.end(), '\n') << endl;
+}
+
+void testIterator(){
+    cout << "------------------------------" << endl;
+    const int N = 10000;
+    mt19937 rnd(20241029);
+    BinarySearchTree<int> bst;
+    set<int> ref;
+    for(int i = 0; i < N; i++){
+        int x = rnd() % (N * 4);
+        bst.insert(x);
+        ref.insert(x);
+        if(i % 3 == 0){
+            int y = rnd() % (N * 4);
+            bst.remove(y);
+            ref.erase(y);
+        }
+    }
+    cout << "中序迭代: " << (equal(bst.begin(), bst.end(), ref.begin(), ref.end()) ? "正确" : "错误") << endl;
+
+    vector<int> backward;
+    for(auto it = bst.end(); it != bst.begin(); )
+        backward.push_back(*--it);
+    cout << "逆序迭代: " << (equal(backward.begin(), backward.end(), ref.rbegin(), ref.rend()) ? "正确" : "错误") << endl;
+
+    bool boundOk = true;
+    for(int i = 0; i < 1000; i++){
+        int x = rnd() % (N * 4 + 10) - 5;
+        auto lb = bst.lower_bound(x);
+        auto ub = bst.upper_bound(x);
+        auto rlb = ref.lower_bound(x);
+        auto rub = ref.upper_bound(x);
+        boundOk = boundOk && (lb == bst.end() ? rlb == ref.end() : rlb != ref.end() && *lb == *rlb);
+        boundOk = boundOk && (ub == bst.end() ? rub == ref.end() : rub != ref.end() && *ub == *rub);
+    }
+    cout << "lower_bound/upper_bound: " << (boundOk ? "正确" : "错误") << endl;
+
+    int lo = N, hi = N * 2;
+    auto r = bst.range(lo, hi);
+    cout << "区间 [" << lo << ", " << hi << "] 元素个数: " << distance(r.begin(), r.end())
+         << " (应为 " << distance(ref.lower_bound(lo), ref.upper_bound(hi)) << ")" << endl;
+}
+
+void testOrderStatistics(){
+    cout << "------------------------------" << endl;
+    const int N = 10000;
+    mt19937 rnd(1024);
+    BinarySearchTree<int, std::less<int>, SlabAllocator<int>, TrackSubtreeSize> bst;
+    set<int> ref;
+    for(int i = 0; i < N; i++){
+        int x = rnd() % (N * 4);
+        bst.insert(x);
+        ref.insert(x);
+        if(i % 4 == 0){
+            int y = rnd() % (N * 4);
+            bst.remove(y);
+            ref.erase(y);
+        }
+    }
+    vector<int> sorted(ref.begin(), ref.end());
+    bool selectOk = bst.size() == sorted.size();
+    for(size_t k = 0; k < sorted.size(); k += 7)
+        selectOk = selectOk && bst.select(k) == sorted[k];
+    cout << "select: " << (selectOk ? "正确" : "错误") << endl;
+
+    bool rankOk = true;
+    for(int i = 0; i < 1000; i++){
+        int x = rnd() % (N * 4);
+        size_t expect = lower_bound(sorted.begin(), sorted.end(), x) - sorted.begin();
+        rankOk = rankOk && bst.rank(x) == expect;
+    }
+    cout << "rank: " << (rankOk ? "正确" : "错误") << endl;
+
+    int lo = N / 2, hi = N * 3;
+    cout << "区间 [" << lo << ", " << hi << "] 计数: " << bst.countInRange(lo, hi)
+         << " (应为 " << distance(ref.lower_bound(lo), ref.upper_bound(hi)) << ")" << endl;
+}
+
+void testBulkLoad(){
+    cout << "------------------------------" << endl;
+    const int N = 1000000;
+    vector<int> sorted(N);
+    for(int i = 0; i < N; i++)
+        sorted[i] = i * 2;
+
+    auto start = chrono::steady_clock::now();
+    BinarySearchTree<int> byInsert;
+    for(int x : sorted)
+        byInsert.insert(x);
+    auto insertTime = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start);
+
+    start = chrono::steady_clock::now();
+    BinarySearchTree<int, std::less<int>, SlabAllocator<int>, TrackSubtreeSize> bulk(sorted.begin(), sorted.end());
+    auto bulkTime = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start);
+    cout << "逐个插入用时: " << insertTime.count() << " 毫秒, 批量构建用时: " << bulkTime.count() << " 毫秒" << endl;
+    cout << "批量构建结果: " << (bulk.size() == sorted.size() && equal(bulk.begin(), bulk.end(), sorted.begin()) ? "正确" : "错误") << endl;
+
+    // 无序且有重复的输入先排序去重
+    mt19937 rnd(7);
+    vector<int> shuffled;
+    for(int i = 0; i < 1000; i++)
+        shuffled.push_back(rnd() % 500);
+    set<int> ref(shuffled.begin(), shuffled.end());
+    BinarySearchTree<int> unsorted;
+    unsorted.assign(shuffled.begin(), shuffled.end());
+    cout << "无序输入构建: " << (equal(unsorted.begin(), unsorted.end(), ref.begin(), ref.end()) ? "正确" : "错误") << endl;
+
+    // 合并两棵树，重复元素只保留一份
+    BinarySearchTree<int> other;
+    for(int i = 0; i < 1000; i++){
+        int x = rnd() % 1000;
+        other.insert(x);
+        ref.insert(x);
+    }
+    unsorted.merge(std::move(other));
+    cout << "合并结果: " << (equal(unsorted.begin(), unsorted.end(), ref.begin(), ref.end()) && other.isEmpty() ? "正确" : "错误") << endl;
+}
+
+// 随机插入删除，与 std::set 比较全部内容、最小最大元素；阶数小时频繁走到分裂、借键与合并
+template <size_t Order>
+bool checkBTree(unsigned seed){
+    mt19937 rnd(seed);
+    BTree<int, Order> tree;
+    set<int> ref;
+    bool ok = true;
+    for(int round = 0; round < 20 && ok; round++){
+        int range = round % 2 ? 200 : 5000;
+        for(int i = 0; i < 4000; i++){
+            int x = rnd() % range;
+            if(rnd() % 5 < (round % 4 < 2 ? 3 : 1)){
+                tree.insert(x);
+                ref.insert(x);
+            }else{
+                tree.remove(x);
+                ref.erase(x);
+            }
+        }
+        ostringstream printed, expected;
+        tree.printTree(printed);
+        if(ref.empty())
+            expected << "Empty tree" << endl;
+        for(int x : ref)
+            expected << x << '\n';
+        ok = printed.str() == expected.str() && tree.isEmpty() == ref.empty();
+        if(ok && !ref.empty())
+            ok = tree.findMin() == *ref.begin() && tree.findMax() == *ref.rbegin();
+        for(int x = -1; x <= range && ok; x++)
+            ok = tree.contains(x) == (ref.count(x) > 0);
+    }
+    // 删空以后还能继续使用
+    for(int x : vector<int>(ref.begin(), ref.end()))
+        tree.remove(x);
+    bool threw = false;
+    try{
+        tree.findMin();
+    }catch(const UnderflowException &){
+        threw = true;
+    }
+    tree.insert(7);
+    return ok && threw && tree.contains(7) && tree.findMax() == 7;
+}
+
+void testBTree(){
+    cout << "------------------------------" << endl;
+    cout << "B+ 树 (阶数 3): " << (checkBTree<3>(3) ? "正确" : "错误") << endl;
+    cout << "B+ 树 (阶数 4): " << (checkBTree<4>(4) ? "正确" : "错误") << endl;
+    cout << "B+ 树 (阶数 5): " << (checkBTree<5>(5) ? "正确" : "错误") << endl;
+    cout << "B+ 树 (默认阶数 " << defaultBTreeOrder<int>() << "): "
+         << (checkBTree<defaultBTreeOrder<int>()>(6) ? "正确" : "错误") << endl;
+}
+
+void testFreeze(){
+    cout << "------------------------------" << endl;
+    mt19937 rnd(42);
+    BinarySearchTree<int> bst;
+    set<int> ref;
+    for(int i = 0; i < 5000; i++){
+        int x = rnd() % 20000;
+        bst.insert(x);
+        ref.insert(x);
+    }
+    auto index = bst.freeze();
+    bst.insert(-1); // 冻结之后的修改不影响索引
+
+    bool ok = index.size() == ref.size() && !index.contains(-1);
+    for(int x = -5; x < 20005; x++){
+        auto it = ref.lower_bound(x);
+        const int *lb = index.lower_bound(x);
+        ok = ok && index.contains(x) == (ref.count(x) > 0);
+        ok = ok && (lb == nullptr ? it == ref.end() : it != ref.end() && *lb == *it);
+        ok = ok && index.rank(x) == (size_t)distance(ref.begin(), it);
+    }
+    cout << "冻结索引 contains/lower_bound/rank: " << (ok ? "正确" : "错误") << endl;
+}
+
+// 拷贝构造函数在指定次数后抛出异常，检验修改失败时树保持原样、不泄漏也不提前回收节点
+struct FragileInt{
+    int value;
+    static inline int failAfter = -1; // 再成功拷贝多少次以后抛出异常，负数表示不抛出
+
+    FragileInt(int v = 0) : value(v) {}
+    FragileInt(const FragileInt &rhs) : value(rhs.value){
+        if(failAfter >= 0 && failAfter-- == 0)
+            throw runtime_error("copy failed");
+    }
+    FragileInt &operator = (const FragileInt &) = default;
+    bool operator < (const FragileInt &rhs) const{
+        return value < rhs.value;
+    }
+    friend ostream &operator << (ostream &out, const FragileInt &x){
+        return out << x.value;
+    }
+};
+
+// 路径复制的树：随机插入删除，其中一部分在复制路径的中途失败，失败的修改不应留下任何痕迹
+template <typename Tree>
+bool checkFailedUpdates(){
+    mt19937 rnd(8);
+    Tree tree;
+    set<int> ref;
+    for(int i = 0; i < 2000; i++){
+        int x = rnd() % 4000;
+        tree.insert(FragileInt(x));
+        ref.insert(x);
+    }
+    int failures = 0;
+    for(int i = 0; i < 20000; i++){
+        int x = rnd() % 4000;
+        bool inserting = rnd() % 2;
+        FragileInt::failAfter = rnd() % 16;
+        try{
+            if(inserting)
+                tree.insert(FragileInt(x));
+            else
+                tree.remove(FragileInt(x));
+            FragileInt::failAfter = -1;
+            if(inserting)
+                ref.insert(x);
+            else
+                ref.erase(x);
+        }catch(const runtime_error &){
+            FragileInt::failAfter = -1;
+            failures++;
+        }
+    }
+    bool ok = failures > 0 && !ref.empty();
+    for(int x = -1; x <= 4000 && ok; x++)
+        ok = tree.contains(FragileInt(x)) == (ref.count(x) > 0);
+    return ok && FragileInt(tree.findMin()).value == *ref.begin() && FragileInt(tree.findMax()).value == *ref.rbegin();
+}
+
+void testConcurrent(){
+    cout << "------------------------------" << endl;
+    const int N = 20000;
+    ConcurrentBinarySearchTree<int> tree;
+    for(int i = 0; i < N; i += 2)
+        tree.insert(i);
+    // 写者只改动奇数，读者始终应该能看到全部偶数
+    atomic<bool> stop{false};
+    atomic<int> missing{0};
+    vector<thread> readers;
+    for(int r = 0; r < 3; r++){
+        readers.emplace_back([&, r]{
+            mt19937 rnd(r);
+            while(!stop){
+                int x = rnd() % (N / 2) * 2;
+                if(!tree.contains(x) || tree.findMin() != 0)
+                    missing++;
+            }
+        });
+    }
+    mt19937 rnd(99);
+    set<int> odd;
+    for(int i = 0; i < 100000; i++){
+        int x = rnd() % (N / 2) * 2 + 1;
+        if(rnd() % 2){
+            tree.insert(x);
+            odd.insert(x);
+        }else{
+            tree.remove(x);
+            odd.erase(x);
+        }
+    }
+    stop = true;
+    for(auto &t : readers)
+        t.join();
+    bool ok = missing == 0;
+    for(int x = 1; x < N; x += 2)
+        ok = ok && tree.contains(x) == (odd.count(x) > 0);
+    cout << "并发读写: " << (ok ? "正确" : "错误") << endl;
+    cout << "拷贝元素时抛出异常: " << (checkFailedUpdates<ConcurrentBinarySearchTree<FragileInt>>() ? "正确" : "错误") << endl;
+}
+
+void testPersistent(){
+    cout << "------------------------------" << endl;
+    const int N = 300000;
+    vector<int> keys(N);
+    for(int i = 0; i < N; i++)
+        keys[i] = i;
+    BinarySearchTree<int> plain(keys.begin(), keys.end());
+    PersistentBinarySearchTree<int> persistent;
+    for(int x : keys)
+        persistent.insert(x);
+
+    // 各取 100 份快照，比较深拷贝和共享节点的代价
+    auto start = chrono::steady_clock::now();
+    vector<BinarySearchTree<int>> copies;
+    for(int i = 0; i < 100; i++)
+        copies.push_back(plain);
+    auto copyTime = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start);
+    start = chrono::steady_clock::now();
+    vector<PersistentBinarySearchTree<int>> snapshots;
+    for(int i = 0; i < 100; i++)
+        snapshots.push_back(persistent.snapshot());
+    auto snapshotTime = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start);
+    cout << "100 次深拷贝用时: " << copyTime.count() << " 毫秒, 100 次快照用时: " << snapshotTime.count() << " 微秒" << endl;
+
+    // 修改当前版本，旧快照保持不变
+    for(int i = 0; i < N; i += 2)
+        persistent.remove(i);
+    persistent.insert(-1);
+    bool ok = snapshots[0].contains(0) && !snapshots[0].contains(-1) && snapshots[0].findMax() == N - 1;
+    ok = ok && !persistent.contains(0) && persistent.contains(1) && persistent.findMin() == -1;
+    cout << "快照隔离: " << (ok ? "正确" : "错误") << endl;
+    cout << "拷贝元素时抛出异常: " << (checkFailedUpdates<PersistentBinarySearchTree<FragileInt>>() ? "正确" : "错误") << endl;
+}
+
+// 透明比较器，顺便统计比较次数
+struct CountingLess{
+    using is_transparent = void;
+    static inline size_t calls = 0;
+    template <typename A, typename B>
+    bool operator()(const A &a, const B &b) const{
+        ++calls;
+        return a < b;
+    }
+};
+
+void testComparator(){
+    cout << "------------------------------" << endl;
+    // 自定义比较器决定顺序
+    BinarySearchTree<int, greater<int>> desc;
+    for(int i = 0; i < 100; i++)
+        desc.insert(i);
+    bool ok = desc.findMin() == 99 && desc.findMax() == 0 && *desc.begin() == 99;
+    ok = ok && *desc.lower_bound(50) == 50 && *desc.upper_bound(50) == 49;
+    desc.remove(99);
+    ok = ok && !desc.contains(99) && desc.contains(0) && desc.freeze().contains(98);
+    cout << "自定义比较器: " << (ok ? "正确" : "错误") << endl;
+
+    // 异构查找：用 string_view 和 const char* 查 string，不构造临时 string
+    BinarySearchTree<string, less<>> words;
+    for(const char *w : {"pear", "apple", "fig", "kiwi", "banana"})
+        words.insert(w);
+    string_view key = "kiwi";
+    ok = words.contains(key) && !words.contains(string_view{"grape"});
+    ok = ok && *words.find("fig") == "fig" && words.find("grape") == words.end();
+    ok = ok && *words.lower_bound(string_view{"c"}) == "fig";
+    words.remove(key);
+    ok = ok && !words.contains("kiwi");
+    cout << "异构查找: " << (ok ? "正确" : "错误") << endl;
+
+    // 不能三路比较时每层只调用一次比较器，走到底再多一次
+    const int N = 1 << 16;
+    vector<int> keys(N);
+    for(int i = 0; i < N; i++)
+        keys[i] = i;
+    BinarySearchTree<int, CountingLess> counted(keys.begin(), keys.end());
+    CountingLess::calls = 0;
+    for(int i = 0; i < N; i++)
+        ok = ok && counted.contains(i);
+    double perLookup = (double)CountingLess::calls / N;
+    cout << "平均每次查找比较 " << perLookup << " 次 (树高 " << log2(N) + 1 << ")" << endl;
+    cout << "单次比较下降: " << (ok && perLookup <= log2(N) + 2 ? "正确" : "错误") << endl;
+}
+
+void testEmplace(){
+    cout << "------------------------------" << endl;
+    BinarySearchTree<MovableData> tree;
+    MovableData::copies = 0;
+    bool ok = true;
+    for(int i = 0; i < 1000; i++)
+        ok = ok && tree.emplace(i, i % 7).second;
+    ok = ok && !tree.emplace(3, 3).second && tree.try_emplace(MovableData(4, 4), 4, 4).second == false;
+    ok = ok && tree.try_emplace(MovableData(1000, 0), 1000, 0).second;
+    tree.insert(MovableData(1001, 0)); // 右值被移动进节点
+    cout << "emplace/try_emplace: " << (ok ? "正确" : "错误") << endl;
+
+    // 摘下节点、修改元素、再插回去：还是原来的节点
+    const MovableData *before = &*tree.find(MovableData(5, 5));
+    auto nh = tree.extract(MovableData(5, 5));
+    ok = !nh.empty() && !tree.contains(MovableData(5, 5)) && tree.extract(MovableData(5, 5)).empty();
+    nh.value() = MovableData(5000, 0);
+    auto result = tree.insert(std::move(nh));
+    ok = ok && result.inserted && nh.empty() && &*result.position == before && *result.position == MovableData(5000, 0);
+
+    // 插入失败时句柄原样还回来
+    auto dup = tree.extract(tree.begin());
+    ok = ok && dup.value() == MovableData(0, 0);
+    dup.value() = MovableData(1, 1);
+    auto failed = tree.insert(std::move(dup));
+    ok = ok && !failed.inserted && !failed.node.empty() && *failed.position == MovableData(1, 1);
+
+    // 移到另一棵树（分配器不同）：元素被移动到新节点
+    BinarySearchTree<MovableData> other;
+    failed.node.value() = MovableData(-1, 0);
+    ok = ok && other.insert(std::move(failed.node)).inserted && other.contains(MovableData(-1, 0));
+    while(!tree.isEmpty())
+        other.insert(tree.extract(tree.begin()));
+    ok = ok && *other.begin() == MovableData(-1, 0) && other.findMax() == MovableData(5000, 0);
+    cout << "节点句柄 extract/insert: " << (ok ? "正确" : "错误") << endl;
+    cout << "元素拷贝次数: " << MovableData::copies << " (应为 0)" << endl;
+
+    // 句柄持有来源树内存池的引用：来源树清空、移走、析构以后，句柄中的节点仍然有效
+    BinarySearchTree<int>::node_type orphan, survivor;
+    {
+        BinarySearchTree<int> source;
+        for(int i = 0; i < 100; i++)
+            source.insert(i);
+        orphan = source.extract(42);
+        source.makeEmpty();
+        source.insert(7);
+        survivor = source.extract(7);
+        BinarySearchTree<int> moved(std::move(source));
+        moved.insert(8);
+    }
+    ok = orphan.value() == 42 && survivor.value() == 7;
+    // 来源树的池还被句柄引用时，merge 不能并入那个池，改为逐个移动元素
+    BinarySearchTree<int> target, donor;
+    for(int i = 0; i < 100; i++)
+        donor.insert(i);
+    auto held = donor.extract(50);
+    target.merge(std::move(donor));
+    ok = ok && held.value() == 50 && !target.contains(50) && target.findMax() == 99;
+    ok = ok && target.insert(std::move(held)).inserted && target.contains(50);
+
+    // 共用内存池的两棵树之间移动节点不分配内存，节点地址不变
+    BinarySearchTree<int> left;
+    BinarySearchTree<int> right{sharePool, left};
+    for(int i = 0; i < 1000; i++)
+        left.insert(i);
+    while(!left.isEmpty()){
+        const int *address = &*left.begin();
+        auto moved = right.insert(left.extract(left.begin()));
+        ok = ok && moved.inserted && &*moved.position == address;
+    }
+    ok = ok && right.validate() && right.findMin() == 0 && right.findMax() == 999;
+    cout << "句柄生命周期与共用内存池: " << (ok ? "正确" : "错误") << endl;
+}
+
+void testBatch(){
+    cout << "------------------------------" << endl;
+    mt19937 rnd(2024);
+    const int N = 200000, M = 100000;
+    vector<int> base(N), batch(M), probe(M);
+    for(int &x : base) x = rnd() % (4 * N);
+    for(int &x : batch) x = rnd() % (4 * N);
+    for(int &x : probe) x = rnd() % (4 * N);
+    BinarySearchTree<int> one, many;
+    for(int x : base){
+        one.insert(x);
+        many.insert(x);
+    }
+    set<int> ref(base.begin(), base.end());
+
+    auto start = chrono::steady_clock::now();
+    for(int x : batch)
+        one.insert(x);
+    auto singleTime = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    start = chrono::steady_clock::now();
+    many.insertBatch(batch.begin(), batch.end());
+    auto batchTime = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    ref.insert(batch.begin(), batch.end());
+    cout << M << " 个元素逐个插入: " << singleTime << " 毫秒, insertBatch: " << batchTime << " 毫秒" << endl;
+    bool ok = equal(many.begin(), many.end(), ref.begin(), ref.end());
+
+    vector<bool> found = many.containsBatch(probe.begin(), probe.end());
+    for(int i = 0; i < M; i++)
+        ok = ok && found[i] == (ref.count(probe[i]) > 0);
+
+    start = chrono::steady_clock::now();
+    for(int x : probe)
+        one.remove(x);
+    singleTime = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    start = chrono::steady_clock::now();
+    many.removeBatch(probe.begin(), probe.end());
+    batchTime = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    for(int x : probe)
+        ref.erase(x);
+    cout << M << " 个元素逐个删除: " << singleTime << " 毫秒, removeBatch: " << batchTime << " 毫秒" << endl;
+    ok = ok && equal(many.begin(), many.end(), ref.begin(), ref.end());
+    ok = ok && equal(one.begin(), one.end(), ref.begin(), ref.end());
+    cout << "批量插入/删除/查找: " << (ok ? "正确" : "错误") << endl;
+}
+
+void testSetAlgebra(){
+    cout << "------------------------------" << endl;
+    // split / join
+    BinarySearchTree<int> whole;
+    for(int i = 0; i < 1000; i++)
+        whole.insert(i);
+    BinarySearchTree<int> upper = whole.split(600);
+    bool ok = whole.findMax() == 599 && upper.findMin() == 600 && upper.findMax() == 999;
+    upper.remove(600);
+    BinarySearchTree<int> joined = BinarySearchTree<int>::join(std::move(whole), 600, std::move(upper));
+    ok = ok && whole.isEmpty() && upper.isEmpty();
+    int expect = 0;
+    for(int x : joined)
+        ok = ok && x == expect++;
+    ok = ok && expect == 1000;
+    try{
+        BinarySearchTree<int> a, b;
+        a.insert(5);
+        BinarySearchTree<int>::join(std::move(a), 3, std::move(b));
+        ok = false;
+    }catch(IllegalArgumentException &){
+    }
+    cout << "split/join: " << (ok ? "正确" : "错误") << endl;
+
+    // 新树的节点要逐个移动过去，中途失败时本树的元素一个也不能少
+    BinarySearchTree<FragileInt> fragile;
+    for(int i = 0; i < 1000; i++)
+        fragile.insert(i);
+    FragileInt::failAfter = 100;
+    bool thrown = false;
+    try{
+        fragile.split(600);
+    }catch(runtime_error &){
+        thrown = true;
+    }
+    FragileInt::failAfter = -1;
+    bool okFail = thrown && fragile.validate();
+    expect = 0;
+    for(const FragileInt &x : fragile)
+        okFail = okFail && x.value == expect++;
+    okFail = okFail && expect == 1000;
+    cout << "split 中途失败: " << (okFail ? "正确" : "错误") << endl;
+
+    // 并集、交集、差集
+    mt19937 rnd(77);
+    const int N = 300000;
+    vector<int> xs(N), ys(N);
+    for(int &x : xs) x = rnd() % (2 * N);
+    for(int &y : ys) y = rnd() % (2 * N);
+    set<int> sx(xs.begin(), xs.end()), sy(ys.begin(), ys.end());
+    BinarySearchTree<int> tx(xs.begin(), xs.end()), ty(ys.begin(), ys.end());
+
+    vector<int> expectUnion, expectInter, expectDiff;
+    set_union(sx.begin(), sx.end(), sy.begin(), sy.end(), back_inserter(expectUnion));
+    set_intersection(sx.begin(), sx.end(), sy.begin(), sy.end(), back_inserter(expectInter));
+    set_difference(sx.begin(), sx.end(), sy.begin(), sy.end(), back_inserter(expectDiff));
+
+    BinarySearchTree<int> u = tx, i = tx, d = tx, single = tx;
+    auto start = chrono::steady_clock::now();
+    for(int y : ys)
+        single.insert(y);
+    auto singleTime = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    start = chrono::steady_clock::now();
+    u.unionWith(ty);
+    auto unionTime = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    i.intersectWith(ty);
+    d.differenceWith(std::move(ty));
+    cout << "逐个插入求并集: " << singleTime << " 毫秒, unionWith: " << unionTime << " 毫秒 ("
+         << ForkJoinPool::shared().concurrency() << " 个线程)" << endl;
+    ok = equal(u.begin(), u.end(), expectUnion.begin(), expectUnion.end());
+    ok = ok && equal(i.begin(), i.end(), expectInter.begin(), expectInter.end());
+    ok = ok && equal(d.begin(), d.end(), expectDiff.begin(), expectDiff.end());
+    cout << "并集/交集/差集: " << (ok ? "正确" : "错误") << endl;
+}
+
+template <typename Policy>
+bool checkPolicy(){
+    mt19937 rnd(31);
+    BinarySearchTree<int, less<int>, SlabAllocator<int>, TrackSubtreeSize, Policy> tree;
+    set<int> ref;
+    for(int i = 0; i < 200000; i++){
+        int x = rnd() % 50000;
+        if(rnd() % 3){
+            tree.insert(x);
+            ref.insert(x);
+        }else{
+            tree.remove(x);
+            ref.erase(x);
+        }
+    }
+    bool ok = equal(tree.begin(), tree.end(), ref.begin(), ref.end()) && tree.size() == ref.size();
+    for(int x = 0; x < 50000; x += 7)
+        ok = ok && tree.contains(x) == (ref.count(x) > 0);
+    for(size_t k = 0; k < ref.size(); k += 101)
+        ok = ok && tree.select(k) == *next(ref.begin(), k);
+    auto copy = tree;
+    return ok && tree.validate() && copy.validate() && equal(copy.begin(), copy.end(), ref.begin(), ref.end());
+}
+
+// 读出 treap 每个元素的优先级：删除以后，留下的元素必须还是插入时分到的优先级
+struct TreapProbe : BinarySearchTree<int, less<int>, SlabAllocator<int>, TrackSubtreeSize, TreapBalance>{
+    map<int, unsigned> priorities() const{
+        map<int, unsigned> result;
+        vector<const BinaryNode *> stack;
+        if(root != nullptr)
+            stack.push_back(root);
+        while(!stack.empty()){
+            const BinaryNode *t = stack.back();
+            stack.pop_back();
+            result[t->element] = t->priority;
+            for(const BinaryNode *c : {t->left, t->right})
+                if(c != nullptr)
+                    stack.push_back(c);
+        }
+        return result;
+    }
+};
+
+bool checkTreapDelete(){
+    mt19937 rnd(14);
+    TreapProbe tree;
+    for(int i = 0; i < 20000; i++)
+        tree.insert(i);
+    map<int, unsigned> before = tree.priorities();
+    for(int i = 0; i < 20000; i++)
+        if(rnd() % 2)
+            tree.remove(i);
+    map<int, unsigned> after = tree.priorities();
+    bool ok = tree.validate() && tree.size() == after.size();
+    for(auto [x, p] : after)
+        ok = ok && before[x] == p;
+    return ok;
+}
+
+void testBalancePolicies(){
+    cout << "------------------------------" << endl;
+    cout << "AVL: " << (checkPolicy<AvlBalance>() ? "正确" : "错误") << endl;
+    cout << "红黑树: " << (checkPolicy<RedBlackBalance>() ? "正确" : "错误") << endl;
+    cout << "treap: " << (checkPolicy<TreapBalance>() ? "正确" : "错误") << endl;
+    cout << "treap 删除保留优先级: " << (checkTreapDelete() ? "正确" : "错误") << endl;
+    cout << "伸展树: " << (checkPolicy<SplayBalance>() ? "正确" : "错误") << endl;
+}
+
+// 取出 BinarySearchTree 节点的大小，用来对比每个元素的内存占用
+struct PointerNodeSize : BinarySearchTree<int>{
+    static constexpr size_t value = sizeof(BinaryNode);
+};
+
+void testCompact(){
+    cout << "------------------------------" << endl;
+    mt19937 rnd(15);
+    CompactBinarySearchTree<int> tree;
+    set<int> ref;
+    for(int i = 0; i < 300000; i++){
+        int x = rnd() % 100000;
+        if(rnd() % 3){
+            tree.insert(x);
+            ref.insert(x);
+        }else{
+            tree.remove(x);
+            ref.erase(x);
+        }
+    }
+    bool ok = tree.validate() && tree.size() == ref.size() && tree.findMin() == *ref.begin() &&
+              tree.findMax() == *ref.rbegin();
+    for(int x = 0; x < 100000; x++)
+        ok = ok && tree.contains(x) == (ref.count(x) > 0);
+    auto copy = tree;
+    copy.optimizeLayout();
+    ok = ok && copy.validate();
+    for(int x = 0; x < 100000; x++)
+        ok = ok && copy.contains(x) == (ref.count(x) > 0);
+    for(int x : ref)
+        copy.remove(x);
+    ok = ok && copy.isEmpty() && tree.size() == ref.size();
+    cout << "紧凑树随机插入删除: " << (ok ? "正确" : "错误") << endl;
+
+    CompactBinarySearchTree<int> dense;
+    dense.reserve(ref.size());
+    for(int x : ref)
+        dense.insert(x);
+    cout << "每个元素占用字节数: 指针节点 " << PointerNodeSize::value << ", 紧凑节点 "
+         << (double)dense.memoryUsage() / dense.size() << endl;
+}
+
+void testSnapshot(){
+    cout << "------------------------------" << endl;
+    const int N = 1000000;
+    string path = (filesystem::temp_directory_path() / "bst_snapshot_test.bin").string();
+    mt19937 rnd(16);
+    vector<int> keys(N);
+    for(int i = 0; i < N; i++)
+        keys[i] = i * 3;
+    shuffle(keys.begin(), keys.end(), rnd);
+
+    auto start = chrono::steady_clock::now();
+    BinarySearchTree<int> tree;
+    for(int x : keys)
+        tree.insert(x);
+    auto insertTime = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start);
+    start = chrono::steady_clock::now();
+    tree.save(path);
+    auto saveTime = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start);
+    start = chrono::steady_clock::now();
+    BinarySearchTree<int> loaded;
+    loaded.insert(-5); // load 替换原有内容
+    loaded.load(path);
+    auto loadTime = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start);
+    start = chrono::steady_clock::now();
+    MappedSearchIndex<int> mapped(path);
+    auto mapTime = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start);
+    cout << "逐个插入 " << insertTime.count() << " 毫秒, 保存 " << saveTime.count() << " 毫秒, 载入 "
+         << loadTime.count() << " 毫秒, 映射 " << mapTime.count() << " 微秒" << endl;
+
+    bool ok = equal(tree.begin(), tree.end(), loaded.begin(), loaded.end()) && !loaded.contains(-5);
+    ok = ok && mapped.size() == (size_t)N;
+    for(int x = -3; x < 3 * N + 3; x += 1 + rnd() % 5)
+        ok = ok && mapped.contains(x) == tree.contains(x) && loaded.contains(x) == tree.contains(x);
+    ok = ok && mapped.rank(3 * 10) == 10 && *mapped.lower_bound(3 * 10 + 1) == 3 * 11 && mapped.lower_bound(3 * N) == nullptr;
+    cout << "快照保存/载入/映射: " << (ok ? "正确" : "错误") << endl;
+
+    // 元素类型不符、乱序、截断的文件都应当被拒绝，且原来的树保持不变
+    bool rejected = true;
+    try{
+        MappedSearchIndex<long long> wrong(path);
+        rejected = false;
+    }catch(const IllegalArgumentException &){}
+    // std::allocator 的树逐个释放节点：在中途发现乱序时，已经建好的部分不能泄漏
+    BinarySearchTree<int, less<int>, std::allocator<int>> plain;
+    plain.insert(1);
+    {
+        fstream f(path, ios::in | ios::out | ios::binary);
+        f.seekp(sizeof(SnapshotHeader) + N / 2 * sizeof(int));
+        int bad = 0;
+        f.write(reinterpret_cast<const char *>(&bad), sizeof(bad));
+    }
+    try{
+        plain.load(path);
+        rejected = false;
+    }catch(const IllegalArgumentException &){}
+    {
+        fstream f(path, ios::in | ios::out | ios::binary);
+        f.seekp(sizeof(SnapshotHeader) + 4 * sizeof(int));
+        int bad = 0;
+        f.write(reinterpret_cast<const char *>(&bad), sizeof(bad));
+    }
+    try{
+        loaded.load(path);
+        rejected = false;
+    }catch(const IllegalArgumentException &){}
+    filesystem::resize_file(path, sizeof(SnapshotHeader) + 100);
+    try{
+        loaded.load(path);
+        rejected = false;
+    }catch(const IOException &){}
+    try{
+        plain.load(path);
+        rejected = false;
+    }catch(const IOException &){}
+    try{
+        MappedSearchIndex<int> truncated(path);
+        rejected = false;
+    }catch(const IllegalArgumentException &){}
+    filesystem::remove(path);
+    ok = rejected && equal(tree.begin(), tree.end(), loaded.begin(), loaded.end());
+    ok = ok && plain.findMin() == 1 && plain.findMax() == 1;
+    cout << "拒绝损坏的快照: " << (ok ? "正确" : "错误") << endl;
+}
+
+void testExport(){
+    cout << "------------------------------" << endl;
+    vector<int> small{1, 2, 3, 4, 5, 6};
+    BinarySearchTree<int> tree(small.begin(), small.end());
+    ostringstream text, dot, json;
+    tree.printTree(text);
+    tree.exportTree(dot, ExportFormat::Dot);
+    tree.exportTree(json, ExportFormat::Json);
+    bool ok = text.str() == "1\n2\n3\n4\n5\n6\n";
+    ok = ok && json.str() == "{\"value\":3,\"left\":{\"value\":1,\"left\":null,\"right\":{\"value\":2,\"left\":null,"
+                             "\"right\":null}},\"right\":{\"value\":5,\"left\":{\"value\":4,\"left\":null,\"right\":null},"
+                             "\"right\":{\"value\":6,\"left\":null,\"right\":null}}}\n";
+    ok = ok && dot.str().find("n0 [label=\"3\\nh=3\"];") != string::npos && dot.str().find("n1 -> n3;") != string::npos &&
+         dot.str().find("n3 [shape=point];") != string::npos;
+    BinarySearchTree<string> words;
+    words.insert("say \"hi\"\n");
+    ostringstream escaped;
+    words.exportTree(escaped, ExportFormat::Json);
+    ok = ok && escaped.str() == "{\"value\":\"say \\\"hi\\\"\\u000a\",\"left\":null,\"right\":null}\n";
+    // 调用者提供的缓冲区和任意输出端
+    string collected;
+    char buffer[100];
+    tree.exportTree([&](string_view chunk){ collected += chunk; }, ExportFormat::InOrder, span<char>(buffer));
+    ok = ok && collected == text.str();
+    // 浮点数和格式标志与 out << x 一致；JSON 不受格式标志影响
+    BinarySearchTree<double> reals;
+    reals.insert(0.1 + 0.2);
+    reals.insert(1234567.0);
+    ostringstream realText, realJson, precise;
+    reals.printTree(realText);
+    reals.exportTree(realJson, ExportFormat::Json);
+    precise << setprecision(3) << fixed;
+    reals.printTree(precise);
+    ok = ok && realText.str() == "0.3\n1.23457e+06\n" && precise.str() == "0.300\n1234567.000\n" &&
+         realJson.str() == "{\"value\":0.30000000000000004,\"left\":null,\"right\":{\"value\":1234567,\"left\":null,"
+                           "\"right\":null}}\n";
+    // JSON 中的浮点数能原样读回，NaN 和无穷大写成 null
+    BinarySearchTree<double> special;
+    special.insert(0.1234567);
+    special.insert(numeric_limits<double>::infinity());
+    BinarySearchTree<double> notANumber;
+    notANumber.insert(numeric_limits<double>::quiet_NaN());
+    ostringstream specialJson, nanJson;
+    special.exportTree(specialJson, ExportFormat::Json);
+    notANumber.exportTree(nanJson, ExportFormat::Json);
+    ok = ok && specialJson.str() == "{\"value\":0.1234567,\"left\":null,\"right\":{\"value\":null,\"left\":null,"
+                                    "\"right\":null}}\n" &&
+         nanJson.str() == "{\"value\":null,\"left\":null,\"right\":null}\n";
+    ostringstream hexText, hexJson;
+    hexText << hex << showbase;
+    hexJson << hex;
+    tree.printTree(hexText);
+    tree.exportTree(hexJson, ExportFormat::Json);
+    ok = ok && hexText.str() == "0x1\n0x2\n0x3\n0x4\n0x5\n0x6\n" && hexJson.str() == json.str();
+    cout << "中序/DOT/JSON 导出: " << (ok ? "正确" : "错误") << endl;
+
+    // 与逐个元素 std::endl 的写法比较：写到文件，每次 endl 都是一次 write 系统调用
+    const int N = 1000000;
+    vector<int> keys(N);
+    for(int i = 0; i < N; i++)
+        keys[i] = i;
+    BinarySearchTree<int> big(keys.begin(), keys.end());
+    string path = (filesystem::temp_directory_path() / "bst_export_test.txt").string();
+    auto start = chrono::steady_clock::now();
+    {
+        ofstream out(path);
+        for(int x : big)
+            out << x << endl;
+    }
+    auto endlTime = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start);
+    start = chrono::steady_clock::now();
+    {
+        ofstream out(path);
+        big.printTree(out);
+    }
+    auto bufferedTime = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start);
+    filesystem::remove(path);
+    cout << N << " 个元素: 逐个 endl " << endlTime.count() << " 毫秒, 缓冲导出 " << bufferedTime.count() << " 毫秒" << endl;
+}
+
+void testStatistics(){
+    cout << "------------------------------" << endl;
+    const int N = 100000;
+    BinarySearchTree<int, less<int>, SlabAllocator<int>, NoSubtreeSize, AvlBalance, CollectTreeStatistics> tree;
+    // 顺序插入只会出现右右情况
+    for(int i = 0; i < N; i++)
+        tree.insert(i);
+    TreeStatistics s = tree.statistics();
+    bool ok = s.rotationsRR > 0 && s.rotationsLL == 0 && s.rotationsLR == 0 && s.rotationsRL == 0;
+    ok = ok && s.allocations == (uint64_t)N && s.searches == (uint64_t)N && s.comparisons > 0;
+
+    tree.resetStatistics();
+    mt19937 rnd(18);
+    for(int i = 0; i < N; i++){
+        int x = rnd() % (2 * N);
+        if(i % 2) tree.remove(x);
+        else tree.insert(x + 2 * N);
+    }
+    for(int i = 0; i < N; i++)
+        tree.contains(rnd() % (4 * N));
+    s = tree.statistics();
+    ok = ok && s.rotationsLR + s.rotationsRL > 0 && s.deallocations > 0 && s.searches == 2 * (uint64_t)N;
+    // AVL 树高不超过 1.44 log2(n + 2)
+    ok = ok && s.maxSearchDepth <= 1.44 * log2(N + 2) + 1 && s.averageSearchDepth() > 1;
+    ok = ok && tree.validate() && sizeof(BinarySearchTree<int>) < sizeof(tree);
+    cout << "统计计数: " << (ok ? "正确" : "错误") << endl;
+    s.forEach([](string_view name, auto value){
+        cout << "  " << name << " = " << value << endl;
+    });
+
+    // 拷贝出来的树逐个分配节点，分配次数就是元素个数
+    BinarySearchTree<int, less<int>, SlabAllocator<int>, TrackSubtreeSize, AvlBalance, CollectTreeStatistics> original;
+    for(int i = 0; i < 100; i++)
+        original.insert(i);
+    auto copied = original;
+    bool okCopy = copied.statistics().allocations == copied.size();
+    for(int i = 0; i < 100; i++)
+        copied.remove(i);
+    okCopy = okCopy && copied.statistics().allocations == copied.statistics().deallocations;
+    cout << "拷贝后的分配计数: " << (okCopy ? "正确" : "错误") << endl;
+
+    // 人为破坏高度字段，validate 应当发现
+    Checker<> chain;
+    chain.createChain(10);
+    cout << "validate 发现失衡: " << (!chain.validate() ? "正确" : "错误") << endl;
+}
+
+void testOrderedHashSet(){
+    cout << "------------------------------" << endl;
+    mt19937 rnd(19);
+    OrderedHashSet<int> hashed;
+    set<int> ref;
+    for(int i = 0; i < 300000; i++){
+        int x = rnd() % 100000;
+        if(rnd() % 3){
+            hashed.insert(x);
+            ref.insert(x);
+        }else{
+            hashed.remove(x);
+            ref.erase(x);
+        }
+    }
+    bool ok = hashed.validate() && hashed.size() == ref.size() && equal(hashed.begin(), hashed.end(), ref.begin(), ref.end());
+    ok = ok && hashed.findMin() == *ref.begin() && hashed.findMax() == *ref.rbegin();
+    for(int x = 0; x < 100000; x++){
+        auto it = hashed.find(x);
+        ok = ok && hashed.contains(x) == (ref.count(x) > 0) && (it != hashed.end()) == (ref.count(x) > 0);
+        // 由哈希表找到的迭代器可以继续按顺序走
+        if(it != hashed.end() && ++it != hashed.end())
+            ok = ok && *it == *ref.upper_bound(x);
+    }
+    auto copy = hashed;
+    copy.insert(-1);
+    ok = ok && copy.validate() && copy.contains(-1) && !hashed.contains(-1) && *copy.begin() == -1;
+    cout << "有序哈希集合: " << (ok ? "正确" : "错误") << endl;
+
+    const int N = 1000000;
+    vector<int> keys(N);
+    for(int i = 0; i < N; i++)
+        keys[i] = i * 2;
+    shuffle(keys.begin(), keys.end(), rnd);
+    BinarySearchTree<int> tree;
+    OrderedHashSet<int> both;
+    for(int x : keys){
+        tree.insert(x);
+        both.insert(x);
+    }
+    size_t hitsTree = 0, hitsHash = 0;
+    auto start = chrono::steady_clock::now();
+    for(int x : keys)
+        hitsTree += tree.contains(x + (x & 2));
+    auto treeTime = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start);
+    start = chrono::steady_clock::now();
+    for(int x : keys)
+        hitsHash += both.contains(x + (x & 2));
+    auto hashTime = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start);
+    cout << N << " 次查找: AVL 树 " << treeTime.count() << " 毫秒, 哈希索引 " << hashTime.count() << " 毫秒"
+         << (hitsTree == hitsHash ? "" : " (错误：结果不一致)") << endl;
+}
+
+// 值只能经由非 const 映射的 iterator 修改；键和出现次数在外部都是只读的
+template <typename Map>
+concept ValueWritable = requires(Map &m){ m.find(1)->second = 1; };
+template <typename Map>
+concept KeyWritable = requires(Map &m){ m.find(1)->first = 1; };
+template <typename Bag>
+concept CountWritable = requires(Bag &b){ b.find(1)->count = 1; };
+static_assert(ValueWritable<TreeMap<int, int>> && !ValueWritable<const TreeMap<int, int>>);
+static_assert(!KeyWritable<TreeMap<int, int>> && !CountWritable<TreeMultiset<int>>);
+
+void testTreeMap(){
+    cout << "------------------------------" << endl;
+    mt19937 rnd(20);
+    TreeMap<int, int> m;
+    map<int, int> ref;
+    for(int i = 0; i < 200000; i++){
+        int k = rnd() % 50000;
+        switch(rnd() % 4){
+        case 0: m[k] += 1; ref[k] += 1; break;
+        case 1: m.insert_or_assign(k, i); ref.insert_or_assign(k, i); break;
+        case 2: m.upsert(k, [](int &v){ v *= 2; }); ref[k] *= 2; break;
+        default: m.remove(k); ref.erase(k); break;
+        }
+    }
+    bool ok = m.validate() && m.size() == ref.size();
+    ok = ok && equal(m.begin(), m.end(), ref.begin(), ref.end(), [](const auto &a, const auto &b){
+        return a.first == b.first && a.second == b.second;
+    });
+    for(int k = 0; k < 50000; k++){
+        auto it = m.find(k);
+        ok = ok && (it != m.end()) == (ref.count(k) > 0) && m.contains(k) == (ref.count(k) > 0);
+    }
+    // 经由迭代器修改值，不影响顺序
+    if(!m.isEmpty()){
+        m.find(m.findMin().first)->second = -7;
+        ok = ok && m.begin()->second == -7;
+    }
+    // try_emplace 已存在时不覆盖，insert_or_assign 覆盖
+    TreeMap<string, string> names;
+    auto [it1, fresh1] = names.try_emplace(string("a"), 3, 'x');
+    auto [it2, fresh2] = names.try_emplace(string("a"), "y");
+    ok = ok && fresh1 && !fresh2 && it1 == it2 && it2->second == "xxx";
+    auto [it3, fresh3] = names.insert_or_assign("a", "z");
+    ok = ok && !fresh3 && it3->second == "z" && names["b"].empty() && names.size() == 2;
+    ostringstream out;
+    names.printTree(out);
+    ok = ok && out.str() == "a: z\nb: \n";
+    cout << "TreeMap: " << (ok ? "正确" : "错误") << endl;
+
+    TreeMultiset<int> bag;
+    map<int, size_t> counts;
+    size_t total = 0;
+    bool okBag = true;
+    for(int i = 0; i < 200000; i++){
+        int x = rnd() % 1000;
+        if(rnd() % 3){
+            size_t n = rnd() % 3 + 1;
+            bag.insert(x, n);
+            counts[x] += n;
+            total += n;
+        }else{
+            size_t removed = bag.remove(x);
+            size_t expect = counts.count(x) ? 1 : 0;
+            okBag = okBag && removed == expect;
+            if(expect && --counts[x] == 0)
+                counts.erase(x);
+            total -= expect;
+        }
+    }
+    okBag = okBag && bag.validate() && bag.size() == total && bag.distinctSize() == counts.size();
+    okBag = okBag && equal(bag.begin(), bag.end(), counts.begin(), counts.end(), [](const auto &a, const auto &b){
+        return a.value == b.first && a.count() == b.second;
+    });
+    for(int x = 0; x < 1000; x++)
+        okBag = okBag && bag.count(x) == (counts.count(x) ? counts[x] : 0);
+    if(!counts.empty()){
+        int x = counts.begin()->first;
+        okBag = okBag && bag.findMin() == x && bag.removeAll(x) == counts[x] && !bag.contains(x);
+    }
+    TreeMultiset<int> few;
+    few.insert(5, 3);
+    okBag = okBag && few.find(5)->count() == 3 && few.remove(5, 100) == 3 && few.size() == 0 && few.isEmpty();
+    cout << "TreeMultiset: " << (okBag ? "正确" : "错误") << endl;
+
+    // 移动以后计数跟着节点走，被移走的对象是空的
+    TreeMap<int, int> a;
+    a[1] = 10;
+    a[2] = 20;
+    TreeMap<int, int> b(std::move(a));
+    bool okMove = a.isEmpty() && a.size() == 0 && b.size() == 2;
+    TreeMap<int, int> c;
+    c[5] = 50;
+    c = std::move(b);
+    okMove = okMove && c.size() == 2 && c.find(1)->second == 10 && b.size() == size_t(distance(b.begin(), b.end()));
+    TreeMap<int, int> d(c);
+    okMove = okMove && d.size() == 2 && c.size() == 2;
+    TreeMultiset<int> bagA;
+    bagA.insert(3, 4);
+    TreeMultiset<int> bagB(std::move(bagA));
+    okMove = okMove && bagA.isEmpty() && bagA.size() == 0 && bagA.distinctSize() == 0;
+    okMove = okMove && bagB.size() == 4 && bagB.distinctSize() == 1;
+    TreeMultiset<int> bagC;
+    bagC.insert(7);
+    bagC = std::move(bagB);
+    okMove = okMove && bagC.size() == 4 && bagC.count(3) == 4;
+    okMove = okMove && bagB.size() == size_t(distance(bagB.begin(), bagB.end()));
+    cout << "TreeMap/TreeMultiset 移动: " << (okMove ? "正确" : "错误") << endl;
+
+    // 单词计数：先查找再插入要下降两次，upsert 只下降一次
+    const int N = 1000000;
+    vector<int> words(N);
+    for(int &w : words)
+        w = rnd() % N;
+    TreeMap<int, int> twice, once;
+    auto start = chrono::steady_clock::now();
+    for(int w : words){
+        auto it = twice.find(w);
+        if(it == twice.end())
+            twice.insert_or_assign(w, 1);
+        else
+            ++it->second;
+    }
+    auto twiceTime = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start);
+    start = chrono::steady_clock::now();
+    for(int w : words)
+        once.upsert(w, [](int &c){ ++c; });
+    auto onceTime = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start);
+    bool same = equal(twice.begin(), twice.end(), once.begin(), once.end(), [](const auto &a, const auto &b){
+        return a.first == b.first && a.second == b.second;
+    });
+    cout << N << " 次计数: 查找后插入 " << twiceTime.count() << " 毫秒, upsert " << onceTime.count() << " 毫秒"
+         << (same ? "" : " (错误：结果不一致)") << endl;
+}
+
 int main(){
     testRandomData();
     testIncreasingData();
+    testDeepChain();
+    testIterator();
+    testOrderStatistics();
+    testBulkLoad();
+    testBTree();
+    testFreeze();
+    testConcurrent();
+    testPersistent();
+    testComparator();
+    testEmplace();
+    testBatch();
+    testSetAlgebra();
+    testBalancePolicies();
+    testCompact();
+    testSnapshot();
+    testExport();
+    testStatistics();
+    testOrderedHashSet();
+    testTreeMap();
     return 0;
 }
\ No newline at end of file
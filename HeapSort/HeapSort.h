@@ -1,38 +1,348 @@
-#include <vector>
+/**
+ * @file HeapSort.h
+ * @brief 堆排序
+ *
+ * 对任意随机访问序列原地排序：std::vector、原生数组、std::span、std::deque，
+ * 或者内存映射文件上的一段指针区间。下标一律用 std::size_t，超过 2^31 个元素也不会溢出。
+ * 比较器的约定与 std::sort 相同（默认 std::less<>，结果升序）；ranges 版本还支持投影。
+ */
 
-using namespace std;
+#ifndef __HEAP_SORT_MARK__
+#define __HEAP_SORT_MARK__
 
-template <typename Comparable>
-void heapify(vector<Comparable> &a, int n, int i)
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <ranges>
+#include <utility>
+
+/**
+ * @brief 下沉：把 a[i] 放到以 i 为根的子树中合适的位置
+ *
+ * 与 std::make_heap 相同的二叉堆布局，i 的孩子是 2i+1 和 2i+2；
+ * 按 comp 是最大堆，即任何元素都不在父节点“之后”。
+ * 不逐层交换，而是先把 a[i] 取出来留下一个“空位”，
+ * 较大的孩子逐层上移填进空位，最后把取出的元素放进空位。每层只移动一次元素。
+ *
+ * @param a 堆的起点
+ * @param n 堆的大小
+ * @param i 要下沉的位置
+ * @param comp 比较器
+ */
+template <std::random_access_iterator RandomIt, typename Compare = std::less<>>
+void heapify(RandomIt a, std::size_t n, std::size_t i, Compare comp = {})
+{
+    std::iter_value_t<RandomIt> x = std::move(a[i]);
+    std::size_t hole = i;
+    std::size_t child = 2 * hole + 1;
+    while (child < n)
+    {
+        // 有右孩子且更大时选右孩子，编译成条件加法而不是分支
+        child += (child + 1 < n && comp(a[child], a[child + 1]));
+        if (!comp(x, a[child]))
+            break;
+        a[hole] = std::move(a[child]);
+        hole = child;
+        child = 2 * hole + 1;
+    }
+    a[hole] = std::move(x);
+}
+
+/**
+ * @brief d 叉堆的布局：同一个节点的孩子连续存放，并按 d 个元素对齐
+ *
+ * 通常的 d 叉堆中 i 的孩子是 d*i+1 .. d*i+d，每组孩子都错开一个元素，
+ * 常常横跨两个缓存行。这里让根只有 d-1 个孩子 1 .. d-1，
+ * 其余节点 i 的孩子是 d*i .. d*i+d-1，每组孩子从 d 的倍数开始。
+ * 数组起点按 d * sizeof(T) 对齐时（例如 4 叉堆存 int，vector 按 16 字节对齐），
+ * 每组孩子正好在一个缓存行里；叉数越多，堆越矮，一次下沉碰到的缓存行越少。
+ *
+ * @tparam D 叉数
+ */
+template <std::size_t D>
+struct DaryHeapLayout
+{
+    static_assert(D >= 2, "堆至少是二叉的");
+
+    static constexpr std::size_t Arity = D;
+
+    /// 第一个孩子
+    static std::size_t firstChild(std::size_t i)
+    {
+        return D * i + (i == 0);
+    }
+
+    /// 最后一个孩子之后的位置
+    static std::size_t endChild(std::size_t i)
+    {
+        return D * i + D;
+    }
+
+    static std::size_t parent(std::size_t i)
+    {
+        return i / D;
+    }
+
+    /**
+     * @brief 预取这组孩子往下几层的后代
+     *
+     * 一组孩子往下 k 层的后代在数组中是连续的一段。k 取最小的、使每个孩子至少对应 8 个后代的层数，
+     * 二叉、4 叉、8 叉堆分别是 3、2、1 层：再近来不及等到数据，再远一次要预取的缓存行太多。
+     *
+     * 必须强制内联：预取没有可见的副作用，GCC 会把只做预取的函数当成纯函数，
+     * 在内联之前就把调用删掉。
+     */
+    template <typename T>
+    [[gnu::always_inline]] static void prefetch(const T *a, std::size_t first, std::size_t n)
+    {
+        // 次数是编译期常量，循环完全展开；越界的地址收到最后一个元素上
+        std::size_t lo = first * Spread;
+        for (std::size_t k = 0; k < D * Spread; k += LineElements<T>)
+            __builtin_prefetch(a + std::min(lo + k, n - 1));
+    }
+
+private:
+    template <typename T>
+    static constexpr std::size_t LineElements = sizeof(T) < 64 ? 64 / sizeof(T) : 1;
+
+    /// D^k：一个孩子往下 k 层的后代个数
+    static constexpr std::size_t Spread = [] {
+        std::size_t spread = D;
+        while (spread < 8)
+            spread *= D;
+        return spread;
+    }();
+};
+
+/// 默认的堆布局
+using DefaultHeapLayout = DaryHeapLayout<4>;
+
+/**
+ * @brief first 开始的连续 K 个元素中最大的一个
+ *
+ * K 是 2 的幂时两两比较、逐轮淘汰：每一轮的比较互不依赖，
+ * 依赖链只有 log K 层，而逐个比较是 K-1 层。
+ */
+template <std::size_t K, typename RandomIt, typename Compare>
+std::size_t largestOf(RandomIt a, std::size_t first, Compare &comp)
+{
+    if constexpr (K == 1)
+    {
+        return first;
+    }
+    else if constexpr (K == 2)
+    {
+        return first + comp(a[first], a[first + 1]);
+    }
+    else if constexpr (K % 2 == 0)
+    {
+        std::size_t l = largestOf<K / 2>(a, first, comp);
+        std::size_t r = largestOf<K / 2>(a, first + K / 2, comp);
+        return comp(a[l], a[r]) ? r : l;
+    }
+    else
+    {
+        std::size_t best = first;
+        for (std::size_t c = first + 1; c < first + K; c++)
+            best = comp(a[best], a[c]) ? c : best;
+        return best;
+    }
+}
+
+/**
+ * @brief [first, last) 中最大的一个，孩子不满一组时使用
+ */
+template <typename RandomIt, typename Compare>
+std::size_t largestIn(RandomIt a, std::size_t first, std::size_t last, Compare &comp)
 {
-    int largest = i;
-    int left = 2 * i + 1;
-    int right = 2 * i + 2;
+    std::size_t best = first;
+    for (std::size_t c = first + 1; c < last; c++)
+        best = comp(a[best], a[c]) ? c : best;
+    return best;
+}
 
-    if (left < n && a[left] > a[largest])
-        largest = left;
+/**
+ * @brief 按布局 Layout 下沉：把 a[i] 放到以 i 为根的子树中合适的位置
+ *
+ * 与 heapify 相同，只是孩子的位置由 Layout 决定。
+ */
+template <typename Layout, typename RandomIt, typename Compare>
+void siftDown(RandomIt a, std::size_t n, std::size_t i, Compare &comp)
+{
+    if (Layout::firstChild(i) >= n)
+        return;
+    std::iter_value_t<RandomIt> x = std::move(a[i]);
+    std::size_t hole = i;
+    while (Layout::firstChild(hole) < n)
+    {
+        std::size_t first = Layout::firstChild(hole);
+        std::size_t last = Layout::endChild(hole);
+        std::size_t best = last - first == Layout::Arity && last <= n ? largestOf<Layout::Arity>(a, first, comp)
+                                                                       : largestIn(a, first, std::min(last, n), comp);
+        if (!comp(x, a[best]))
+            break;
+        a[hole] = std::move(a[best]);
+        hole = best;
+    }
+    a[hole] = std::move(x);
+}
 
-    if (right < n && a[right] > a[largest])
-        largest = right;
+/**
+ * @brief Floyd 的自底向上下沉：把 x 放进以 a[0] 为根、根是空位的堆中
+ *
+ * 排序阶段换到根上的元素来自堆底，几乎总要沉回底部。
+ * 所以先不和 x 比较，沿最大的孩子把空位一路推到叶子，
+ * 再让 x 从叶子往上浮到合适的位置，上浮通常只有一两层。
+ * 二叉堆的总比较次数约为 n log n，普通下沉约为 2 n log n。
+ *
+ * 选最大孩子不用分支，下一层读哪里取决于这一层的比较结果，
+ * 堆放不进缓存时每层的缓存缺失只能一个接一个地等；所以每层都预取下面几层的后代。
+ * 只有连续存放的序列才能预取，std::deque 之类的序列跳过这一步。
+ *
+ * @param a 堆的起点
+ * @param n 堆的大小
+ * @param x 要放入的元素
+ * @param comp 比较器
+ */
+template <typename Layout, typename RandomIt, typename Compare>
+void siftDownFromRoot(RandomIt a, std::size_t n, std::iter_value_t<RandomIt> x, Compare &comp)
+{
+    std::size_t hole = 0;
+    // 根的孩子可能不满一组（d 叉堆的根只有 d-1 个孩子），单独处理
+    if (Layout::firstChild(0) < n)
+    {
+        hole = largestIn(a, Layout::firstChild(0), std::min(Layout::endChild(0), n), comp);
+        a[0] = std::move(a[hole]);
+    }
+    // 孩子都存在时不用检查边界
+    while (hole > 0 && Layout::endChild(hole) <= n)
+    {
+        std::size_t first = Layout::firstChild(hole);
+        if constexpr (std::contiguous_iterator<RandomIt>)
+            Layout::prefetch(std::to_address(a), first, n);
+        std::size_t best;
+        if constexpr (Layout::Arity == 2)
+            best = comp(a[first], a[first + 1]) ? first + 1 : first;
+        else
+            best = largestOf<Layout::Arity>(a, first, comp);
+        a[hole] = std::move(a[best]);
+        hole = best;
+    }
+    // 最后一层只有一部分孩子
+    if (hole > 0 && Layout::firstChild(hole) < n)
+    {
+        std::size_t best = largestIn(a, Layout::firstChild(hole), n, comp);
+        a[hole] = std::move(a[best]);
+        hole = best;
+    }
+    // 上浮
+    while (hole > 0)
+    {
+        std::size_t parent = Layout::parent(hole);
+        if (!comp(a[parent], x))
+            break;
+        a[hole] = std::move(a[parent]);
+        hole = parent;
+    }
+    a[hole] = std::move(x);
+}
 
-    if (largest != i)
+/**
+ * @brief 上浮：a[i] 比父节点大时与父节点交换位置，直到堆序恢复
+ *
+ * 同样是空位法，每层只移动一次元素。
+ *
+ * @param a 堆的起点
+ * @param i 要上浮的位置
+ * @param comp 比较器
+ */
+template <typename Layout, typename RandomIt, typename Compare>
+void siftUp(RandomIt a, std::size_t i, Compare &comp)
+{
+    std::iter_value_t<RandomIt> x = std::move(a[i]);
+    while (i > 0)
     {
-        swap(a[i], a[largest]);
-        heapify(a, n, largest);
+        std::size_t parent = Layout::parent(i);
+        if (!comp(a[parent], x))
+            break;
+        a[i] = std::move(a[parent]);
+        i = parent;
     }
+    a[i] = std::move(x);
 }
 
-template <typename Comparable>
-void heapsort(vector<Comparable> &a)
+/**
+ * @brief 自底向上建堆，O(n)
+ *
+ * 有孩子的节点是一段前缀，从最后一个元素的父节点开始，叶子直接跳过。
+ *
+ * @param a 堆的起点
+ * @param n 元素个数
+ * @param comp 比较器
+ */
+template <typename Layout, typename RandomIt, typename Compare>
+void makeHeap(RandomIt a, std::size_t n, Compare &comp)
 {
-    int n = a.size();
+    if (n < 2)
+        return;
+    for (std::size_t i = Layout::parent(n - 1) + 1; i-- > 0;)
+        siftDown<Layout>(a, n, i, comp);
+}
+
+/**
+ * @brief 堆排序 [first, last)，按 comp 升序
+ *
+ * 建堆用普通下沉（子树很矮，先比较 x 能早停）；
+ * 排序阶段用自底向上的下沉。
+ * 不稳定；只用 O(1) 额外空间，可以直接排序内存映射的大文件。
+ *
+ * @tparam Layout 堆的布局 DaryHeapLayout<d>，默认 4 叉堆
+ * @param first 序列起点
+ * @param last 序列终点
+ * @param comp 严格弱序的比较器
+ */
+template <typename Layout = DefaultHeapLayout, std::random_access_iterator RandomIt, typename Compare = std::less<>>
+void heapsort(RandomIt first, RandomIt last, Compare comp = {})
+{
+    std::size_t n = static_cast<std::size_t>(last - first);
+    if (n < 2)
+        return;
 
-    for (int i = n / 2 - 1; i >= 0; i--)
-        heapify(a, n, i);
+    makeHeap<Layout>(first, n, comp);
 
-    for (int i = n - 1; i > 0; i--)
+    for (std::size_t i = n - 1; i > 0; i--)
     {
-        swap(a[0], a[i]);
-        heapify(a, i, 0);
+        // 堆顶移到末尾，原来的末尾元素从根下沉
+        std::iter_value_t<RandomIt> x = std::move(first[i]);
+        first[i] = std::move(first[0]);
+        siftDownFromRoot<Layout>(first, i, std::move(x), comp);
     }
 }
+
+/**
+ * @brief 堆排序整个范围，按 comp 比较 proj 投影后的值
+ *
+ * 与 std::ranges::sort 的约定相同，例如 heapsort(people, {}, &Person::age)。
+ *
+ * @tparam Layout 堆的布局，默认 4 叉堆
+ * @param r 随机访问范围：容器、原生数组、std::span 等
+ * @param comp 比较器
+ * @param proj 投影
+ * @return 范围的终点
+ */
+template <typename Layout = DefaultHeapLayout, std::ranges::random_access_range Range,
+          typename Compare = std::ranges::less, typename Proj = std::identity>
+    requires std::sortable<std::ranges::iterator_t<Range>, Compare, Proj>
+std::ranges::borrowed_iterator_t<Range> heapsort(Range &&r, Compare comp = {}, Proj proj = {})
+{
+    auto first = std::ranges::begin(r);
+    auto last = first + std::ranges::distance(r);
+    heapsort<Layout>(first, last, [&](const auto &x, const auto &y) {
+        return std::invoke(comp, std::invoke(proj, x), std::invoke(proj, y));
+    });
+    return last;
+}
+
+#endif
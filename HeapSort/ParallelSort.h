@@ -0,0 +1,261 @@
+/**
+ * @file ParallelSort.h
+ * @brief 多线程排序
+ *
+ * 并行归并排序：递归地把序列对半分，两半交给 WorkStealingPool 并行排序，
+ * 再把两半并行地归并起来。归并本身也按二分查找切成互不相关的小块并行执行，
+ * 所以最顶层那次 n 个元素的归并同样能用上所有线程。
+ * 块小到 grain 以下就不再分，在块内用内省排序（introsort）：
+ * 快速排序为主，递归太深时改用 HeapSort.h 的堆排序，保证最坏 O(n log n)。
+ */
+
+#ifndef __PARALLEL_SORT_MARK__
+#define __PARALLEL_SORT_MARK__
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <ranges>
+#include <utility>
+#include <vector>
+#include "HeapSort.h"
+#include "WorkStealingPool.h"
+
+/// 内省排序中改用插入排序的区间长度
+constexpr std::size_t IntrosortThreshold = 16;
+
+/// parallelSort 默认的块大小：块内顺序排序，块之间并行
+constexpr std::size_t ParallelSortGrain = std::size_t(1) << 16;
+
+/**
+ * @brief 插入排序，用于内省排序最后的小区间
+ */
+template <typename RandomIt, typename Compare>
+void insertionSort(RandomIt first, RandomIt last, Compare &comp)
+{
+    if (first == last)
+        return;
+    for (RandomIt i = first + 1; i != last; ++i)
+    {
+        std::iter_value_t<RandomIt> x = std::move(*i);
+        RandomIt hole = i;
+        for (; hole != first && comp(x, *(hole - 1)); --hole)
+            *hole = std::move(*(hole - 1));
+        *hole = std::move(x);
+    }
+}
+
+/**
+ * @brief 把 a、b、c 三者的中位数交换到 result
+ */
+template <typename RandomIt, typename Compare>
+void moveMedianToFirst(RandomIt result, RandomIt a, RandomIt b, RandomIt c, Compare &comp)
+{
+    if (comp(*a, *b))
+    {
+        if (comp(*b, *c))
+            std::iter_swap(result, b);
+        else if (comp(*a, *c))
+            std::iter_swap(result, c);
+        else
+            std::iter_swap(result, a);
+    }
+    else if (comp(*a, *c))
+        std::iter_swap(result, a);
+    else if (comp(*b, *c))
+        std::iter_swap(result, c);
+    else
+        std::iter_swap(result, b);
+}
+
+/**
+ * @brief 以 *pivot 为枢轴划分 [first, last)，返回右半部分的起点
+ *
+ * 枢轴是三数取中得到的，两边一定各有一个元素能挡住扫描，所以扫描不检查边界。
+ */
+template <typename RandomIt, typename Compare>
+RandomIt unguardedPartition(RandomIt first, RandomIt last, RandomIt pivot, Compare &comp)
+{
+    while (true)
+    {
+        while (comp(*first, *pivot))
+            ++first;
+        --last;
+        while (comp(*pivot, *last))
+            --last;
+        if (!(first < last))
+            return first;
+        std::iter_swap(first, last);
+        ++first;
+    }
+}
+
+/**
+ * @brief 内省排序的主循环
+ *
+ * 对较短的一半递归、对较长的一半循环，即使不限制 depth 栈深度也不超过 log2 n。
+ * depth 用完说明枢轴一直选得很差，剩下的区间改用堆排序。
+ */
+template <typename RandomIt, typename Compare>
+void introsortLoop(RandomIt first, RandomIt last, std::size_t depth, Compare &comp)
+{
+    while (static_cast<std::size_t>(last - first) > IntrosortThreshold)
+    {
+        if (depth == 0)
+        {
+            heapsort(first, last, std::ref(comp));
+            return;
+        }
+        --depth;
+        RandomIt mid = first + (last - first) / 2;
+        moveMedianToFirst(first, first + 1, mid, last - 1, comp);
+        RandomIt cut = unguardedPartition(first + 1, last, first, comp);
+        if (cut - first < last - cut)
+        {
+            introsortLoop(first, cut, depth, comp);
+            first = cut;
+        }
+        else
+        {
+            introsortLoop(cut, last, depth, comp);
+            last = cut;
+        }
+    }
+    insertionSort(first, last, comp);
+}
+
+/**
+ * @brief 内省排序
+ *
+ * 三数取中的快速排序，递归深度超过 2 log2 n 时改用堆排序，小区间用插入排序。
+ * 平均和快速排序一样快，最坏情况仍是 O(n log n)。不稳定，原地排序。
+ *
+ * @param first 序列起点
+ * @param last 序列终点
+ * @param comp 严格弱序的比较器
+ */
+template <std::random_access_iterator RandomIt, typename Compare = std::less<>>
+void introsort(RandomIt first, RandomIt last, Compare comp = {})
+{
+    std::size_t n = static_cast<std::size_t>(last - first);
+    if (n < 2)
+        return;
+    introsortLoop(first, last, 2 * static_cast<std::size_t>(std::bit_width(n) - 1), comp);
+}
+
+/**
+ * @brief 把有序的 a[0, na) 和 b[0, nb) 并行地归并（移动）到 out
+ *
+ * 在较长的一段取中点，到另一段里二分查找它的位置，两边各成一个独立的子问题。
+ * 相等的元素 a 中的排在 b 中的前面。
+ */
+template <typename InIt, typename OutIt, typename Compare>
+void parallelMerge(InIt a, std::size_t na, InIt b, std::size_t nb, OutIt out, Compare &comp, WorkStealingPool &pool,
+                   std::size_t grain)
+{
+    if (na + nb <= grain)
+    {
+        std::merge(std::make_move_iterator(a), std::make_move_iterator(a + na), std::make_move_iterator(b),
+                   std::make_move_iterator(b + nb), out, std::ref(comp));
+        return;
+    }
+    std::size_t ma, mb;
+    if (na >= nb)
+    {
+        ma = na / 2;
+        mb = static_cast<std::size_t>(std::lower_bound(b, b + nb, a[ma], std::ref(comp)) - b);
+    }
+    else
+    {
+        mb = nb / 2;
+        ma = static_cast<std::size_t>(std::upper_bound(a, a + na, b[mb], std::ref(comp)) - a);
+    }
+    pool.invoke([&] { parallelMerge(a, ma, b, mb, out, comp, pool, grain); },
+                [&] { parallelMerge(a + ma, na - ma, b + mb, nb - mb, out + (ma + mb), comp, pool, grain); });
+}
+
+/**
+ * @brief 并行归并排序 src[0, n)，intoDst 为真时结果放在 dst，否则留在 src
+ *
+ * 两个缓冲区轮流当归并的来源和目标：子问题把结果放在与自己相反的一边，
+ * 父问题再归并回来，每层只移动一次元素。
+ */
+template <typename SrcIt, typename DstIt, typename Compare>
+void parallelMergeSort(SrcIt src, DstIt dst, std::size_t n, bool intoDst, Compare &comp, WorkStealingPool &pool,
+                       std::size_t grain)
+{
+    if (n <= grain)
+    {
+        introsort(src, src + n, std::ref(comp));
+        if (intoDst)
+            std::move(src, src + n, dst);
+        return;
+    }
+    std::size_t half = n / 2;
+    pool.invoke([&] { parallelMergeSort(src, dst, half, !intoDst, comp, pool, grain); },
+                [&] { parallelMergeSort(src + half, dst + half, n - half, !intoDst, comp, pool, grain); });
+    if (intoDst)
+        parallelMerge(src, half, src + half, n - half, dst, comp, pool, grain);
+    else
+        parallelMerge(dst, half, dst + half, n - half, src, comp, pool, grain);
+}
+
+/**
+ * @brief 用多个线程排序 [first, last)
+ *
+ * 线程数由线程池决定，例如 WorkStealingPool pool(8); parallelSort(a.begin(), a.end(), {}, pool);
+ * 单线程或者序列不超过 grain 时直接内省排序，不占额外空间；
+ * 否则需要一个 n 个元素的缓冲区。不稳定（块内的内省排序不稳定）。
+ * 比较器抛出异常时异常会传给调用者，但序列中的元素可能已经丢失一部分。
+ *
+ * @param first 序列起点
+ * @param last 序列终点
+ * @param comp 严格弱序的比较器，会被多个线程同时调用
+ * @param pool 执行排序的线程池，默认是共享的硬件线程数大小的池
+ * @param grain 块大小：不超过它的子序列顺序排序、顺序归并。太小时任务调度开销占主导，
+ *              太大时块数不够分给所有线程
+ */
+template <std::random_access_iterator RandomIt, typename Compare = std::less<>>
+void parallelSort(RandomIt first, RandomIt last, Compare comp = {}, WorkStealingPool &pool = WorkStealingPool::shared(),
+                  std::size_t grain = ParallelSortGrain)
+{
+    std::size_t n = static_cast<std::size_t>(last - first);
+    if (n <= grain || pool.concurrency() == 1)
+    {
+        introsort(first, last, std::ref(comp));
+        return;
+    }
+    // 归并时一段至少要有 3 个元素才能切成两个都更小的子问题
+    grain = std::max<std::size_t>(grain, 2);
+    // 元素先整体移到缓冲区，排序时再归并回原序列，所以元素类型只需要可移动
+    std::vector<std::iter_value_t<RandomIt>> buffer(std::make_move_iterator(first), std::make_move_iterator(last));
+    parallelMergeSort(buffer.begin(), first, n, true, comp, pool, grain);
+}
+
+/**
+ * @brief 多线程排序整个范围，按 comp 比较 proj 投影后的值
+ *
+ * @param r 随机访问范围
+ * @param comp 比较器
+ * @param proj 投影
+ * @param pool 执行排序的线程池
+ * @param grain 块大小
+ * @return 范围的终点
+ */
+template <std::ranges::random_access_range Range, typename Compare = std::ranges::less, typename Proj = std::identity>
+    requires std::sortable<std::ranges::iterator_t<Range>, Compare, Proj>
+std::ranges::borrowed_iterator_t<Range> parallelSort(Range &&r, Compare comp = {}, Proj proj = {},
+                                                     WorkStealingPool &pool = WorkStealingPool::shared(),
+                                                     std::size_t grain = ParallelSortGrain)
+{
+    auto first = std::ranges::begin(r);
+    auto last = first + std::ranges::distance(r);
+    parallelSort(first, last, [&](const auto &x, const auto &y) {
+        return std::invoke(comp, std::invoke(proj, x), std::invoke(proj, y));
+    }, pool, grain);
+    return last;
+}
+
+#endif
@@ -0,0 +1,468 @@
+/**
+ * @file PriorityQueue.h
+ * @brief 建立在 HeapSort.h 的堆操作之上的优先队列
+ *
+ * BinaryHeap 是 std::priority_queue 的替代品：叉数可选，出队用自底向上的下沉，
+ * 批量建堆 O(n)，两个堆可以合并。
+ * IndexedHeap 额外给每个元素一个句柄，通过句柄到位置的映射在 O(log n) 内
+ * 修改任意元素的优先级或者删除它，适合 Dijkstra 一类需要 decrease-key 的算法。
+ */
+
+#ifndef __PRIORITY_QUEUE_MARK__
+#define __PRIORITY_QUEUE_MARK__
+
+#include <bit>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "HeapSort.h"
+
+/**
+ * @brief d 叉堆实现的优先队列
+ *
+ * 与 std::priority_queue 的约定相同：按 comp 最大的元素在堆顶，默认 std::less<T> 是最大堆。
+ *
+ * @tparam T 元素类型
+ * @tparam Compare 严格弱序的比较器
+ * @tparam Arity 叉数，默认 4
+ */
+template <typename T, typename Compare = std::less<T>, std::size_t Arity = 4>
+class BinaryHeap
+{
+    using Layout = DaryHeapLayout<Arity>;
+
+public:
+    BinaryHeap() = default;
+
+    explicit BinaryHeap(const Compare &c) : comp{c} {}
+
+    /**
+     * @brief 用 [first, last) 中的元素批量建堆，O(n)
+     */
+    template <std::input_iterator InputIt>
+    BinaryHeap(InputIt first, InputIt last, const Compare &c = Compare{}) : data(first, last), comp{c}
+    {
+        makeHeap<Layout>(data.begin(), data.size(), comp);
+    }
+
+    bool empty() const
+    {
+        return data.empty();
+    }
+
+    std::size_t size() const
+    {
+        return data.size();
+    }
+
+    void reserve(std::size_t n)
+    {
+        data.reserve(n);
+    }
+
+    void clear()
+    {
+        data.clear();
+    }
+
+    /**
+     * @brief 堆顶元素
+     *
+     * @throw std::out_of_range 堆为空
+     */
+    const T &top() const
+    {
+        if (data.empty())
+            throw std::out_of_range("BinaryHeap is empty");
+        return data.front();
+    }
+
+    void push(const T &x)
+    {
+        data.push_back(x);
+        siftUp<Layout>(data.begin(), data.size() - 1, comp);
+    }
+
+    void push(T &&x)
+    {
+        data.push_back(std::move(x));
+        siftUp<Layout>(data.begin(), data.size() - 1, comp);
+    }
+
+    template <typename... Args>
+    void emplace(Args &&...args)
+    {
+        data.emplace_back(std::forward<Args>(args)...);
+        siftUp<Layout>(data.begin(), data.size() - 1, comp);
+    }
+
+    /**
+     * @brief 删除堆顶元素
+     *
+     * 末尾元素填到根上，用自底向上的下沉，比较次数约为普通下沉的一半。
+     *
+     * @throw std::out_of_range 堆为空
+     */
+    void pop()
+    {
+        if (data.empty())
+            throw std::out_of_range("BinaryHeap is empty");
+        T x = std::move(data.back());
+        data.pop_back();
+        if (!data.empty())
+            siftDownFromRoot<Layout>(data.begin(), data.size(), std::move(x), comp);
+    }
+
+    /**
+     * @brief 把 other 中的元素全部并入本堆，other 变为空
+     *
+     * 并入的元素少时逐个上浮，O(k log(n+k))；多时追加后整体重新建堆，O(n+k)。
+     * other 就是本堆时与 merge(const BinaryHeap &) 相同，每个元素变成两份。
+     * other 更大时直接接管它的数组省去搬运，但它是按 other 的比较器排好的，
+     * 只有比较器没有状态时才能沿用这个堆序。
+     */
+    void merge(BinaryHeap &&other)
+    {
+        if (&other == this)
+        {
+            merge(static_cast<const BinaryHeap &>(other));
+            return;
+        }
+        if (std::is_empty_v<Compare> && other.data.size() > data.size())
+            std::swap(data, other.data);
+        std::size_t n = data.size();
+        std::size_t k = other.data.size();
+        data.insert(data.end(), std::make_move_iterator(other.data.begin()), std::make_move_iterator(other.data.end()));
+        other.data.clear();
+        appended(n, k);
+    }
+
+    /**
+     * @brief 把 other 中的元素全部复制到本堆，other 可以就是本堆
+     */
+    void merge(const BinaryHeap &other)
+    {
+        if (&other == this)
+        {
+            // vector 不能插入指向自己的区间，先复制一份
+            merge(BinaryHeap{other});
+            return;
+        }
+        std::size_t n = data.size();
+        std::size_t k = other.data.size();
+        data.insert(data.end(), other.data.begin(), other.data.end());
+        appended(n, k);
+    }
+
+private:
+    std::vector<T> data;
+    [[no_unique_address]] Compare comp;
+
+    /**
+     * @brief 前 n 个元素是堆，后面追加了 k 个元素，恢复堆序
+     */
+    void appended(std::size_t n, std::size_t k)
+    {
+        if (k * static_cast<std::size_t>(std::bit_width(n + k)) < n + k)
+        {
+            for (std::size_t i = n; i < n + k; i++)
+                siftUp<Layout>(data.begin(), i, comp);
+        }
+        else
+        {
+            makeHeap<Layout>(data.begin(), data.size(), comp);
+        }
+    }
+};
+
+/**
+ * @brief 带句柄的 d 叉堆，支持修改任意元素的优先级和删除任意元素
+ *
+ * push 返回一个句柄，之后可以用它读取、修改或删除这个元素。
+ * 句柄到堆中位置的映射随元素移动一起更新，所以这些操作都是 O(log n)。
+ * 元素出堆以后句柄会被回收、分给以后 push 的元素，不要再使用旧句柄。
+ *
+ * 默认是最小堆（Dijkstra 一类的用法）。decreaseKey / increaseKey 按最小堆的习惯命名：
+ * decreaseKey 让元素离堆顶更近，increaseKey 让它离堆顶更远；换成其他比较器时含义照此类推。
+ *
+ * @tparam T 元素（优先级）类型
+ * @tparam Compare 严格弱序的比较器，按它最大的元素在堆顶
+ * @tparam Arity 叉数，默认 4
+ */
+template <typename T, typename Compare = std::greater<T>, std::size_t Arity = 4>
+class IndexedHeap
+{
+    using Layout = DaryHeapLayout<Arity>;
+
+public:
+    using Handle = std::size_t;
+
+    IndexedHeap() = default;
+
+    explicit IndexedHeap(const Compare &c) : comp{c} {}
+
+    bool empty() const
+    {
+        return heap.empty();
+    }
+
+    std::size_t size() const
+    {
+        return heap.size();
+    }
+
+    /**
+     * @brief 预留 n 个元素的空间
+     */
+    void reserve(std::size_t n)
+    {
+        heap.reserve(n);
+        position.reserve(n);
+    }
+
+    /**
+     * @brief 删除所有元素，所有句柄失效
+     */
+    void clear()
+    {
+        heap.clear();
+        position.clear();
+        freeHandles.clear();
+    }
+
+    /**
+     * @brief 插入一个元素
+     *
+     * @return 这个元素的句柄
+     */
+    Handle push(T value)
+    {
+        // 先放入元素再登记句柄：任何一步抛出时，句柄和位置的映射都保持原样
+        bool fresh = freeHandles.empty();
+        Handle h = fresh ? position.size() : freeHandles.back();
+        heap.push_back({std::move(value), h});
+        if (fresh)
+        {
+            try
+            {
+                position.push_back(heap.size() - 1);
+            }
+            catch (...)
+            {
+                heap.pop_back();
+                throw;
+            }
+        }
+        else
+        {
+            freeHandles.pop_back();
+            position[h] = heap.size() - 1;
+        }
+        siftUp(heap.size() - 1);
+        return h;
+    }
+
+    /**
+     * @brief 堆顶元素
+     *
+     * @throw std::out_of_range 堆为空
+     */
+    const T &top() const
+    {
+        if (heap.empty())
+            throw std::out_of_range("IndexedHeap is empty");
+        return heap.front().value;
+    }
+
+    /**
+     * @brief 堆顶元素的句柄
+     *
+     * @throw std::out_of_range 堆为空
+     */
+    Handle topHandle() const
+    {
+        if (heap.empty())
+            throw std::out_of_range("IndexedHeap is empty");
+        return heap.front().handle;
+    }
+
+    /**
+     * @brief 删除堆顶元素
+     *
+     * @throw std::out_of_range 堆为空
+     */
+    void pop()
+    {
+        erase(topHandle());
+    }
+
+    /**
+     * @brief 句柄是否指向堆中的元素
+     */
+    bool contains(Handle h) const
+    {
+        return h < position.size() && position[h] != Npos;
+    }
+
+    /**
+     * @brief 句柄对应的元素
+     *
+     * @throw std::invalid_argument 句柄不在堆中
+     */
+    const T &value(Handle h) const
+    {
+        return heap[indexOf(h)].value;
+    }
+
+    /**
+     * @brief 把句柄对应的元素改为 v，v 不能比原来离堆顶更远
+     *
+     * @throw std::invalid_argument 句柄不在堆中，或者 v 比原来离堆顶更远
+     */
+    void decreaseKey(Handle h, T v)
+    {
+        std::size_t i = indexOf(h);
+        if (comp(v, heap[i].value))
+            throw std::invalid_argument("decreaseKey would move the element away from the top");
+        heap[i].value = std::move(v);
+        siftUp(i);
+    }
+
+    /**
+     * @brief 把句柄对应的元素改为 v，v 不能比原来离堆顶更近
+     *
+     * @throw std::invalid_argument 句柄不在堆中，或者 v 比原来离堆顶更近
+     */
+    void increaseKey(Handle h, T v)
+    {
+        std::size_t i = indexOf(h);
+        if (comp(heap[i].value, v))
+            throw std::invalid_argument("increaseKey would move the element toward the top");
+        heap[i].value = std::move(v);
+        siftDown(i);
+    }
+
+    /**
+     * @brief 把句柄对应的元素改为 v，向哪个方向调整由比较结果决定
+     *
+     * @throw std::invalid_argument 句柄不在堆中
+     */
+    void update(Handle h, T v)
+    {
+        std::size_t i = indexOf(h);
+        heap[i].value = std::move(v);
+        restore(i);
+    }
+
+    /**
+     * @brief 删除句柄对应的元素，句柄随之失效
+     *
+     * 末尾元素填到空出的位置上，再按它与新邻居的关系上浮或下沉。
+     *
+     * @throw std::invalid_argument 句柄不在堆中
+     */
+    void erase(Handle h)
+    {
+        std::size_t i = indexOf(h);
+        // 先登记空闲句柄：push_back 抛出时还什么都没改
+        freeHandles.push_back(h);
+        position[h] = Npos;
+        Entry last = std::move(heap.back());
+        heap.pop_back();
+        if (i == heap.size())
+            return;
+        place(i, std::move(last));
+        restore(i);
+    }
+
+private:
+    struct Entry
+    {
+        T value;
+        Handle handle;
+    };
+
+    /// 只比较元素值的比较器，交给 HeapSort.h 的 largestOf / largestIn 使用
+    struct EntryCompare
+    {
+        Compare &comp;
+
+        bool operator()(const Entry &a, const Entry &b) const
+        {
+            return comp(a.value, b.value);
+        }
+    };
+
+    static constexpr std::size_t Npos = static_cast<std::size_t>(-1);
+
+    std::vector<Entry> heap;
+    std::vector<std::size_t> position; ///< 句柄到堆中位置，不在堆中时为 Npos
+    std::vector<Handle> freeHandles;   ///< 可以复用的句柄
+    [[no_unique_address]] Compare comp;
+
+    std::size_t indexOf(Handle h) const
+    {
+        if (!contains(h))
+            throw std::invalid_argument("handle is not in the heap");
+        return position[h];
+    }
+
+    /**
+     * @brief 把元素放到位置 i，同时更新它的句柄映射
+     */
+    void place(std::size_t i, Entry &&e)
+    {
+        position[e.handle] = i;
+        heap[i] = std::move(e);
+    }
+
+    /**
+     * @brief 位置 i 的元素改变以后恢复堆序：比父节点大就上浮，否则下沉
+     */
+    void restore(std::size_t i)
+    {
+        if (i > 0 && comp(heap[Layout::parent(i)].value, heap[i].value))
+            siftUp(i);
+        else
+            siftDown(i);
+    }
+
+    void siftUp(std::size_t i)
+    {
+        Entry x = std::move(heap[i]);
+        while (i > 0)
+        {
+            std::size_t parent = Layout::parent(i);
+            if (!comp(heap[parent].value, x.value))
+                break;
+            place(i, std::move(heap[parent]));
+            i = parent;
+        }
+        place(i, std::move(x));
+    }
+
+    void siftDown(std::size_t i)
+    {
+        EntryCompare byValue{comp};
+        std::size_t n = heap.size();
+        Entry x = std::move(heap[i]);
+        while (Layout::firstChild(i) < n)
+        {
+            std::size_t first = Layout::firstChild(i);
+            std::size_t last = Layout::endChild(i);
+            std::size_t best = last - first == Arity && last <= n ? largestOf<Arity>(heap.begin(), first, byValue)
+                                                                   : largestIn(heap.begin(), first, std::min(last, n), byValue);
+            if (!comp(x.value, heap[best].value))
+                break;
+            place(i, std::move(heap[best]));
+            i = best;
+        }
+        place(i, std::move(x));
+    }
+};
+
+#endif
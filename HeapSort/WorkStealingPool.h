@@ -0,0 +1,259 @@
+/**
+ * @file WorkStealingPool.h
+ * @brief 分治算法用的 work-stealing 线程池
+ *
+ * invoke(f, g) 的约定与 BST/ForkJoinPool.h 相同，区别只在任务队列：
+ * 那里所有线程共用一个队列和一把锁，这里每个线程有自己的队列，g 放进当前线程队列的末尾。
+ * 线程从自己队列的末尾取任务（最近放入、数据还在缓存里的小任务），
+ * 空闲时从别的队列的开头偷任务（最早放入、通常最大的任务），
+ * 一次偷窃就能拿走一大块工作，线程之间很少争用同一把锁。
+ */
+
+#ifndef __WORK_STEALING_POOL_MARK__
+#define __WORK_STEALING_POOL_MARK__
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+/**
+ * @brief work-stealing 线程池
+ *
+ * 工作线程各有一个队列；调用者如果不是本池的工作线程，就使用 0 号队列，
+ * 所以并发度为 n 的池有 n 个队列、n - 1 个工作线程。
+ * 空闲的工作线程在条件变量上睡眠，任何队列放入任务时唤醒一个。
+ */
+class WorkStealingPool
+{
+public:
+    /**
+     * @brief 构造线程池
+     *
+     * @param threads 并发度（包括调用者），默认是硬件线程数
+     */
+    explicit WorkStealingPool(unsigned threads = std::thread::hardware_concurrency())
+        : queueCount{std::max(threads, 1u)}, queues{new Queue[queueCount]}
+    {
+        for (unsigned i = 1; i < queueCount; ++i)
+            workers.emplace_back([this, i] { work(i); });
+    }
+
+    WorkStealingPool(const WorkStealingPool &) = delete;
+    WorkStealingPool &operator=(const WorkStealingPool &) = delete;
+
+    ~WorkStealingPool()
+    {
+        {
+            std::lock_guard<std::mutex> guard{sleepLock};
+            stopping = true;
+        }
+        wakeUp.notify_all();
+        for (std::thread &t : workers)
+            t.join();
+    }
+
+    /**
+     * @brief 进程内共享的默认线程池，第一次使用时创建
+     */
+    static WorkStealingPool &shared()
+    {
+        static WorkStealingPool pool;
+        return pool;
+    }
+
+    /**
+     * @brief 参与计算的线程数，包括调用者
+     */
+    unsigned concurrency() const
+    {
+        return queueCount;
+    }
+
+    /**
+     * @brief 并行执行 f 和 g，两者都完成后返回，异常的处理与 ForkJoinPool::invoke 相同
+     *
+     * g 没被偷走时由当前线程收回；被偷走时当前线程先做自己队列里的任务，再去偷别人的。
+     */
+    template <typename F, typename G>
+    void invoke(F &&f, G &&g)
+    {
+        if (workers.empty())
+        {
+            f();
+            g();
+            return;
+        }
+        using Callable = std::remove_reference_t<G>;
+        Task task{[](void *p) { (*static_cast<Callable *>(p))(); },
+                  const_cast<void *>(static_cast<const void *>(std::addressof(g)))};
+        std::size_t self = currentQueue();
+        push(self, &task);
+        std::exception_ptr error;
+        try
+        {
+            f();
+        }
+        catch (...)
+        {
+            error = std::current_exception();
+        }
+        if (reclaim(self, &task))
+            task.run();
+        else
+            while (!task.done.load(std::memory_order_acquire))
+                if (!runOne(self))
+                    std::this_thread::yield();
+        if (error)
+            std::rethrow_exception(error);
+        if (task.error)
+            std::rethrow_exception(task.error);
+    }
+
+private:
+    /// 与 ForkJoinPool::Task 相同：存放在发起者的栈上
+    struct Task
+    {
+        void (*call)(void *);
+        void *arg;
+        std::atomic<bool> done{false};
+        std::exception_ptr error;
+
+        Task(void (*c)(void *), void *a) : call{c}, arg{a} {}
+
+        void run()
+        {
+            try
+            {
+                call(arg);
+            }
+            catch (...)
+            {
+                error = std::current_exception();
+            }
+            done.store(true, std::memory_order_release);
+        }
+    };
+
+    /**
+     * @brief 一个线程的任务队列，各占一个缓存行，避免相邻队列的锁互相干扰
+     */
+    struct alignas(64) Queue
+    {
+        std::mutex lock;
+        std::deque<Task *> tasks;
+    };
+
+    unsigned queueCount;                ///< 队列数，也就是并发度
+    std::unique_ptr<Queue[]> queues;    ///< 0 号给外部线程，其余每个工作线程一个
+    std::atomic<std::size_t> pending{0}; ///< 所有队列中等待执行的任务数
+    std::mutex sleepLock;               ///< 保护 stopping，配合 wakeUp 使用
+    std::condition_variable wakeUp;     ///< 有新任务或线程池关闭
+    bool stopping = false;              ///< 析构时通知工作线程退出
+    std::vector<std::thread> workers;   ///< 工作线程
+
+    /// 当前线程所属的线程池和队列，不是任何池的工作线程时为空
+    static inline thread_local const WorkStealingPool *currentPool = nullptr;
+    static inline thread_local std::size_t currentIndex = 0;
+
+    std::size_t currentQueue() const
+    {
+        return currentPool == this ? currentIndex : 0;
+    }
+
+    void push(std::size_t self, Task *task)
+    {
+        {
+            std::lock_guard<std::mutex> guard{queues[self].lock};
+            queues[self].tasks.push_back(task);
+        }
+        pending.fetch_add(1, std::memory_order_release);
+        // 先拿一下 sleepLock 再通知：正在检查条件、准备睡眠的线程不会错过这次通知
+        {
+            std::lock_guard<std::mutex> guard{sleepLock};
+        }
+        wakeUp.notify_one();
+    }
+
+    /**
+     * @brief 任务还没被偷走时把它从自己的队列中取回
+     */
+    bool reclaim(std::size_t self, Task *task)
+    {
+        std::lock_guard<std::mutex> guard{queues[self].lock};
+        std::deque<Task *> &tasks = queues[self].tasks;
+        auto it = std::find(tasks.rbegin(), tasks.rend(), task);
+        if (it == tasks.rend())
+            return false;
+        tasks.erase(std::next(it).base());
+        pending.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    /**
+     * @brief 先从自己队列的末尾取任务，没有就依次从别的队列开头偷一个
+     */
+    Task *take(std::size_t self)
+    {
+        if (pending.load(std::memory_order_acquire) == 0)
+            return nullptr;
+        for (std::size_t k = 0; k < queueCount; ++k)
+        {
+            std::size_t victim = (self + k) % queueCount;
+            std::lock_guard<std::mutex> guard{queues[victim].lock};
+            std::deque<Task *> &tasks = queues[victim].tasks;
+            if (tasks.empty())
+                continue;
+            Task *task;
+            if (k == 0)
+            {
+                task = tasks.back();
+                tasks.pop_back();
+            }
+            else
+            {
+                task = tasks.front();
+                tasks.pop_front();
+            }
+            pending.fetch_sub(1, std::memory_order_relaxed);
+            return task;
+        }
+        return nullptr;
+    }
+
+    /**
+     * @brief 取一个任务执行，所有队列都为空时返回 false
+     */
+    bool runOne(std::size_t self)
+    {
+        Task *task = take(self);
+        if (task == nullptr)
+            return false;
+        task->run();
+        return true;
+    }
+
+    void work(std::size_t index)
+    {
+        currentPool = this;
+        currentIndex = index;
+        while (true)
+        {
+            if (runOne(index))
+                continue;
+            std::unique_lock<std::mutex> guard{sleepLock};
+            wakeUp.wait(guard, [this] { return stopping || pending.load(std::memory_order_acquire) > 0; });
+            if (stopping)
+                return;
+        }
+    }
+};
+
+#endif
@@ -3,7 +3,22 @@
 #include <random>
 #include <chrono>
 #include <algorithm>
+#include <string>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <span>
+#include <queue>
+#include <set>
+#include <stdexcept>
+#include <limits>
+#include <numeric>
+#include <atomic>
+#include <cmath>
+#include <thread>
 #include "HeapSort.h"
+#include "PriorityQueue.h"
+#include "ParallelSort.h"
 
 using namespace std;
 using namespace std::chrono;
@@ -94,14 +109,678 @@ void runTest(const string &testName, vector<int> &arr)
     duration = duration_cast<milliseconds>(end - start);
     cout << "标准库sort_heap用时: " << duration.count() << " 毫秒" << endl;
     cout << "排序结果正确: " << (check(arr_std) ? "是" : "否") << endl;
+    cout << "与标准库结果一致: " << (arr_custom == arr_std ? "是" : "否") << endl;
 }
 
-int main()
+// 记录比较次数的整数
+struct CountedInt
+{
+    int value;
+    static inline long long comparisons = 0;
+
+    bool operator<(const CountedInt &rhs) const
+    {
+        ++comparisons;
+        return value < rhs.value;
+    }
+};
+
+// 比较次数：逐层比较的下沉约 2 n log n，自底向上的下沉约 n log n（标准库同样是自底向上）
+void countComparisons(const vector<int> &arr)
+{
+    vector<CountedInt> topDown(arr.size()), custom(arr.size()), std_(arr.size());
+    for (size_t i = 0; i < arr.size(); i++)
+        topDown[i].value = custom[i].value = std_[i].value = arr[i];
+
+    CountedInt::comparisons = 0;
+    size_t n = topDown.size();
+    for (size_t i = n / 2; i-- > 0;)
+        heapify(topDown.begin(), n, i);
+    for (size_t i = n - 1; i > 0; i--)
+    {
+        swap(topDown[0], topDown[i]);
+        heapify(topDown.begin(), i, 0);
+    }
+    long long topDownCount = CountedInt::comparisons;
+
+    vector<CountedInt> quaternary = custom;
+    CountedInt::comparisons = 0;
+    heapsort<DaryHeapLayout<2>>(custom.begin(), custom.end());
+    long long customCount = CountedInt::comparisons;
+
+    CountedInt::comparisons = 0;
+    heapsort<DaryHeapLayout<4>>(quaternary.begin(), quaternary.end());
+    long long quaternaryCount = CountedInt::comparisons;
+
+    CountedInt::comparisons = 0;
+    make_heap(std_.begin(), std_.end());
+    sort_heap(std_.begin(), std_.end());
+    long long stdCount = CountedInt::comparisons;
+
+    cout << "\n比较次数 (随机序列, 大小: " << arr.size() << ")" << endl;
+    cout << "逐层下沉: " << topDownCount << ", 自底向上下沉: " << customCount << ", 4 叉堆: " << quaternaryCount
+         << ", 标准库: " << stdCount << endl;
+}
+
+// 各种堆布局的排序结果都要与 std::sort 一致，包括很小的数组和最后一层不满的情况
+template <typename Layout>
+bool checkLayout()
+{
+    mt19937 gen(22);
+    for (int n = 0; n < 3000; n += (n < 200 ? 1 : 37))
+    {
+        vector<int> arr(n);
+        for (int &x : arr)
+            x = gen() % (n + 1);
+        vector<int> expected = arr;
+        sort(expected.begin(), expected.end());
+        heapsort<Layout>(arr);
+        if (arr != expected)
+            return false;
+    }
+    return true;
+}
+
+void testLayouts()
+{
+    cout << "\n堆布局正确性" << endl;
+    cout << "二叉堆: " << (checkLayout<DaryHeapLayout<2>>() ? "是" : "否") << endl;
+    cout << "3 叉堆: " << (checkLayout<DaryHeapLayout<3>>() ? "是" : "否") << endl;
+    cout << "4 叉堆: " << (checkLayout<DaryHeapLayout<4>>() ? "是" : "否") << endl;
+    cout << "8 叉堆: " << (checkLayout<DaryHeapLayout<8>>() ? "是" : "否") << endl;
+}
+
+struct Record
+{
+    int key;
+    int id;
+};
+
+// 迭代器、比较器、投影以及 vector 以外的各种序列
+void testGenericApi()
+{
+    cout << "\n通用接口" << endl;
+    mt19937 gen(23);
+    const size_t N = 100000;
+    vector<int> source(N);
+    for (int &x : source)
+        x = gen() % 1000;
+    vector<int> ascending = source;
+    sort(ascending.begin(), ascending.end());
+    vector<int> descending(ascending.rbegin(), ascending.rend());
+
+    // 原生数组
+    int raw[1000];
+    copy(source.begin(), source.begin() + 1000, raw);
+    heapsort(raw);
+    bool ok = is_sorted(begin(raw), end(raw));
+
+    // 一段裸指针区间，相当于内存映射文件上的一列
+    unique_ptr<int[]> buffer(new int[N]);
+    copy(source.begin(), source.end(), buffer.get());
+    heapsort(buffer.get(), buffer.get() + N);
+    ok = ok && equal(buffer.get(), buffer.get() + N, ascending.begin());
+
+    // std::span，降序
+    vector<int> spanned = source;
+    heapsort(span<int>(spanned), greater<>());
+    ok = ok && spanned == descending;
+
+    // std::deque 不连续存放，不预取
+    deque<int> dq(source.begin(), source.end());
+    heapsort(dq.begin(), dq.end());
+    ok = ok && equal(dq.begin(), dq.end(), ascending.begin());
+    cout << "数组、指针区间、span、deque: " << (ok ? "是" : "否") << endl;
+
+    // 投影：按 key 排序，比较器与投影一起使用
+    vector<Record> records(N);
+    for (size_t i = 0; i < N; i++)
+        records[i] = {source[i], static_cast<int>(i)};
+    auto end = heapsort(records, ranges::greater(), &Record::key);
+    bool projected = end == records.end();
+    for (size_t i = 0; i < N; i++)
+        projected = projected && records[i].key == descending[i];
+    heapsort<DaryHeapLayout<8>>(records, {}, [](const Record &r) { return r.id; });
+    for (size_t i = 0; i < N; i++)
+        projected = projected && records[i].id == static_cast<int>(i);
+    cout << "投影: " << (projected ? "是" : "否") << endl;
+}
+
+// BinaryHeap 与 std::priority_queue 执行相同的操作，每次比较堆顶
+template <size_t Arity, typename Compare>
+bool checkBinaryHeap(Compare comp)
+{
+    mt19937 gen(24 + Arity);
+    BinaryHeap<int, Compare, Arity> heap(comp);
+    priority_queue<int, vector<int>, Compare> ref(comp);
+    bool ok = true;
+    for (int i = 0; i < 200000 && ok; i++)
+    {
+        if (gen() % 3 != 0 || ref.empty())
+        {
+            int x = gen() % 10000;
+            heap.push(x);
+            ref.push(x);
+        }
+        else
+        {
+            heap.pop();
+            ref.pop();
+        }
+        ok = heap.size() == ref.size() && (ref.empty() || heap.top() == ref.top());
+    }
+    // 批量建堆和合并：一大一小（逐个上浮）、一样大（重新建堆）
+    vector<int> values(5000);
+    for (int &x : values)
+        x = gen() % 10000;
+    BinaryHeap<int, Compare, Arity> built(values.begin(), values.end(), comp);
+    BinaryHeap<int, Compare, Arity> few(values.begin(), values.begin() + 10, comp);
+    BinaryHeap<int, Compare, Arity> same(values.begin(), values.end(), comp);
+    built.merge(few);
+    built.merge(std::move(same));
+    // 与自己合并：每个元素变成两份
+    few.merge(few);
+    few.merge(std::move(few));
+    vector<int> expected = values;
+    expected.insert(expected.end(), values.begin(), values.begin() + 10);
+    expected.insert(expected.end(), values.begin(), values.end());
+    vector<int> doubled;
+    for (int copies = 0; copies < 4; copies++)
+        doubled.insert(doubled.end(), values.begin(), values.begin() + 10);
+    sort(doubled.begin(), doubled.end(), [&](int a, int b) { return comp(b, a); });
+    ok = ok && few.size() == doubled.size();
+    for (size_t i = 0; i < doubled.size() && ok; i++)
+    {
+        ok = few.top() == doubled[i];
+        few.pop();
+    }
+    sort(expected.begin(), expected.end(), [&](int a, int b) { return comp(b, a); });
+    ok = ok && same.empty() && built.size() == expected.size();
+    for (size_t i = 0; i < expected.size() && ok; i++)
+    {
+        ok = built.top() == expected[i];
+        built.pop();
+    }
+    return ok;
+}
+
+// 方向由状态决定的比较器：两个堆的比较器不同时，合并要按本堆的方向重新排
+struct Direction
+{
+    bool descending;
+
+    bool operator()(int a, int b) const
+    {
+        return descending ? a > b : a < b;
+    }
+};
+
+bool checkStatefulMerge()
+{
+    vector<int> values(1000);
+    iota(values.begin(), values.end(), 0);
+    BinaryHeap<int, Direction> maxHeap(values.begin(), values.begin() + 10, Direction{false});
+    BinaryHeap<int, Direction> minHeap(values.begin(), values.end(), Direction{true});
+    maxHeap.merge(std::move(minHeap));
+    bool ok = minHeap.empty() && maxHeap.size() == 1010;
+    for (int expect : {999, 998, 997})
+    {
+        ok = ok && maxHeap.top() == expect;
+        maxHeap.pop();
+    }
+    return ok;
+}
+
+// 移动时可以按要求抛出异常的元素
+struct Fragile
+{
+    static inline bool fail = false;
+    int value;
+
+    Fragile(int v) : value{v} {}
+    Fragile(const Fragile &) = default;
+    Fragile(Fragile &&rhs) : value{rhs.value}
+    {
+        if (fail)
+            throw runtime_error("move failed");
+    }
+    Fragile &operator=(const Fragile &) = default;
+    Fragile &operator=(Fragile &&) = default;
+
+    bool operator>(const Fragile &rhs) const
+    {
+        return value > rhs.value;
+    }
+};
+
+// push 抛出异常时不占用句柄，之后的句柄不会与已有元素重叠
+bool checkIndexedHeapPushFailure()
+{
+    IndexedHeap<Fragile> heap;
+    size_t a = heap.push(1);
+    Fragile::fail = true;
+    bool thrown = false;
+    try { heap.push(2); } catch (const runtime_error &) { thrown = true; }
+    Fragile::fail = false;
+    bool ok = thrown && heap.size() == 1 && !heap.contains(a + 1);
+    size_t b = heap.push(0);
+    ok = ok && b != a && heap.contains(b) && heap.topHandle() == b && heap.value(a).value == 1;
+    heap.pop();
+    return ok && heap.topHandle() == a && heap.size() == 1;
+}
+
+// IndexedHeap 与 std::set 执行相同的操作，包括按句柄修改和删除
+bool checkIndexedHeap()
+{
+    mt19937 gen(25);
+    IndexedHeap<int> heap;
+    set<pair<int, size_t>> ref; // (值, 句柄)，最小的在前
+    vector<size_t> live;
+    bool ok = true;
+    for (int i = 0; i < 200000 && ok; i++)
+    {
+        int op = gen() % 6;
+        if (op <= 1 || live.empty())
+        {
+            int x = gen() % 100000;
+            size_t h = heap.push(x);
+            ref.insert({x, h});
+            live.push_back(h);
+        }
+        else
+        {
+            size_t k = gen() % live.size();
+            size_t h = live[k];
+            int old = heap.value(h);
+            if (op == 2)
+            {
+                heap.decreaseKey(h, old - static_cast<int>(gen() % 1000));
+            }
+            else if (op == 3)
+            {
+                heap.increaseKey(h, old + static_cast<int>(gen() % 1000));
+            }
+            else if (op == 4)
+            {
+                heap.update(h, gen() % 100000);
+            }
+            else
+            {
+                h = heap.topHandle();
+                k = find(live.begin(), live.end(), h) - live.begin();
+                old = heap.top();
+                heap.pop();
+            }
+            ref.erase({old, h});
+            if (heap.contains(h))
+                ref.insert({heap.value(h), h});
+            else
+            {
+                live[k] = live.back();
+                live.pop_back();
+            }
+        }
+        if (gen() % 16 == 0 && !live.empty())
+        {
+            size_t k = gen() % live.size();
+            ref.erase({heap.value(live[k]), live[k]});
+            heap.erase(live[k]);
+            live[k] = live.back();
+            live.pop_back();
+        }
+        ok = heap.size() == ref.size() && (ref.empty() || heap.top() == ref.begin()->first);
+    }
+    // 方向不对的 decreaseKey、失效的句柄、空堆都要抛出异常
+    int thrown = 0;
+    if (!live.empty())
+    {
+        size_t h = live.front();
+        try { heap.decreaseKey(h, heap.value(h) + 1); } catch (const invalid_argument &) { thrown++; }
+        heap.erase(h);
+        try { heap.value(h); } catch (const invalid_argument &) { thrown++; }
+    }
+    heap.clear();
+    try { heap.top(); } catch (const out_of_range &) { thrown++; }
+    return ok && thrown == 3;
+}
+
+void testPriorityQueue()
+{
+    cout << "\n优先队列正确性" << endl;
+    cout << "BinaryHeap (二叉, 最大堆): " << (checkBinaryHeap<2>(less<int>()) ? "是" : "否") << endl;
+    cout << "BinaryHeap (4 叉, 最大堆): " << (checkBinaryHeap<4>(less<int>()) ? "是" : "否") << endl;
+    cout << "BinaryHeap (8 叉, 最小堆): " << (checkBinaryHeap<8>(greater<int>()) ? "是" : "否") << endl;
+    cout << "BinaryHeap (比较器有状态的合并): " << (checkStatefulMerge() ? "是" : "否") << endl;
+    cout << "IndexedHeap: " << (checkIndexedHeap() ? "是" : "否") << endl;
+    cout << "IndexedHeap (push 抛出异常): " << (checkIndexedHeapPushFailure() ? "是" : "否") << endl;
+}
+
+// 先插入 n 个随机数再全部弹出，返回毫秒数
+template <typename Queue>
+double pushPopAll(const vector<int> &values, long long &checksum)
+{
+    auto start = high_resolution_clock::now();
+    Queue q;
+    for (int x : values)
+        q.push(x);
+    while (!q.empty())
+    {
+        checksum += q.top();
+        q.pop();
+    }
+    return duration<double, milli>(high_resolution_clock::now() - start).count();
+}
+
+struct Edge
+{
+    int to;
+    int weight;
+};
+
+// 随机有向图上的 Dijkstra：std::priority_queue 只能重复入队、出队时跳过过期的项
+vector<long long> dijkstraLazy(const vector<vector<Edge>> &graph)
+{
+    vector<long long> dist(graph.size(), numeric_limits<long long>::max());
+    priority_queue<pair<long long, int>, vector<pair<long long, int>>, greater<>> q;
+    dist[0] = 0;
+    q.push({0, 0});
+    while (!q.empty())
+    {
+        auto [d, u] = q.top();
+        q.pop();
+        if (d != dist[u])
+            continue;
+        for (const Edge &e : graph[u])
+        {
+            if (d + e.weight < dist[e.to])
+            {
+                dist[e.to] = d + e.weight;
+                q.push({dist[e.to], e.to});
+            }
+        }
+    }
+    return dist;
+}
+
+// IndexedHeap：每个顶点最多在堆中一次，松弛时 decreaseKey
+vector<long long> dijkstraIndexed(const vector<vector<Edge>> &graph)
+{
+    const size_t None = numeric_limits<size_t>::max();
+    vector<long long> dist(graph.size(), numeric_limits<long long>::max());
+    vector<size_t> handle(graph.size(), None);
+    vector<int> vertexOf(graph.size());
+    IndexedHeap<long long> q;
+    q.reserve(graph.size());
+    dist[0] = 0;
+    handle[0] = q.push(0);
+    vertexOf[handle[0]] = 0;
+    while (!q.empty())
+    {
+        int u = vertexOf[q.topHandle()];
+        long long d = q.top();
+        q.pop();
+        for (const Edge &e : graph[u])
+        {
+            if (d + e.weight < dist[e.to])
+            {
+                dist[e.to] = d + e.weight;
+                if (handle[e.to] != None && q.contains(handle[e.to]) && vertexOf[handle[e.to]] == e.to)
+                {
+                    q.decreaseKey(handle[e.to], dist[e.to]);
+                }
+                else
+                {
+                    handle[e.to] = q.push(dist[e.to]);
+                    vertexOf[handle[e.to]] = e.to;
+                }
+            }
+        }
+    }
+    return dist;
+}
+
+void benchPriorityQueue()
+{
+    cout << "\n优先队列性能 (毫秒)" << endl;
+    const size_t N = 1000000;
+    mt19937 gen(26);
+    vector<int> values(N);
+    for (int &x : values)
+        x = gen();
+    long long a = 0, b = 0, c = 0, d = 0;
+    cout << N << " 次入队再出队: std::priority_queue " << pushPopAll<priority_queue<int>>(values, a)
+         << ", 二叉 " << pushPopAll<BinaryHeap<int, less<int>, 2>>(values, b)
+         << ", 4 叉 " << pushPopAll<BinaryHeap<int, less<int>, 4>>(values, c)
+         << ", 8 叉 " << pushPopAll<BinaryHeap<int, less<int>, 8>>(values, d)
+         << (a == b && b == c && c == d ? "" : " (错误：结果不一致)") << endl;
+
+    const int V = 200000, E = 8;
+    vector<vector<Edge>> graph(V);
+    for (int u = 0; u < V; u++)
+    {
+        graph[u].push_back({(u + 1) % V, 1000}); // 保证连通
+        for (int k = 1; k < E; k++)
+            graph[u].push_back({static_cast<int>(gen() % V), static_cast<int>(gen() % 1000) + 1});
+    }
+    auto start = high_resolution_clock::now();
+    vector<long long> lazy = dijkstraLazy(graph);
+    double lazyTime = duration<double, milli>(high_resolution_clock::now() - start).count();
+    start = high_resolution_clock::now();
+    vector<long long> indexed = dijkstraIndexed(graph);
+    double indexedTime = duration<double, milli>(high_resolution_clock::now() - start).count();
+    cout << "Dijkstra (" << V << " 个顶点, " << V * E << " 条边): std::priority_queue 重复入队 " << lazyTime
+         << ", IndexedHeap decreaseKey " << indexedTime << (lazy == indexed ? "" : " (错误：结果不一致)") << endl;
+}
+
+// 每个元素平均用时（纳秒）
+template <typename Sort>
+double nanosPerElement(const vector<int> &arr, Sort &&sortIt)
+{
+    vector<int> copy = arr;
+    auto start = high_resolution_clock::now();
+    sortIt(copy);
+    auto end = high_resolution_clock::now();
+    return duration<double, nano>(end - start).count() / arr.size();
+}
+
+// 数据规模从 1M 增加到 maxSize 时，每个元素的排序时间
+void testScaling(size_t maxSize)
+{
+    cout << "\n规模扩展 (随机序列, 每个元素纳秒)" << endl;
+    cout << "大小\tsort_heap\t二叉\t4 叉\t8 叉" << endl;
+    for (size_t size = 1000000; size <= maxSize; size *= 10)
+    {
+        vector<int> arr(size);
+        mt19937 gen(size);
+        for (int &x : arr)
+            x = gen();
+        cout << size << "\t";
+        cout << nanosPerElement(arr, [](vector<int> &a) {
+            make_heap(a.begin(), a.end());
+            sort_heap(a.begin(), a.end());
+        }) << "\t";
+        cout << nanosPerElement(arr, [](vector<int> &a) { heapsort<DaryHeapLayout<2>>(a); }) << "\t";
+        cout << nanosPerElement(arr, [](vector<int> &a) { heapsort<DaryHeapLayout<4>>(a); }) << "\t";
+        cout << nanosPerElement(arr, [](vector<int> &a) { heapsort<DaryHeapLayout<8>>(a); }) << endl;
+    }
+}
+
+// McIlroy 的对抗比较器：元素的值在第一次需要时才确定，让快速排序每次都选到很差的枢轴
+struct Adversary
+{
+    vector<int> &value;
+    int gas; // 还没确定的值，比所有已确定的都大
+    int solid = 0;
+    int candidate = 0;
+
+    bool operator()(int x, int y)
+    {
+        if (value[x] == gas && value[y] == gas)
+            value[x == candidate ? x : y] = solid++;
+        if (value[x] == gas)
+            candidate = x;
+        else if (value[y] == gas)
+            candidate = y;
+        return value[x] < value[y];
+    }
+};
+
+// 生成让 introsort 中的快速排序退化到 O(n^2) 的输入：对抗的是不限递归深度的版本
+vector<int> quicksortKiller(size_t n)
+{
+    vector<int> value(n, static_cast<int>(n));
+    vector<int> index(n);
+    iota(index.begin(), index.end(), 0);
+    Adversary adversary{value, static_cast<int>(n)};
+    introsortLoop(index.begin(), index.end(), numeric_limits<size_t>::max(), adversary);
+    return value;
+}
+
+// 内省排序：与 std::sort 比较；对抗输入下比较次数仍是 O(n log n)
+void testIntrosort()
+{
+    cout << "\n内省排序" << endl;
+    mt19937 gen(25);
+    bool ok = true;
+    for (int n = 0; n < 3000 && ok; n += (n < 200 ? 1 : 37))
+    {
+        vector<int> arr(n);
+        for (int &x : arr)
+            x = gen() % (n / 4 + 1);
+        vector<int> expected = arr;
+        sort(expected.begin(), expected.end());
+        introsort(arr.begin(), arr.end());
+        ok = arr == expected;
+    }
+    cout << "与 std::sort 一致: " << (ok ? "是" : "否") << endl;
+
+    const size_t N = 20000;
+    vector<int> killer = quicksortKiller(N);
+    long long comparisons = 0;
+    auto counting = [&](int a, int b) {
+        ++comparisons;
+        return a < b;
+    };
+    vector<int> arr = killer;
+    introsort(arr.begin(), arr.end(), counting);
+    long long bounded = comparisons;
+    bool sorted = is_sorted(arr.begin(), arr.end());
+    // 不限制递归深度，就是普通的三数取中快速排序
+    arr = killer;
+    comparisons = 0;
+    introsortLoop(arr.begin(), arr.end(), numeric_limits<size_t>::max(), counting);
+    sorted = sorted && is_sorted(arr.begin(), arr.end());
+    cout << "对抗输入 (大小: " << N << ") 比较次数: 内省排序 " << bounded << ", 不改用堆排序 " << comparisons
+         << ", n log2 n = " << static_cast<long long>(N * log2(N)) << endl;
+    cout << "排序结果正确: " << (sorted ? "是" : "否") << endl;
+}
+
+// 各种线程数、块大小和输入分布下，parallelSort 的结果都与 std::sort 一致
+bool checkParallelSort(WorkStealingPool &pool)
+{
+    mt19937 gen(26 + pool.concurrency());
+    for (size_t grain : {size_t(2), size_t(100), size_t(5000)})
+    {
+        for (size_t n : {size_t(0), size_t(1), size_t(3), size_t(1000), size_t(12345), size_t(100000)})
+        {
+            vector<int> arrays[4] = {generateRandom(n), generateSorted(n), generateReversed(n), vector<int>(n)};
+            for (int &x : arrays[3])
+                x = gen() % 10;
+            for (vector<int> &arr : arrays)
+            {
+                vector<int> expected = arr;
+                sort(expected.begin(), expected.end());
+                parallelSort(arr.begin(), arr.end(), less<>(), pool, grain);
+                if (arr != expected)
+                    return false;
+            }
+        }
+    }
+
+    // deque、降序、投影和只能移动的元素
+    vector<int> source = generateRandom(50000);
+    vector<int> descending = source;
+    sort(descending.begin(), descending.end(), greater<>());
+    deque<int> dq(source.begin(), source.end());
+    parallelSort(dq.begin(), dq.end(), greater<>(), pool, 1000);
+    bool ok = equal(dq.begin(), dq.end(), descending.begin());
+    vector<unique_ptr<int>> boxed;
+    for (int x : source)
+        boxed.push_back(make_unique<int>(x));
+    auto end = parallelSort(boxed, ranges::greater(), [](const unique_ptr<int> &p) { return *p; }, pool, 1000);
+    ok = ok && end == boxed.end();
+    for (size_t i = 0; i < boxed.size() && ok; i++)
+        ok = *boxed[i] == descending[i];
+    return ok;
+}
+
+void testParallelSort()
+{
+    cout << "\n并行排序" << endl;
+    for (unsigned threads : {1u, 2u, 3u, 4u})
+    {
+        WorkStealingPool pool(threads);
+        cout << threads << " 个线程: " << (checkParallelSort(pool) ? "正确" : "错误") << endl;
+    }
+
+    // 比较器抛出的异常传给调用者，线程池之后仍然可用
+    WorkStealingPool pool(4);
+    vector<int> arr = generateRandom(100000);
+    atomic<long long> calls{0};
+    bool thrown = false;
+    try
+    {
+        parallelSort(arr.begin(), arr.end(), [&](int a, int b) {
+            if (++calls == 500000)
+                throw runtime_error("comparison failed");
+            return a < b;
+        }, pool, 1000);
+    }
+    catch (const runtime_error &)
+    {
+        thrown = true;
+    }
+    arr = generateRandom(100000);
+    parallelSort(arr.begin(), arr.end(), less<>(), pool, 1000);
+    cout << "比较器异常: " << (thrown && check(arr) ? "正确" : "错误") << endl;
+}
+
+// 线程数从 1 增加到硬件线程数（至少到 4）时 parallelSort 的用时
+void testThreadScaling(size_t size)
+{
+    unsigned hardware = thread::hardware_concurrency();
+    cout << "\n线程扩展 (随机序列, 大小: " << size << ", 硬件线程数: " << hardware << ", 毫秒)" << endl;
+    vector<int> arr(size);
+    mt19937 gen(27);
+    for (int &x : arr)
+        x = gen();
+    double heapTime = nanosPerElement(arr, [](vector<int> &a) { heapsort(a); }) * size / 1e6;
+    double stdTime = nanosPerElement(arr, [](vector<int> &a) { sort(a.begin(), a.end()); }) * size / 1e6;
+    cout << "heapsort: " << heapTime << ", std::sort: " << stdTime << endl;
+    cout << "线程数\t用时\t加速比" << endl;
+    double base = 0;
+    for (unsigned threads = 1; threads <= max(hardware, 4u); threads++)
+    {
+        WorkStealingPool pool(threads);
+        vector<int> copy = arr;
+        auto start = high_resolution_clock::now();
+        parallelSort(copy.begin(), copy.end(), less<>(), pool);
+        double time = duration<double, milli>(high_resolution_clock::now() - start).count();
+        if (threads == 1)
+            base = time;
+        cout << threads << "\t" << time << "\t" << base / time << (check(copy) ? "" : " (错误)") << endl;
+    }
+}
+
+// 参数为规模扩展测试的最大规模，默认 1000 万，例如 ./test 100000000
+int main(int argc, char *argv[])
 {
     const int SIZE = 1000000;
+    size_t maxSize = argc > 1 ? stoull(argv[1]) : 10000000;
 
     // 测试随机序列
     vector<int> randomArr = generateRandom(SIZE);
+    countComparisons(randomArr);
     runTest("随机序列", randomArr);
 
     // 测试有序序列
@@ -116,5 +795,14 @@ int main()
     vector<int> repeatedArr = generatePartiallyRepeated(SIZE);
     runTest("部分重复序列", repeatedArr);
 
+    testLayouts();
+    testGenericApi();
+    testPriorityQueue();
+    benchPriorityQueue();
+    testScaling(maxSize);
+    testIntrosort();
+    testParallelSort();
+    testThreadScaling(maxSize);
+
     return 0;
 }
\ No newline at end of file